@@ -37,40 +37,155 @@
 
 #include <string.h>
 
+/* Output is accumulated in memory and written to the underlying stream
+ * in large chunks; a dump of a big library would otherwise issue one
+ * write per property, signal and member.
+ */
+#define DUMP_BUFFER_SIZE (64 * 1024)
+
+typedef struct {
+  GOutputStream *stream;
+  GString *buffer;
+  GError *error;
+} DumpOutput;
+
+/* @stream may be %NULL, in which case everything is kept in memory
+ * until the buffer is appended to another output.
+ */
+static void
+dump_output_init (DumpOutput *out, GOutputStream *stream)
+{
+  out->stream = stream;
+  out->buffer = g_string_sized_new (DUMP_BUFFER_SIZE);
+  out->error = NULL;
+}
+
+static gboolean
+dump_output_flush (DumpOutput *out)
+{
+  gsize written;
+
+  if (out->error == NULL && out->buffer->len > 0 &&
+      !g_output_stream_write_all (out->stream, out->buffer->str, out->buffer->len,
+                                  &written, NULL, &out->error))
+    g_critical ("failed to write to iochannel: %s", out->error->message);
+
+  g_string_truncate (out->buffer, 0);
+
+  return out->error == NULL;
+}
+
+static void
+dump_output_maybe_flush (DumpOutput *out)
+{
+  if (out->stream != NULL && out->buffer->len >= DUMP_BUFFER_SIZE)
+    dump_output_flush (out);
+}
+
+/* Equivalent to g_markup_escape_text(), but appends to @buffer directly
+ * instead of allocating a new string for every fragment.
+ */
+static void
+append_escaped (GString *buffer, const char *text)
+{
+  const char *p;
+
+  if (text == NULL)
+    text = "(null)";
+
+  for (p = text; *p != '\0'; p++)
+    {
+      guchar c = (guchar) *p;
+
+      switch (c)
+        {
+        case '&':
+          g_string_append (buffer, "&amp;");
+          break;
+        case '<':
+          g_string_append (buffer, "&lt;");
+          break;
+        case '>':
+          g_string_append (buffer, "&gt;");
+          break;
+        case '\'':
+          g_string_append (buffer, "&#39;");
+          break;
+        case '"':
+          g_string_append (buffer, "&quot;");
+          break;
+        default:
+          if ((c >= 0x1 && c <= 0x8) || (c >= 0xb && c <= 0xc) ||
+              (c >= 0xe && c <= 0x1f) || c == 0x7f)
+            g_string_append_printf (buffer, "&#x%x;", c);
+          else if (c == 0xc2 && (guchar) p[1] >= 0x80 && (guchar) p[1] <= 0x9f)
+            {
+              /* C1 control characters */
+              g_string_append_printf (buffer, "&#x%x;", (guchar) p[1]);
+              p++;
+            }
+          else
+            g_string_append_c (buffer, c);
+          break;
+        }
+    }
+}
+
 static void
-escaped_printf (GOutputStream *out, const char *fmt, ...) G_GNUC_PRINTF (2, 3);
+escaped_printf (DumpOutput *out, const char *fmt, ...) G_GNUC_PRINTF (2, 3);
 
+/* Only the conversions used in this file are supported: %s, %d, %u
+ * and %%.  String arguments are markup-escaped.
+ */
 static void
-escaped_printf (GOutputStream *out, const char *fmt, ...)
+escaped_printf (DumpOutput *out, const char *fmt, ...)
 {
-  char *str;
   va_list args;
-  gsize written;
-  GError *error = NULL;
+  const char *p;
+  char number[32];
 
   va_start (args, fmt);
 
-  str = g_markup_vprintf_escaped (fmt, args);
-  if (!g_output_stream_write_all (out, str, strlen (str), &written, NULL, &error))
+  for (p = fmt; *p != '\0'; p++)
     {
-      g_critical ("failed to write to iochannel: %s", error->message);
-      g_clear_error (&error);
+      if (*p != '%')
+        {
+          g_string_append_c (out->buffer, *p);
+          continue;
+        }
+
+      p++;
+      switch (*p)
+        {
+        case 's':
+          append_escaped (out->buffer, va_arg (args, const char *));
+          break;
+        case 'd':
+          g_snprintf (number, sizeof (number), "%d", va_arg (args, int));
+          g_string_append (out->buffer, number);
+          break;
+        case 'u':
+          g_snprintf (number, sizeof (number), "%u", va_arg (args, unsigned int));
+          g_string_append (out->buffer, number);
+          break;
+        case '%':
+          g_string_append_c (out->buffer, '%');
+          break;
+        default:
+          g_assert_not_reached ();
+        }
     }
-  g_free (str);
 
   va_end (args);
+
+  dump_output_maybe_flush (out);
 }
 
 static void
-goutput_write (GOutputStream *out, const char *str)
+goutput_write (DumpOutput *out, const char *str)
 {
-  gsize written;
-  GError *error = NULL;
-  if (!g_output_stream_write_all (out, str, strlen (str), &written, NULL, &error))
-    {
-      g_critical ("failed to write to iochannel: %s", error->message);
-      g_clear_error (&error);
-    }
+  g_string_append (out->buffer, str);
+  dump_output_maybe_flush (out);
 }
 
 typedef GType (*GetTypeFunc)(void);
@@ -120,7 +235,7 @@ invoke_error_quark (GModule *self, const char *symbol, GError **error)
 }
 
 static void
-dump_properties (GType type, GOutputStream *out)
+dump_properties (GType type, DumpOutput *out)
 {
   guint i;
   guint n_properties;
@@ -154,7 +269,7 @@ dump_properties (GType type, GOutputStream *out)
 }
 
 static void
-dump_signals (GType type, GOutputStream *out)
+dump_signals (GType type, DumpOutput *out)
 {
   guint i;
   guint n_sigs;
@@ -208,7 +323,7 @@ dump_signals (GType type, GOutputStream *out)
 }
 
 static void
-dump_object_type (GType type, const char *symbol, GOutputStream *out)
+dump_object_type (GType type, const char *symbol, DumpOutput *out)
 {
   guint n_interfaces;
   guint i;
@@ -258,7 +373,7 @@ dump_object_type (GType type, const char *symbol, GOutputStream *out)
 }
 
 static void
-dump_interface_type (GType type, const char *symbol, GOutputStream *out)
+dump_interface_type (GType type, const char *symbol, DumpOutput *out)
 {
   guint n_interfaces;
   guint i;
@@ -291,14 +406,14 @@ dump_interface_type (GType type, const char *symbol, GOutputStream *out)
 }
 
 static void
-dump_boxed_type (GType type, const char *symbol, GOutputStream *out)
+dump_boxed_type (GType type, const char *symbol, DumpOutput *out)
 {
   escaped_printf (out, "  <boxed name=\"%s\" get-type=\"%s\"/>\n",
 		  g_type_name (type), symbol);
 }
 
 static void
-dump_flags_type (GType type, const char *symbol, GOutputStream *out)
+dump_flags_type (GType type, const char *symbol, DumpOutput *out)
 {
   guint i;
   GFlagsClass *klass;
@@ -318,7 +433,7 @@ dump_flags_type (GType type, const char *symbol, GOutputStream *out)
 }
 
 static void
-dump_enum_type (GType type, const char *symbol, GOutputStream *out)
+dump_enum_type (GType type, const char *symbol, DumpOutput *out)
 {
   guint i;
   GEnumClass *klass;
@@ -338,7 +453,7 @@ dump_enum_type (GType type, const char *symbol, GOutputStream *out)
 }
 
 static void
-dump_fundamental_type (GType type, const char *symbol, GOutputStream *out)
+dump_fundamental_type (GType type, const char *symbol, DumpOutput *out)
 {
   guint n_interfaces;
   guint i;
@@ -389,7 +504,7 @@ dump_fundamental_type (GType type, const char *symbol, GOutputStream *out)
 }
 
 static void
-dump_type (GType type, const char *symbol, GOutputStream *out)
+dump_type (GType type, const char *symbol, DumpOutput *out)
 {
   switch (g_type_fundamental (type))
     {
@@ -418,12 +533,131 @@ dump_type (GType type, const char *symbol, GOutputStream *out)
 }
 
 static void
-dump_error_quark (GQuark quark, const char *symbol, GOutputStream *out)
+dump_error_quark (GQuark quark, const char *symbol, DumpOutput *out)
 {
   escaped_printf (out, "  <error-quark function=\"%s\" domain=\"%s\"/>\n",
 		  symbol, g_quark_to_string (quark));
 }
 
+typedef struct {
+  char *function;
+  GType type;
+  GQuark quark;
+} DumpEntry;
+
+typedef struct {
+  GArray *entries;
+  guint start;
+  guint end;
+  DumpOutput out;
+} DumpShard;
+
+static void
+dump_entry_clear (gpointer data)
+{
+  DumpEntry *entry = data;
+  g_free (entry->function);
+}
+
+/* Class and interface initialization may run arbitrary library code, so
+ * it is always done on the main thread, in input order, before any shard
+ * starts introspecting properties and signals.
+ */
+static void
+ensure_type_initialized (GType type)
+{
+  switch (g_type_fundamental (type))
+    {
+    case G_TYPE_OBJECT:
+    case G_TYPE_FLAGS:
+    case G_TYPE_ENUM:
+      g_type_class_ref (type);
+      break;
+    case G_TYPE_INTERFACE:
+      g_type_default_interface_ref (type);
+      break;
+    default:
+      break;
+    }
+}
+
+static void
+dump_entries (GArray *entries, guint start, guint end, DumpOutput *out)
+{
+  guint i;
+
+  for (i = start; i < end; i++)
+    {
+      DumpEntry *entry = &g_array_index (entries, DumpEntry, i);
+
+      if (entry->type != G_TYPE_INVALID)
+        dump_type (entry->type, entry->function, out);
+      else
+        dump_error_quark (entry->quark, entry->function, out);
+    }
+}
+
+static gpointer
+dump_shard_thread (gpointer data)
+{
+  DumpShard *shard = data;
+
+  dump_entries (shard->entries, shard->start, shard->end, &shard->out);
+
+  return NULL;
+}
+
+static void
+dump_entries_sharded (GArray *entries, guint n_shards, DumpOutput *out)
+{
+  DumpShard *shards;
+  GThread **threads;
+  guint i;
+
+  if (n_shards > entries->len)
+    n_shards = entries->len;
+
+  if (n_shards <= 1)
+    {
+      dump_entries (entries, 0, entries->len, out);
+      return;
+    }
+
+  shards = g_new0 (DumpShard, n_shards);
+  threads = g_new0 (GThread *, n_shards);
+
+  for (i = 0; i < n_shards; i++)
+    {
+      shards[i].entries = entries;
+      shards[i].start = (guint) ((guint64) entries->len * i / n_shards);
+      shards[i].end = (guint) ((guint64) entries->len * (i + 1) / n_shards);
+      dump_output_init (&shards[i].out, NULL);
+
+      /* The first shard is dumped on the calling thread */
+      if (i > 0)
+        threads[i] = g_thread_new ("gi-dump", dump_shard_thread, &shards[i]);
+    }
+
+  dump_shard_thread (&shards[0]);
+
+  /* Merge in input order so that the output does not depend on the
+   * number of shards.
+   */
+  for (i = 0; i < n_shards; i++)
+    {
+      if (threads[i] != NULL)
+        g_thread_join (threads[i]);
+
+      g_string_append_len (out->buffer, shards[i].out.buffer->str,
+                           shards[i].out.buffer->len);
+      g_string_free (shards[i].out.buffer, TRUE);
+      dump_output_maybe_flush (out);
+    }
+
+  g_free (threads);
+  g_free (shards);
+}
+
 /**
  * g_irepository_dump:
  * @arg: Comma-separated pair of input and output filenames
@@ -436,6 +670,12 @@ dump_error_quark (GQuark quark, const char *symbol, GOutputStream *out)
  * "error-quark:" followed by the name of an error quark function.  No
  * extra whitespace is allowed.
  *
+ * A line containing "shards:" followed by a number splits the
+ * introspection of properties and signals across that many threads.
+ * The get-type and error-quark functions, as well as class
+ * initialization, are still invoked on the calling thread, and the
+ * output is the same regardless of the number of shards.
+ *
  * The output file should already exist, but be empty.  This function will
  * overwrite its contents.
  *
@@ -452,11 +692,14 @@ g_irepository_dump (const char *arg, GError **error)
 #endif
 {
   GHashTable *output_types;
+  GArray *entries;
+  guint n_shards = 1;
   char **args;
   GFile *input_file;
   GFile *output_file;
   GFileInputStream *input;
   GFileOutputStream *output;
+  DumpOutput out;
   GDataInputStream *in;
   GModule *self;
   gboolean caught_error = FALSE;
@@ -497,10 +740,14 @@ g_irepository_dump (const char *arg, GError **error)
       return FALSE;
     }
 
-  goutput_write (G_OUTPUT_STREAM (output), "<?xml version=\"1.0\"?>\n");
-  goutput_write (G_OUTPUT_STREAM (output), "<dump>\n");
+  dump_output_init (&out, G_OUTPUT_STREAM (output));
+
+  goutput_write (&out, "<?xml version=\"1.0\"?>\n");
+  goutput_write (&out, "<dump>\n");
 
   output_types = g_hash_table_new (NULL, NULL);
+  entries = g_array_new (FALSE, FALSE, sizeof (DumpEntry));
+  g_array_set_clear_func (entries, dump_entry_clear);
 
   in = g_data_input_stream_new (G_INPUT_STREAM (input));
   g_object_unref (input);
@@ -510,6 +757,7 @@ g_irepository_dump (const char *arg, GError **error)
       gsize len;
       char *line = g_data_input_stream_read_line (in, &len, NULL, NULL);
       const char *function;
+      DumpEntry entry = { NULL, G_TYPE_INVALID, 0 };
 
       if (line == NULL || *line == '\0')
         {
@@ -539,7 +787,11 @@ g_irepository_dump (const char *arg, GError **error)
             goto next;
           g_hash_table_insert (output_types, (gpointer) type, (gpointer) type);
 
-          dump_type (type, function, G_OUTPUT_STREAM (output));
+          ensure_type_initialized (type);
+
+          entry.function = g_strdup (function);
+          entry.type = type;
+          g_array_append_val (entries, entry);
         }
       else if (strncmp (line, "error-quark:", strlen ("error-quark:")) == 0)
         {
@@ -555,7 +807,15 @@ g_irepository_dump (const char *arg, GError **error)
               break;
             }
 
-          dump_error_quark (quark, function, G_OUTPUT_STREAM (output));
+          entry.function = g_strdup (function);
+          entry.quark = quark;
+          g_array_append_val (entries, entry);
+        }
+      else if (strncmp (line, "shards:", strlen ("shards:")) == 0)
+        {
+          guint64 value = g_ascii_strtoull (line + strlen ("shards:"), NULL, 10);
+
+          n_shards = (guint) CLAMP (value, 1, 256);
         }
 
 
@@ -565,7 +825,13 @@ g_irepository_dump (const char *arg, GError **error)
 
   g_hash_table_destroy (output_types);
 
-  goutput_write (G_OUTPUT_STREAM (output), "</dump>\n");
+  dump_entries_sharded (entries, n_shards, &out);
+  g_array_unref (entries);
+
+  goutput_write (&out, "</dump>\n");
+
+  dump_output_flush (&out);
+  g_string_free (out.buffer, TRUE);
 
   {
     GError **ioerror;
@@ -574,6 +840,12 @@ g_irepository_dump (const char *arg, GError **error)
       ioerror = NULL;
     else
       ioerror = error;
+    if (out.error != NULL)
+      {
+        g_propagate_error (ioerror, out.error);
+        ioerror = NULL;
+        caught_error = TRUE;
+      }
     if (!g_input_stream_close (G_INPUT_STREAM (in), NULL, ioerror))
       return FALSE;
     if (!g_output_stream_close (G_OUTPUT_STREAM (output), NULL, ioerror))
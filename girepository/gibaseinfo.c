@@ -48,6 +48,80 @@ g_base_info_gtype_get_type (void)
   return our_type;
 }
 
+/* Shared infos, see g_typelib_enable_info_cache().  The cached infos
+ * are their own keys; they hold no references on their container or
+ * repository, only containers which are cached themselves are allowed,
+ * and the cache owns one reference which is dropped when the typelib
+ * is freed.
+ */
+G_LOCK_DEFINE_STATIC (info_cache);
+
+static guint
+cached_info_hash (gconstpointer key)
+{
+  const GIRealInfo *info = key;
+
+  return g_direct_hash (info->container) ^ (info->offset * 31 + info->type);
+}
+
+static gboolean
+cached_info_equal (gconstpointer a,
+                   gconstpointer b)
+{
+  const GIRealInfo *info_a = a;
+  const GIRealInfo *info_b = b;
+
+  return info_a->offset == info_b->offset &&
+         info_a->type == info_b->type &&
+         info_a->container == info_b->container;
+}
+
+static void
+cached_info_free (gpointer data)
+{
+  g_slice_free (GIRealInfo, data);
+}
+
+static GIBaseInfo *
+lookup_cached_info (GIInfoType     type,
+                    GIRepository  *repository,
+                    GIBaseInfo    *container,
+                    GITypelib     *typelib,
+                    guint32        offset)
+{
+  GIRealInfo key;
+  GIRealInfo *info;
+
+  key.type = type;
+  key.container = container;
+  key.offset = offset;
+
+  if (G_UNLIKELY (typelib->profile != NULL))
+    _g_typelib_profile_blob (typelib, offset);
+
+  G_LOCK (info_cache);
+
+  if (typelib->infos == NULL)
+    typelib->infos = g_hash_table_new_full (cached_info_hash, cached_info_equal,
+                                            cached_info_free, NULL);
+
+  info = g_hash_table_lookup (typelib->infos, &key);
+  if (info == NULL)
+    {
+      info = g_slice_new (GIRealInfo);
+      _g_info_init (info, type, repository, container, typelib, offset);
+      info->ref_count = 1;
+      info->is_cached = TRUE;
+      g_hash_table_add (typelib->infos, info);
+    }
+
+  g_atomic_int_inc (&info->ref_count);
+
+  G_UNLOCK (info_cache);
+
+  return (GIBaseInfo *) info;
+}
+
 /* info creation */
 GIBaseInfo *
 _g_info_new_full (GIInfoType     type,
@@ -60,6 +134,10 @@ _g_info_new_full (GIInfoType     type,
 
   g_return_val_if_fail (container != NULL || repository != NULL, NULL);
 
+  if (typelib->cache_infos &&
+      (container == NULL || ((GIRealInfo *) container)->is_cached))
+    return lookup_cached_info (type, repository, container, typelib, offset);
+
   info = g_slice_new (GIRealInfo);
 
   _g_info_init (info, type, repository, container, typelib, offset);
@@ -110,6 +188,9 @@ _g_info_init (GIRealInfo     *info,
   info->typelib = typelib;
   info->offset = offset;
 
+  if (G_UNLIKELY (typelib->profile != NULL))
+    _g_typelib_profile_blob (typelib, offset);
+
   if (container)
     info->container = container;
 
@@ -125,6 +206,9 @@ _g_info_from_entry (GIRepository *repository,
   GIBaseInfo *result;
   DirEntry *entry = g_typelib_get_dir_entry (typelib, index);
 
+  if (G_UNLIKELY (typelib->profile != NULL))
+    _g_typelib_profile_dir_entry (typelib, index);
+
   if (entry->local)
     result = _g_info_new_full (entry->blob_type, repository, NULL, typelib, entry->offset);
   else
@@ -260,6 +344,9 @@ g_base_info_unref (GIBaseInfo *info)
   if (!g_atomic_int_dec_and_test (&rinfo->ref_count))
     return;
 
+  /* The typelib's info cache always holds a reference */
+  g_assert (rinfo->type == GI_INFO_TYPE_UNRESOLVED || !rinfo->is_cached);
+
   if (rinfo->container && ((GIRealInfo *) rinfo->container)->ref_count != INVALID_REFCOUNT)
     g_base_info_unref (rinfo->container);
 
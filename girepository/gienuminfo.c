@@ -125,6 +125,219 @@ g_enum_info_get_value (GIEnumInfo *info,
   return (GIValueInfo *) g_info_new (GI_INFO_TYPE_VALUE, (GIBaseInfo*)info, rinfo->typelib, offset);
 }
 
+/* The values of an enum sorted by value, built the first time they are
+ * looked up by value and kept until the typelib is freed.
+ */
+typedef struct {
+  guint n_values;
+  GIEnumValueEntry values[1];
+} EnumTable;
+
+G_LOCK_DEFINE_STATIC (enum_tables);
+
+static gint
+compare_value_entries (gconstpointer a,
+                       gconstpointer b,
+                       gpointer      user_data)
+{
+  const GIEnumValueEntry *entry_a = a;
+  const GIEnumValueEntry *entry_b = b;
+
+  if (entry_a->value != entry_b->value)
+    return entry_a->value < entry_b->value ? -1 : 1;
+  return entry_a->index - entry_b->index;
+}
+
+static EnumTable *
+build_enum_table (GIRealInfo *rinfo)
+{
+  GITypelib *typelib = rinfo->typelib;
+  Header *header = (Header *)typelib->data;
+  EnumBlob *blob = (EnumBlob *)&typelib->data[rinfo->offset];
+  EnumTable *table;
+  guint i;
+
+  table = g_malloc (G_STRUCT_OFFSET (EnumTable, values) +
+                    MAX (blob->n_values, 1) * sizeof (GIEnumValueEntry));
+  table->n_values = blob->n_values;
+
+  for (i = 0; i < blob->n_values; i++)
+    {
+      ValueBlob *value_blob = (ValueBlob *)&typelib->data[rinfo->offset
+                                                          + header->enum_blob_size
+                                                          + i * header->value_blob_size];
+      GIEnumValueEntry *entry = &table->values[i];
+
+      if (value_blob->unsigned_value)
+        entry->value = (gint64)(guint32)value_blob->value;
+      else
+        entry->value = (gint64)value_blob->value;
+      entry->name = g_typelib_get_string (typelib, value_blob->name);
+      entry->index = i;
+    }
+
+  g_qsort_with_data (table->values, table->n_values, sizeof (GIEnumValueEntry),
+                     compare_value_entries, NULL);
+
+  return table;
+}
+
+static EnumTable *
+get_enum_table (GIEnumInfo *info)
+{
+  GIRealInfo *rinfo = (GIRealInfo *)info;
+  GITypelib *typelib = rinfo->typelib;
+  EnumTable *table;
+
+  G_LOCK (enum_tables);
+
+  if (typelib->enum_tables == NULL)
+    typelib->enum_tables = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  table = g_hash_table_lookup (typelib->enum_tables, GUINT_TO_POINTER (rinfo->offset));
+  if (table == NULL)
+    {
+      table = build_enum_table (rinfo);
+      g_hash_table_insert (typelib->enum_tables, GUINT_TO_POINTER (rinfo->offset), table);
+    }
+
+  G_UNLOCK (enum_tables);
+
+  return table;
+}
+
+/**
+ * g_enum_info_get_sorted_values: (skip)
+ * @info: a #GIEnumInfo
+ * @n_values: (out): return location for the number of values
+ *
+ * Obtain the values of this enumeration sorted by value, and by index
+ * for equal values, without allocating a #GIValueInfo for each of them.
+ *
+ * Returns: (transfer none) (array length=n_values): the values, valid
+ *   for as long as the typelib of @info is loaded
+ *
+ * Since: 1.58
+ */
+const GIEnumValueEntry *
+g_enum_info_get_sorted_values (GIEnumInfo *info,
+                               guint      *n_values)
+{
+  EnumTable *table;
+
+  g_return_val_if_fail (info != NULL, NULL);
+  g_return_val_if_fail (GI_IS_ENUM_INFO (info), NULL);
+  g_return_val_if_fail (n_values != NULL, NULL);
+
+  table = get_enum_table (info);
+  *n_values = table->n_values;
+  return table->values;
+}
+
+/**
+ * g_enum_info_find_value:
+ * @info: a #GIEnumInfo
+ * @value: an enumeration value
+ *
+ * Looks up the value of this enumeration equal to @value, in
+ * logarithmic time.  If several values are equal, the first one is
+ * returned.
+ *
+ * Returns: the index of the value, to be passed to
+ *   g_enum_info_get_value(), or -1 if there is none
+ *
+ * Since: 1.58
+ */
+gint
+g_enum_info_find_value (GIEnumInfo *info,
+                        gint64      value)
+{
+  EnumTable *table;
+  guint low, high;
+
+  g_return_val_if_fail (info != NULL, -1);
+  g_return_val_if_fail (GI_IS_ENUM_INFO (info), -1);
+
+  table = get_enum_table (info);
+
+  /* Find the first entry not below @value */
+  low = 0;
+  high = table->n_values;
+  while (low < high)
+    {
+      guint mid = low + (high - low) / 2;
+
+      if (table->values[mid].value < value)
+        low = mid + 1;
+      else
+        high = mid;
+    }
+
+  if (low < table->n_values && table->values[low].value == value)
+    return table->values[low].index;
+  return -1;
+}
+
+/**
+ * g_enum_info_decompose_flags:
+ * @info: a #GIEnumInfo for a flags type
+ * @value: a flags value
+ * @indices: (out caller-allocates) (array length=n_indices) (allow-none):
+ *   return location for the indices of the matching values
+ * @n_indices: the length of @indices
+ * @remainder: (out) (allow-none): return location for the bits of @value
+ *   not set in any of the matching values
+ *
+ * Finds the non-zero values of this enumeration whose bits are all set
+ * in @value, in ascending order of value, storing the index of each one
+ * in @indices until it is full.  If several values are equal, only the
+ * first one is matched.
+ *
+ * Returns: the number of matching values, which may be larger than
+ *   @n_indices
+ *
+ * Since: 1.58
+ */
+guint
+g_enum_info_decompose_flags (GIEnumInfo *info,
+                             guint32     value,
+                             gint       *indices,
+                             guint       n_indices,
+                             guint32    *remainder)
+{
+  EnumTable *table;
+  guint32 covered = 0;
+  guint n_matched = 0;
+  guint i;
+
+  g_return_val_if_fail (info != NULL, 0);
+  g_return_val_if_fail (GI_IS_ENUM_INFO (info), 0);
+  g_return_val_if_fail (indices != NULL || n_indices == 0, 0);
+
+  table = get_enum_table (info);
+
+  for (i = 0; i < table->n_values; i++)
+    {
+      const GIEnumValueEntry *entry = &table->values[i];
+      guint32 bits = (guint32)entry->value;
+
+      if (bits == 0 || (value & bits) != bits)
+        continue;
+      if (i > 0 && table->values[i - 1].value == entry->value)
+        continue;
+
+      if (n_matched < n_indices)
+        indices[n_matched] = entry->index;
+      n_matched++;
+      covered |= bits;
+    }
+
+  if (remainder)
+    *remainder = value & ~covered;
+
+  return n_matched;
+}
+
 /**
  * g_enum_info_get_n_methods:
  * @info: a #GIEnumInfo
@@ -50,6 +50,21 @@ G_BEGIN_DECLS
 #define GI_IS_VALUE_INFO(info) \
     (g_base_info_get_type((GIBaseInfo*)info) ==  GI_INFO_TYPE_VALUE)
 
+/**
+ * GIEnumValueEntry:
+ * @value: the enumeration value
+ * @name: the name of the value
+ * @index: the index of the value, as passed to g_enum_info_get_value()
+ *
+ * A value of an enumeration, as returned by
+ * g_enum_info_get_sorted_values().
+ */
+typedef struct {
+  gint64       value;
+  const gchar *name;
+  gint         index;
+} GIEnumValueEntry;
+
 
 GI_AVAILABLE_IN_ALL
 gint           g_enum_info_get_n_values      (GIEnumInfo  *info);
@@ -58,6 +73,22 @@ GI_AVAILABLE_IN_ALL
 GIValueInfo  * g_enum_info_get_value         (GIEnumInfo  *info,
 					      gint         n);
 
+GI_AVAILABLE_IN_1_58
+const GIEnumValueEntry *
+               g_enum_info_get_sorted_values (GIEnumInfo  *info,
+					      guint       *n_values);
+
+GI_AVAILABLE_IN_1_58
+gint           g_enum_info_find_value        (GIEnumInfo  *info,
+					      gint64       value);
+
+GI_AVAILABLE_IN_1_58
+guint          g_enum_info_decompose_flags   (GIEnumInfo  *info,
+					      guint32      value,
+					      gint        *indices,
+					      guint        n_indices,
+					      guint32     *remainder);
+
 GI_AVAILABLE_IN_ALL
 gint              g_enum_info_get_n_methods     (GIEnumInfo  *info);
 
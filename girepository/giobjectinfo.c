@@ -66,21 +66,15 @@ g_object_info_get_field_offset (GIObjectInfo *info,
   Header *header = (Header *)rinfo->typelib->data;
   ObjectBlob *blob = (ObjectBlob *)&rinfo->typelib->data[rinfo->offset];
   guint32 offset;
-  gint i;
-  FieldBlob *field_blob;
 
   offset = rinfo->offset + header->object_blob_size
     + (blob->n_interfaces + blob->n_interfaces % 2) * 2;
 
-  for (i = 0; i < n; i++)
-    {
-      field_blob = (FieldBlob *)&rinfo->typelib->data[offset];
-      offset += header->field_blob_size;
-      if (field_blob->has_embedded_type)
-        offset += header->callback_blob_size;
-    }
+  /* Without embedded callbacks all fields have the same size */
+  if (blob->n_field_callbacks == 0)
+    return offset + n * header->field_blob_size;
 
-  return offset;
+  return g_typelib_get_field_offsets (rinfo->typelib, offset, blob->n_fields)[n];
 }
 
 /**
@@ -58,7 +58,8 @@ struct _GIRealInfo
   guint32 offset;
 
   guint32 type_is_embedded : 1; /* Used by GITypeInfo */
-  guint32 reserved : 31;
+  guint32 is_cached : 1; /* Owned by the typelib's info cache */
+  guint32 reserved : 30;
 
   gpointer reserved2[4];
 };
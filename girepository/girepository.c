@@ -30,6 +30,9 @@
 #include <glib.h>
 #include <glib/gprintf.h>
 #include <gmodule.h>
+#ifdef G_OS_UNIX
+#include <unistd.h>
+#endif
 #include "girepository.h"
 #include "gitypelib-internal.h"
 #include "girepository-private.h"
@@ -58,6 +61,23 @@
 static GIRepository *default_repository = NULL;
 static GSList *typelib_search_path = NULL;
 
+/* Access profile, see g_irepository_enable_profile() */
+struct _GITypelibProfile
+{
+  gchar *namespace;
+  gchar *version;
+  gsize len;
+  guint n_entries;
+  guint *blobs;    /* one bit per 4 bytes of the typelib */
+  guint *entries;  /* one bit per directory entry */
+};
+
+G_LOCK_DEFINE_STATIC (profiles);
+static GPtrArray *profiles = NULL;
+static gchar *profile_filename = NULL;
+
+static void attach_profile (GITypelib *typelib);
+
 struct _GIRepositoryPrivate
 {
   GHashTable *typelibs; /* (string) namespace -> GITypelib */
@@ -197,6 +217,9 @@ init_globals (void)
       typelib_search_path = g_slist_reverse (typelib_search_path);
     }
 
+  if (g_getenv ("GI_TYPELIB_PROFILE") != NULL)
+    g_irepository_enable_profile (g_getenv ("GI_TYPELIB_PROFILE"));
+
   g_once_init_leave (&initialized, 1);
 }
 
@@ -335,6 +358,7 @@ get_registered (GIRepository *repository,
 static gboolean
 load_dependencies_recurse (GIRepository *repository,
 			   GITypelib     *typelib,
+			   GIRepositoryLoadFlags flags,
 			   GError      **error)
 {
   char **dependencies;
@@ -357,7 +381,7 @@ load_dependencies_recurse (GIRepository *repository,
 	  dependency_version = last_dash+1;
 
 	  if (!g_irepository_require (repository, dependency_namespace, dependency_version,
-				      0, error))
+				      flags, error))
 	    {
 	      g_free (dependency_namespace);
 	      g_strfreev (dependencies);
@@ -373,12 +397,13 @@ load_dependencies_recurse (GIRepository *repository,
 static const char *
 register_internal (GIRepository *repository,
 		   const char   *source,
-		   gboolean      lazy,
+		   GIRepositoryLoadFlags flags,
 		   GITypelib     *typelib,
 		   GError      **error)
 {
   Header *header;
   const gchar *namespace;
+  gboolean lazy = (flags & G_IREPOSITORY_LOAD_FLAG_LAZY) > 0;
 
   g_return_val_if_fail (typelib != NULL, FALSE);
 
@@ -388,6 +413,8 @@ register_internal (GIRepository *repository,
 
   namespace = g_typelib_get_string (typelib, header->namespace);
 
+  attach_profile (typelib);
+
   if (lazy)
     {
       g_assert (!g_hash_table_lookup (repository->priv->lazy_typelibs,
@@ -401,7 +428,9 @@ register_internal (GIRepository *repository,
       char *key;
 
       /* First, try loading all the dependencies */
-      if (!load_dependencies_recurse (repository, typelib, error))
+      if (!load_dependencies_recurse (repository, typelib,
+				      flags & G_IREPOSITORY_LOAD_FLAG_VALIDATE,
+				      error))
 	return NULL;
 
       /* Check if we are transitioning from lazily loaded state */
@@ -586,6 +615,10 @@ g_irepository_load_typelib (GIRepository *repository,
 
   repository = get_repository (repository);
 
+  if ((flags & G_IREPOSITORY_LOAD_FLAG_VALIDATE) &&
+      !g_typelib_validate_cached (typelib, error))
+    return NULL;
+
   header = (Header *) typelib->data;
   namespace = g_typelib_get_string (typelib, header->namespace);
   nsversion = g_typelib_get_string (typelib, header->nsversion);
@@ -604,7 +637,7 @@ g_irepository_load_typelib (GIRepository *repository,
       return namespace;
     }
   return register_internal (repository, "<builtin>",
-			    allow_lazy, typelib, error);
+			    flags, typelib, error);
 }
 
 /**
@@ -720,6 +753,8 @@ g_irepository_get_info (GIRepository *repository,
   entry = g_typelib_get_dir_entry (typelib, index + 1);
   if (entry == NULL)
     return NULL;
+  if (G_UNLIKELY (typelib->profile != NULL))
+    _g_typelib_profile_dir_entry (typelib, index + 1);
   return _g_info_new_full (entry->blob_type,
 			   repository,
 			   NULL, typelib, entry->offset);
@@ -1409,6 +1444,31 @@ g_irepository_enumerate_versions (GIRepository *repository,
   return ret;
 }
 
+/* Validates a typelib which is already registered, and the ones it
+ * depends on, as if it had been loaded with G_IREPOSITORY_LOAD_FLAG_VALIDATE.
+ */
+static gboolean
+validate_registered (GIRepository *repository,
+		     const gchar  *namespace,
+		     GITypelib    *typelib,
+		     GError      **error)
+{
+  GError *temp_error = NULL;
+
+  if (!g_typelib_validate_cached (typelib, &temp_error))
+    {
+      g_set_error (error, G_IREPOSITORY_ERROR,
+		   G_IREPOSITORY_ERROR_TYPELIB_NOT_FOUND,
+		   "Loaded typelib for namespace '%s' is invalid: %s",
+		   namespace, temp_error->message);
+      g_clear_error (&temp_error);
+      return FALSE;
+    }
+
+  return load_dependencies_recurse (repository, typelib,
+				    G_IREPOSITORY_LOAD_FLAG_VALIDATE, error);
+}
+
 static GITypelib *
 require_internal (GIRepository  *repository,
 		  const gchar   *namespace,
@@ -1435,7 +1495,13 @@ require_internal (GIRepository  *repository,
   typelib = get_registered_status (repository, namespace, version, allow_lazy,
                                    &is_lazy, &version_conflict);
   if (typelib)
-    return typelib;
+    {
+      /* It may have been loaded without validation before */
+      if ((flags & G_IREPOSITORY_LOAD_FLAG_VALIDATE) &&
+	  !validate_registered (repository, namespace, typelib, error))
+	return NULL;
+      return typelib;
+    }
 
   if (version_conflict != NULL)
     {
@@ -1476,6 +1542,12 @@ require_internal (GIRepository  *repository,
   {
     GError *temp_error = NULL;
     typelib = g_typelib_new_from_mapped_file (mfile, &temp_error);
+    if (typelib && (flags & G_IREPOSITORY_LOAD_FLAG_VALIDATE) &&
+	!g_typelib_validate_cached (typelib, &temp_error))
+      {
+	g_typelib_free (typelib);
+	typelib = NULL;
+      }
     if (!typelib)
       {
 	g_set_error (error, G_IREPOSITORY_ERROR,
@@ -1511,7 +1583,7 @@ require_internal (GIRepository  *repository,
       goto out;
     }
 
-  if (!register_internal (repository, path, allow_lazy,
+  if (!register_internal (repository, path, flags,
 			  typelib, error))
     {
       g_typelib_free (typelib);
@@ -1589,6 +1661,275 @@ g_irepository_require_private (GIRepository  *repository,
 			   &search_path, error);
 }
 
+static GITypelibProfile *
+find_profile (const gchar *namespace,
+              const gchar *version)
+{
+  guint i;
+
+  for (i = 0; i < profiles->len; i++)
+    {
+      GITypelibProfile *profile = g_ptr_array_index (profiles, i);
+
+      if (strcmp (profile->namespace, namespace) == 0 &&
+          strcmp (profile->version, version) == 0)
+        return profile;
+    }
+
+  return NULL;
+}
+
+static void
+profile_free (GITypelibProfile *profile)
+{
+  g_free (profile->namespace);
+  g_free (profile->version);
+  g_free (profile->blobs);
+  g_free (profile->entries);
+  g_slice_free (GITypelibProfile, profile);
+}
+
+/* Must be called with the profiles lock held */
+static void
+attach_profile_unlocked (GITypelib *typelib)
+{
+  Header *header = (Header *)typelib->data;
+  const gchar *namespace;
+  const gchar *version;
+  GITypelibProfile *profile;
+
+  if (typelib->profile != NULL)
+    return;
+
+  namespace = g_typelib_get_string (typelib, header->namespace);
+  version = g_typelib_get_string (typelib, header->nsversion);
+
+  profile = find_profile (namespace, version);
+  if (profile == NULL)
+    {
+      profile = g_slice_new0 (GITypelibProfile);
+      profile->namespace = g_strdup (namespace);
+      profile->version = g_strdup (version);
+      profile->len = typelib->len;
+      profile->n_entries = header->n_entries;
+      profile->blobs = g_new0 (guint, ((typelib->len + 3) / 4 + 31) / 32);
+      profile->entries = g_new0 (guint, (header->n_entries + 31) / 32);
+      g_ptr_array_add (profiles, profile);
+    }
+  else if (profile->len != typelib->len)
+    {
+      /* A different build of the same namespace; offsets would not
+       * match, so don't mix the two. */
+      return;
+    }
+
+  typelib->profile = profile;
+}
+
+static void
+attach_profile (GITypelib *typelib)
+{
+  G_LOCK (profiles);
+  if (profiles != NULL)
+    attach_profile_unlocked (typelib);
+  G_UNLOCK (profiles);
+}
+
+static void
+attach_profile_foreach (gpointer key,
+                        gpointer value,
+                        gpointer user_data)
+{
+  attach_profile_unlocked ((GITypelib *) value);
+}
+
+static void
+profile_set_bit (guint *bits,
+                 guint  bit)
+{
+  guint mask = 1U << (bit % 32);
+
+  if ((g_atomic_int_get ((gint *) &bits[bit / 32]) & mask) == 0)
+    g_atomic_int_or (&bits[bit / 32], mask);
+}
+
+void
+_g_typelib_profile_blob (GITypelib *typelib,
+                         guint32    offset)
+{
+  GITypelibProfile *profile = typelib->profile;
+
+  if (offset < profile->len)
+    profile_set_bit (profile->blobs, offset / 4);
+}
+
+void
+_g_typelib_profile_dir_entry (GITypelib *typelib,
+                              guint16    index)
+{
+  GITypelibProfile *profile = typelib->profile;
+
+  if (index > 0 && index <= profile->n_entries)
+    profile_set_bit (profile->entries, index - 1);
+}
+
+static void
+write_profile_at_exit (void)
+{
+  GError *error = NULL;
+
+  if (!g_irepository_write_profile (&error))
+    {
+      g_warning ("Failed to write typelib profile: %s", error->message);
+      g_error_free (error);
+    }
+}
+
+/**
+ * g_irepository_enable_profile:
+ * @filename: (type filename): file to write the profile to; "%p" is
+ *   replaced by the process ID
+ *
+ * Start recording which parts of the loaded typelibs are accessed:
+ * the directory entries that lookups find or infos are created from,
+ * and the blobs that infos are created for.  The profile covers typelibs loaded into any
+ * #GIRepository after this call, and those already loaded into the
+ * default one; it is written to
+ * @filename when the process exits or when g_irepository_write_profile()
+ * is called.
+ *
+ * Setting the environment variable GI_TYPELIB_PROFILE to a filename
+ * has the same effect.
+ *
+ * The profile is a #GKeyFile with a group for each namespace and
+ * version, listing the size of the typelib and the indices of the
+ * accessed directory entries and offsets of the accessed blobs.
+ *
+ * Since: 1.58
+ */
+void
+g_irepository_enable_profile (const gchar *filename)
+{
+  static gboolean registered_atexit = FALSE;
+  GString *path;
+  const gchar *p;
+
+  g_return_if_fail (filename != NULL);
+
+  path = g_string_new (NULL);
+  for (p = filename; *p; p++)
+    {
+      if (p[0] == '%' && p[1] == 'p')
+        {
+#if defined (G_OS_UNIX)
+          g_string_append_printf (path, "%lu", (gulong) getpid ());
+#elif defined (G_PLATFORM_WIN32)
+          g_string_append_printf (path, "%lu", (gulong) GetCurrentProcessId ());
+#endif
+          p++;
+        }
+      else
+        g_string_append_c (path, *p);
+    }
+
+  G_LOCK (profiles);
+
+  g_free (profile_filename);
+  profile_filename = g_string_free (path, FALSE);
+
+  if (profiles == NULL)
+    profiles = g_ptr_array_new_with_free_func ((GDestroyNotify) profile_free);
+
+  /* This is also called from init_globals(), so don't go through
+   * get_repository() here. */
+  if (default_repository != NULL)
+    {
+      g_hash_table_foreach (default_repository->priv->typelibs,
+                            attach_profile_foreach, NULL);
+      g_hash_table_foreach (default_repository->priv->lazy_typelibs,
+                            attach_profile_foreach, NULL);
+    }
+
+  if (!registered_atexit)
+    {
+      atexit (write_profile_at_exit);
+      registered_atexit = TRUE;
+    }
+
+  G_UNLOCK (profiles);
+}
+
+/**
+ * g_irepository_write_profile:
+ * @error: a #GError
+ *
+ * Write the typelib access profile recorded so far to the file given
+ * to g_irepository_enable_profile().  Does nothing if profiling is
+ * not enabled.
+ *
+ * Returns: %TRUE on success, %FALSE if the file could not be written
+ *
+ * Since: 1.58
+ */
+gboolean
+g_irepository_write_profile (GError **error)
+{
+  GKeyFile *keyfile;
+  gboolean ret;
+  guint i;
+
+  G_LOCK (profiles);
+
+  if (profiles == NULL)
+    {
+      G_UNLOCK (profiles);
+      return TRUE;
+    }
+
+  keyfile = g_key_file_new ();
+
+  for (i = 0; i < profiles->len; i++)
+    {
+      GITypelibProfile *profile = g_ptr_array_index (profiles, i);
+      gchar *group;
+      GArray *list;
+      guint bit;
+
+      group = g_strdup_printf ("%s-%s", profile->namespace, profile->version);
+      g_key_file_set_uint64 (keyfile, group, "size", profile->len);
+
+      list = g_array_new (FALSE, FALSE, sizeof (gint));
+      for (bit = 0; bit < profile->n_entries; bit++)
+        if (g_atomic_int_get ((gint *) &profile->entries[bit / 32]) & (1U << (bit % 32)))
+          {
+            gint index = bit + 1;
+            g_array_append_val (list, index);
+          }
+      g_key_file_set_integer_list (keyfile, group, "entries",
+                                   (gint *) list->data, list->len);
+
+      g_array_set_size (list, 0);
+      for (bit = 0; bit < (profile->len + 3) / 4; bit++)
+        if (g_atomic_int_get ((gint *) &profile->blobs[bit / 32]) & (1U << (bit % 32)))
+          {
+            gint offset = bit * 4;
+            g_array_append_val (list, offset);
+          }
+      g_key_file_set_integer_list (keyfile, group, "blobs",
+                                   (gint *) list->data, list->len);
+
+      g_array_free (list, TRUE);
+      g_free (group);
+    }
+
+  ret = g_key_file_save_to_file (keyfile, profile_filename, error);
+  g_key_file_free (keyfile);
+
+  G_UNLOCK (profiles);
+
+  return ret;
+}
+
 static gboolean
 g_irepository_introspect_cb (const char *option_name,
 			     const char *value,
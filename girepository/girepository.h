@@ -41,6 +41,7 @@
 #include <giregisteredtypeinfo.h>
 #include <gisignalinfo.h>
 #include <gistructinfo.h>
+#include <gistructlayout.h>
 #include <gitypeinfo.h>
 #include <gitypelib.h>
 #include <gitypes.h>
@@ -83,12 +84,18 @@ struct _GIRepositoryClass
 /**
  * GIRepositoryLoadFlags:
  * @G_IREPOSITORY_LOAD_FLAG_LAZY: Lazily load the typelib.
+ * @G_IREPOSITORY_LOAD_FLAG_VALIDATE: Fully validate the typelib and the
+ *   ones it depends on before using them, unless the same contents were
+ *   validated before; see g_typelib_validate_cached().  Typelibs which
+ *   were already loaded without this flag are validated as well.
+ *   Since: 1.58
  *
  * Flags that control how a typelib is loaded.
  */
 typedef enum
 {
-  G_IREPOSITORY_LOAD_FLAG_LAZY = 1 << 0
+  G_IREPOSITORY_LOAD_FLAG_LAZY = 1 << 0,
+  G_IREPOSITORY_LOAD_FLAG_VALIDATE = 1 << 1
 } GIRepositoryLoadFlags;
 
 /* Repository */
@@ -192,6 +199,12 @@ GOptionGroup * g_irepository_get_option_group (void);
 GI_AVAILABLE_IN_ALL
 gboolean       g_irepository_dump  (const char *arg, GError **error);
 
+GI_AVAILABLE_IN_1_58
+void           g_irepository_enable_profile (const gchar *filename);
+
+GI_AVAILABLE_IN_1_58
+gboolean       g_irepository_write_profile  (GError **error);
+
 /**
  * GIRepositoryError:
  * @G_IREPOSITORY_ERROR_TYPELIB_NOT_FOUND: the typelib could not be found.
@@ -245,6 +245,142 @@ alloc_section (guint8 *data, SectionType section_id, guint32 offset)
   g_assert_not_reached ();
 }
 
+/* Same index as add_directory_index_section(), but built from the
+ * module before anything is written, so that it can be placed anywhere.
+ */
+static GITypelibHashBuilder *
+build_directory_index (GIrModule *module, guint n_local_entries)
+{
+  GITypelibHashBuilder *dirindex_builder;
+  GList *e;
+  guint i;
+
+  dirindex_builder = _gi_typelib_hash_builder_new ();
+
+  for (e = module->entries, i = 0; e && i < n_local_entries; e = e->next, i++)
+    {
+      GIrNode *node = e->data;
+      _gi_typelib_hash_builder_add_string (dirindex_builder, node->name, i);
+    }
+
+  if (!_gi_typelib_hash_builder_prepare (dirindex_builder))
+    {
+      _gi_typelib_hash_builder_destroy (dirindex_builder);
+      return NULL;
+    }
+
+  return dirindex_builder;
+}
+
+typedef struct {
+  GIrNode *node;
+  guint index;
+  guint rank;
+} LayoutEntry;
+
+static gboolean
+node_is_deprecated (GIrNode *node)
+{
+  switch (node->type)
+    {
+    case G_IR_NODE_FUNCTION:
+    case G_IR_NODE_CALLBACK:
+      return ((GIrNodeFunction *) node)->deprecated;
+    case G_IR_NODE_OBJECT:
+    case G_IR_NODE_INTERFACE:
+      return ((GIrNodeInterface *) node)->deprecated;
+    case G_IR_NODE_BOXED:
+      return ((GIrNodeBoxed *) node)->deprecated;
+    case G_IR_NODE_STRUCT:
+      return ((GIrNodeStruct *) node)->deprecated;
+    case G_IR_NODE_UNION:
+      return ((GIrNodeUnion *) node)->deprecated;
+    case G_IR_NODE_ENUM:
+    case G_IR_NODE_FLAGS:
+      return ((GIrNodeEnum *) node)->deprecated;
+    case G_IR_NODE_CONSTANT:
+      return ((GIrNodeConstant *) node)->deprecated;
+    default:
+      return FALSE;
+    }
+}
+
+/* In the hot/cold layout, the blobs of registered types, which are
+ * scanned by g_irepository_find_by_gtype() and hold the method tables,
+ * come first, then functions, then constants; deprecated entries go
+ * last.
+ */
+static guint
+get_layout_rank (GIrNode *node)
+{
+  guint rank;
+
+  switch (node->type)
+    {
+    case G_IR_NODE_OBJECT:
+    case G_IR_NODE_INTERFACE:
+    case G_IR_NODE_BOXED:
+    case G_IR_NODE_STRUCT:
+    case G_IR_NODE_UNION:
+    case G_IR_NODE_ENUM:
+    case G_IR_NODE_FLAGS:
+      rank = 0;
+      break;
+    case G_IR_NODE_FUNCTION:
+    case G_IR_NODE_CALLBACK:
+      rank = 1;
+      break;
+    default:
+      rank = 2;
+      break;
+    }
+
+  if (node_is_deprecated (node))
+    rank += 3;
+
+  return rank;
+}
+
+static gint
+layout_entry_cmp (gconstpointer a,
+		  gconstpointer b,
+		  gpointer      user_data)
+{
+  const LayoutEntry *la = a;
+  const LayoutEntry *lb = b;
+
+  if (la->rank != lb->rank)
+    return la->rank < lb->rank ? -1 : 1;
+
+  return la->index < lb->index ? -1 : la->index > lb->index;
+}
+
+/* The order in which the blobs of the directory entries are written;
+ * the directory itself always follows module->entries.
+ */
+static LayoutEntry *
+get_entries_layout (GIrModule *module, guint n_entries)
+{
+  LayoutEntry *layout;
+  GList *e;
+  guint i;
+
+  layout = g_new (LayoutEntry, n_entries);
+
+  for (e = module->entries, i = 0; i < n_entries; e = e->next, i++)
+    {
+      layout[i].node = e->data;
+      layout[i].index = i;
+      layout[i].rank = module->hot_cold_layout ? get_layout_rank (e->data) : 0;
+    }
+
+  if (module->hot_cold_layout)
+    g_qsort_with_data (layout, n_entries, sizeof (LayoutEntry),
+		       layout_entry_cmp, NULL);
+
+  return layout;
+}
+
 static guint8*
 add_directory_index_section (guint8 *data, GIrModule *module, guint32 *offset2)
 {
@@ -310,10 +446,16 @@ _g_ir_module_build_typelib (GIrModule  *module)
   guint32 size, offset, offset2, old_offset;
   GHashTable *strings;
   GHashTable *types;
+  GHashTable *signatures;
   GList *nodes_with_attributes;
   char *dependencies;
   guchar *data;
+  guint8 digest[G_TYPELIB_DIGEST_LEN];
   Section *section;
+  GITypelibHashBuilder *dirindex_builder;
+  guint32 dirindex_size;
+  LayoutEntry *layout;
+  guint k;
 
   header_size = ALIGN_VALUE (sizeof (Header), 4);
   n_local_entries = g_list_length (module->entries);
@@ -344,6 +486,10 @@ _g_ir_module_build_typelib (GIrModule  *module)
   _g_irnode_init_stats ();
   strings = g_hash_table_new (g_str_hash, g_str_equal);
   types = g_hash_table_new (g_str_hash, g_str_equal);
+  signatures = NULL;
+  if (module->share_signatures)
+    signatures = g_hash_table_new_full (g_bytes_hash, g_bytes_equal,
+					(GDestroyNotify) g_bytes_unref, NULL);
   nodes_with_attributes = NULL;
   n_entries = g_list_length (module->entries);
 
@@ -376,6 +522,16 @@ _g_ir_module_build_typelib (GIrModule  *module)
 
   size += sizeof (Section) * NUM_SECTIONS;
 
+  dirindex_builder = NULL;
+  dirindex_size = 0;
+  if (module->hot_cold_layout)
+    {
+      dirindex_builder = build_directory_index (module, n_local_entries);
+      if (dirindex_builder)
+	dirindex_size = ALIGN_VALUE (_gi_typelib_hash_builder_get_buffer_size (dirindex_builder), 4);
+      size += dirindex_size;
+    }
+
   g_message ("allocating %d bytes (%d header, %d directory, %d entries)\n",
 	  size, header_size, dir_size, size - header_size - dir_size);
 
@@ -385,7 +541,8 @@ _g_ir_module_build_typelib (GIrModule  *module)
   header = (Header *)data;
   memcpy (header, G_IR_MAGIC, 16);
   header->major_version = 4;
-  header->minor_version = 0;
+  /* Shared signatures are still readable by older parsers */
+  header->minor_version = module->share_signatures ? 1 : 0;
   header->reserved = 0;
   header->n_entries = n_entries;
   header->n_local_entries = n_local_entries;
@@ -444,42 +601,33 @@ _g_ir_module_build_typelib (GIrModule  *module)
   header->directory = offset2;
 
   /* fill in directory and content */
-  entry = (DirEntry *)&data[header->directory];
-
   offset2 += dir_size;
 
-  for (e = module->entries, i = 0; e; e = e->next, i++)
+  /* The directory index is looked at for most lookups, keep it next
+   * to the directory rather than after the attributes.
+   */
+  if (dirindex_size > 0)
+    {
+      alloc_section (data, GI_SECTION_DIRECTORY_INDEX, offset2);
+      _gi_typelib_hash_builder_pack (dirindex_builder, data + offset2, dirindex_size);
+      offset2 += dirindex_size;
+    }
+
+  layout = get_entries_layout (module, n_entries);
+
+  for (k = 0; k < n_entries; k++)
     {
       GIrTypelibBuild build;
-      GIrNode *node = e->data;
+      GIrNode *node = layout[k].node;
+
+      i = layout[k].index;
+      entry = (DirEntry *)&data[header->directory + i * sizeof (DirEntry)];
 
       if (strchr (node->name, '.'))
         {
 	  g_error ("Names may not contain '.'");
 	}
 
-      /* we picked up implicit xref nodes, start over */
-      if (i == n_entries)
-	{
-	  GList *link;
-	  g_message ("Found implicit cross references, starting over");
-
-	  g_hash_table_destroy (strings);
-	  g_hash_table_destroy (types);
-
-	  /* Reset the cached offsets */
-	  for (link = nodes_with_attributes; link; link = link->next)
-	    ((GIrNode *) link->data)->offset = 0;
-
-	  g_list_free (nodes_with_attributes);
-	  strings = NULL;
-
-	  g_free (data);
-	  data = NULL;
-
-	  goto restart;
-	}
-
       offset = offset2;
 
       if (node->type == G_IR_NODE_XREF)
@@ -505,6 +653,7 @@ _g_ir_module_build_typelib (GIrModule  *module)
 	  build.module = module;
 	  build.strings = strings;
 	  build.types = types;
+	  build.signatures = signatures;
 	  build.nodes_with_attributes = nodes_with_attributes;
 	  build.n_attributes = header->n_attributes;
 	  build.data = data;
@@ -516,8 +665,34 @@ _g_ir_module_build_typelib (GIrModule  *module)
 	  if (offset2 > old_offset + _g_ir_node_get_full_size (node))
 	    g_error ("left a hole of %d bytes\n", offset2 - old_offset - _g_ir_node_get_full_size (node));
 	}
+    }
 
-      entry++;
+  g_free (layout);
+
+  /* we picked up implicit xref nodes, start over */
+  if (g_list_length (module->entries) != n_entries)
+    {
+      GList *link;
+      g_message ("Found implicit cross references, starting over");
+
+      g_hash_table_destroy (strings);
+      g_hash_table_destroy (types);
+      if (signatures)
+	g_hash_table_destroy (signatures);
+      if (dirindex_builder)
+	_gi_typelib_hash_builder_destroy (dirindex_builder);
+
+      /* Reset the cached offsets */
+      for (link = nodes_with_attributes; link; link = link->next)
+	((GIrNode *) link->data)->offset = 0;
+
+      g_list_free (nodes_with_attributes);
+      strings = NULL;
+
+      g_free (data);
+      data = NULL;
+
+      goto restart;
     }
 
   /* GIBaseInfo expects the AttributeBlob array to be sorted on the field (offset) */
@@ -543,10 +718,19 @@ _g_ir_module_build_typelib (GIrModule  *module)
   data = g_realloc (data, offset2);
   header = (Header*) data;
 
-  data = add_directory_index_section (data, module, &offset2);
-  header = (Header *)data;
+  if (!module->hot_cold_layout)
+    {
+      data = add_directory_index_section (data, module, &offset2);
+      header = (Header *)data;
+    }
+  else if (dirindex_builder)
+    _gi_typelib_hash_builder_destroy (dirindex_builder);
 
   length = header->size = offset2;
+
+  g_typelib_compute_checksum (data, length, digest);
+  memcpy (header->checksum, digest, sizeof (header->checksum));
+
   typelib = g_typelib_new_from_memory (data, length, &error);
   if (!typelib)
     {
@@ -556,6 +740,8 @@ _g_ir_module_build_typelib (GIrModule  *module)
 
   g_hash_table_destroy (strings);
   g_hash_table_destroy (types);
+  if (signatures)
+    g_hash_table_destroy (signatures);
   g_list_free (nodes_with_attributes);
 
   return typelib;
@@ -34,6 +34,7 @@ struct _GIrTypelibBuild {
   GIrModule  *module;
   GHashTable  *strings;
   GHashTable  *types;
+  GHashTable  *signatures;
   GList       *nodes_with_attributes;
   guint32      n_attributes;
   guchar      *data;
@@ -58,6 +59,14 @@ struct _GIrModule
   /* Structures with the 'disguised' flag (typedef struct _X *X)
   * in the module or in included modules */
   GHashTable *disguised_structures;
+
+  /* Whether functions with identical signatures share a single
+   * SignatureBlob in the built typelib */
+  gboolean share_signatures;
+
+  /* Whether the data used by most lookups is grouped at the start of
+   * the built typelib, and the rest moved to the end */
+  gboolean hot_cold_layout;
 };
 
 GIrModule *_g_ir_module_new            (const gchar *name,
@@ -39,6 +39,9 @@ static gulong string_size = 0;
 static gulong unique_string_size = 0;
 static gulong types_count = 0;
 static gulong unique_types_count = 0;
+static gulong signatures_count = 0;
+static gulong unique_signatures_count = 0;
+static gulong shared_signatures_size = 0;
 
 void
 _g_irnode_init_stats (void)
@@ -49,6 +52,9 @@ _g_irnode_init_stats (void)
   unique_string_size = 0;
   types_count = 0;
   unique_types_count = 0;
+  signatures_count = 0;
+  unique_signatures_count = 0;
+  shared_signatures_size = 0;
 }
 
 void
@@ -57,6 +63,9 @@ _g_irnode_dump_stats (void)
   g_message ("%lu strings (%lu before sharing), %lu bytes (%lu before sharing)",
 	     unique_string_count, string_count, unique_string_size, string_size);
   g_message ("%lu types (%lu before sharing)", unique_types_count, types_count);
+  if (signatures_count > 0)
+    g_message ("%lu signatures (%lu before sharing), %lu bytes saved",
+	       unique_signatures_count, signatures_count, shared_signatures_size);
 }
 
 #define DO_ALIGNED_COPY(dest_addr, value, type) \
@@ -1377,6 +1386,77 @@ _g_ir_node_check_unhandled_members (GList         **members,
 #endif
 }
 
+/* Reserves the space of a signature blob with n_args arguments.  Without
+ * signature sharing, this happens before the strings of the function are
+ * written, as it always did, so the output doesn't change.
+ */
+static guint32
+reserve_signature (guint32 *offset2,
+		   gint     n_args)
+{
+  guint32 signature = *offset2;
+
+  *offset2 += sizeof (SignatureBlob) + n_args * sizeof (ArgBlob);
+
+  return signature;
+}
+
+/* When build->signatures is set, a signature blob (with its args) which
+ * is identical to one written before is dropped again, and the earlier
+ * one is used instead.  The strings and types a signature refers to are
+ * written after it, so identical contents mean nothing new was written
+ * and the space can be reused.  Signatures with attributes are never
+ * shared since attributes are looked up by blob offset.
+ */
+static guint32
+share_signature (GIrTypelibBuild *build,
+		 guint32          signature,
+		 GIrNodeParam    *result,
+		 GList           *parameters,
+		 guint32         *offset2)
+{
+  guint32 size;
+  GBytes *bytes;
+  gpointer shared;
+  GList *l;
+
+  if (build->signatures == NULL)
+    return signature;
+
+  if (g_hash_table_size (((GIrNode *) result)->attributes) > 0)
+    return signature;
+  for (l = parameters; l; l = l->next)
+    if (g_hash_table_size (((GIrNode *) l->data)->attributes) > 0)
+      return signature;
+
+  signatures_count += 1;
+
+  size = sizeof (SignatureBlob) + g_list_length (parameters) * sizeof (ArgBlob);
+  bytes = g_bytes_new (&build->data[signature], size);
+
+  if (!g_hash_table_lookup_extended (build->signatures, bytes, NULL, &shared) ||
+      *offset2 != signature + size)
+    {
+      unique_signatures_count += 1;
+      g_hash_table_replace (build->signatures, bytes, GUINT_TO_POINTER (signature));
+      return signature;
+    }
+
+  g_bytes_unref (bytes);
+
+  /* Point the nodes at the shared blobs, and give the space back */
+  if (((GIrNode *) result)->offset == signature)
+    ((GIrNode *) result)->offset = GPOINTER_TO_UINT (shared);
+  for (l = parameters; l; l = l->next)
+    ((GIrNode *) l->data)->offset += GPOINTER_TO_UINT (shared) - signature;
+
+  memset (&build->data[signature], 0, size);
+  *offset2 = signature;
+  shared_signatures_size += size;
+
+  return GPOINTER_TO_UINT (shared);
+}
+
 void
 _g_ir_node_build_typelib (GIrNode         *node,
 			  GIrNode         *parent,
@@ -1634,16 +1714,16 @@ _g_ir_node_build_typelib (GIrNode         *node,
     case G_IR_NODE_FUNCTION:
       {
 	FunctionBlob *blob = (FunctionBlob *)&data[*offset];
-	SignatureBlob *blob2 = (SignatureBlob *)&data[*offset2];
+	SignatureBlob *blob2;
 	GIrNodeFunction *function = (GIrNodeFunction *)node;
-	guint32 signature;
+	guint32 signature = 0;
 	gint n;
 
-	signature = *offset2;
 	n = g_list_length (function->parameters);
 
 	*offset += sizeof (FunctionBlob);
-	*offset2 += sizeof (SignatureBlob) + n * sizeof (ArgBlob);
+	if (build->signatures == NULL)
+	  signature = reserve_signature (offset2, n);
 
 	blob->blob_type = BLOB_TYPE_FUNCTION;
 	blob->deprecated = function->deprecated;
@@ -1656,6 +1736,10 @@ _g_ir_node_build_typelib (GIrNode         *node,
 	blob->index = 0;
 	blob->name = _g_ir_write_string (node->name, strings, data, offset2);
 	blob->symbol = _g_ir_write_string (function->symbol, strings, data, offset2);
+
+	if (build->signatures != NULL)
+	  signature = reserve_signature (offset2, n);
+	blob2 = (SignatureBlob *)&data[signature];
 	blob->signature = signature;
 
         /* function->result is special since it doesn't appear in the serialized format but
@@ -1689,27 +1773,33 @@ _g_ir_node_build_typelib (GIrNode         *node,
 	    _g_ir_node_build_typelib (param, node, build, &signature, offset2, NULL);
 	  }
 
+	blob->signature = share_signature (build, blob->signature, function->result,
+					   function->parameters, offset2);
       }
       break;
 
     case G_IR_NODE_CALLBACK:
       {
 	CallbackBlob *blob = (CallbackBlob *)&data[*offset];
-	SignatureBlob *blob2 = (SignatureBlob *)&data[*offset2];
+	SignatureBlob *blob2;
 	GIrNodeFunction *function = (GIrNodeFunction *)node;
-	guint32 signature;
+	guint32 signature = 0;
 	gint n;
 
-	signature = *offset2;
 	n = g_list_length (function->parameters);
 
 	*offset += sizeof (CallbackBlob);
-	*offset2 += sizeof (SignatureBlob) + n * sizeof (ArgBlob);
+	if (build->signatures == NULL)
+	  signature = reserve_signature (offset2, n);
 
 	blob->blob_type = BLOB_TYPE_CALLBACK;
 	blob->deprecated = function->deprecated;
 	blob->reserved = 0;
 	blob->name = _g_ir_write_string (node->name, strings, data, offset2);
+
+	if (build->signatures != NULL)
+	  signature = reserve_signature (offset2, n);
+	blob2 = (SignatureBlob *)&data[signature];
 	blob->signature = signature;
 
         _g_ir_node_build_typelib ((GIrNode *)function->result->type,
@@ -1730,22 +1820,25 @@ _g_ir_node_build_typelib (GIrNode         *node,
 
 	    _g_ir_node_build_typelib (param, node, build, &signature, offset2, NULL);
 	  }
+
+	blob->signature = share_signature (build, blob->signature, function->result,
+					   function->parameters, offset2);
       }
       break;
 
     case G_IR_NODE_SIGNAL:
       {
 	SignalBlob *blob = (SignalBlob *)&data[*offset];
-	SignatureBlob *blob2 = (SignatureBlob *)&data[*offset2];
+	SignatureBlob *blob2;
 	GIrNodeSignal *signal = (GIrNodeSignal *)node;
-	guint32 signature;
+	guint32 signature = 0;
 	gint n;
 
-	signature = *offset2;
 	n = g_list_length (signal->parameters);
 
 	*offset += sizeof (SignalBlob);
-	*offset2 += sizeof (SignatureBlob) + n * sizeof (ArgBlob);
+	if (build->signatures == NULL)
+	  signature = reserve_signature (offset2, n);
 
 	blob->deprecated = signal->deprecated;
 	blob->run_first = signal->run_first;
@@ -1760,6 +1853,10 @@ _g_ir_node_build_typelib (GIrNode         *node,
 	blob->reserved = 0;
 	blob->class_closure = 0; /* FIXME */
 	blob->name = _g_ir_write_string (node->name, strings, data, offset2);
+
+	if (build->signatures != NULL)
+	  signature = reserve_signature (offset2, n);
+	blob2 = (SignatureBlob *)&data[signature];
 	blob->signature = signature;
 
         /* signal->result is special since it doesn't appear in the serialized format but
@@ -1788,24 +1885,31 @@ _g_ir_node_build_typelib (GIrNode         *node,
 
 	    _g_ir_node_build_typelib (param, node, build, &signature, offset2, NULL);
 	  }
+
+	blob->signature = share_signature (build, blob->signature, signal->result,
+					   signal->parameters, offset2);
       }
       break;
 
     case G_IR_NODE_VFUNC:
       {
 	VFuncBlob *blob = (VFuncBlob *)&data[*offset];
-	SignatureBlob *blob2 = (SignatureBlob *)&data[*offset2];
+	SignatureBlob *blob2;
 	GIrNodeVFunc *vfunc = (GIrNodeVFunc *)node;
-	guint32 signature;
+	guint32 signature = 0;
 	gint n;
 
-	signature = *offset2;
 	n = g_list_length (vfunc->parameters);
 
 	*offset += sizeof (VFuncBlob);
-	*offset2 += sizeof (SignatureBlob) + n * sizeof (ArgBlob);
+	if (build->signatures == NULL)
+	  signature = reserve_signature (offset2, n);
 
 	blob->name = _g_ir_write_string (node->name, strings, data, offset2);
+
+	if (build->signatures != NULL)
+	  signature = reserve_signature (offset2, n);
+	blob2 = (SignatureBlob *)&data[signature];
 	blob->must_chain_up = 0; /* FIXME */
 	blob->must_be_implemented = 0; /* FIXME */
 	blob->must_not_be_implemented = 0; /* FIXME */
@@ -1848,6 +1952,9 @@ _g_ir_node_build_typelib (GIrNode         *node,
 
 	    _g_ir_node_build_typelib (param, node, build, &signature, offset2, NULL);
 	  }
+
+	blob->signature = share_signature (build, blob->signature, vfunc->result,
+					   vfunc->parameters, offset2);
       }
       break;
 
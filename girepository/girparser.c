@@ -312,6 +312,23 @@ locate_gir (GIrParser  *parser,
   return NULL;
 }
 
+/**
+ * _g_ir_parser_locate_gir:
+ * @parser: a #GIrParser
+ * @girname: the GIR file name, e.g. "GLib-2.0.gir"
+ *
+ * Resolves @girname using the same search path as is used for
+ * &lt;include&gt; elements while parsing.
+ *
+ * Returns: (transfer full) (nullable): the full path to the GIR file
+ */
+char *
+_g_ir_parser_locate_gir (GIrParser  *parser,
+			 const char *girname)
+{
+  return locate_gir (parser, girname);
+}
+
 #define MISSING_ATTRIBUTE(context,error,element,attribute)			        \
   do {                                                                          \
     int line_number, char_number;                                                \
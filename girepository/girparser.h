@@ -34,6 +34,8 @@ GIrParser *_g_ir_parser_new          (void);
 void       _g_ir_parser_free         (GIrParser          *parser);
 void       _g_ir_parser_set_includes (GIrParser          *parser,
 				      const gchar *const *includes);
+char      *_g_ir_parser_locate_gir   (GIrParser          *parser,
+				      const char         *girname);
 
 GIrModule *_g_ir_parser_parse_string (GIrParser    *parser,
 				      const gchar  *namespace,
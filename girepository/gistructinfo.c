@@ -80,20 +80,16 @@ g_struct_get_field_offset (GIStructInfo *info,
 			   gint         n)
 {
   GIRealInfo *rinfo = (GIRealInfo *)info;
+  StructBlob *blob = (StructBlob *)&rinfo->typelib->data[rinfo->offset];
   Header *header = (Header *)rinfo->typelib->data;
-  guint32 offset = rinfo->offset + header->struct_blob_size;
-  gint i;
-  FieldBlob *field_blob;
+  const guint32 *offsets;
 
-  for (i = 0; i < n; i++)
-    {
-      field_blob = (FieldBlob *)&rinfo->typelib->data[offset];
-      offset += header->field_blob_size;
-      if (field_blob->has_embedded_type)
-        offset += header->callback_blob_size;
-    }
+  g_return_val_if_fail (n >= 0 && n <= blob->n_fields, 0);
 
-  return offset;
+  offsets = g_typelib_get_field_offsets (rinfo->typelib,
+                                         rinfo->offset + header->struct_blob_size,
+                                         blob->n_fields);
+  return offsets[n];
 }
 
 /**
@@ -214,11 +210,9 @@ g_struct_info_find_method (GIStructInfo *info,
 {
   gint offset;
   GIRealInfo *rinfo = (GIRealInfo *)info;
-  Header *header = (Header *)rinfo->typelib->data;
   StructBlob *blob = (StructBlob *)&rinfo->typelib->data[rinfo->offset];
 
-  offset = rinfo->offset + header->struct_blob_size
-    + blob->n_fields * header->field_blob_size;
+  offset = g_struct_get_field_offset (info, blob->n_fields);
 
   return _g_base_info_find_method ((GIBaseInfo*)info, offset, blob->n_methods, name);
 }
@@ -0,0 +1,544 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ * GObject introspection: Struct layout implementation
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#include "config.h"
+
+#include <string.h>
+
+#include <glib.h>
+
+#include <girepository.h>
+
+/**
+ * SECTION:gistructlayout
+ * @title: GIStructLayout
+ * @short_description: Bulk access to the fields of a C structure
+ *
+ * A GIStructLayout describes how every field of a struct, union or
+ * object instance is read and written, in a flat array of
+ * #GIStructLayoutField built once from its #GIFieldInfo<!-- -->s.
+ *
+ * g_struct_layout_get_values() and g_struct_layout_set_values() then
+ * copy all the fields between a C structure and an array of
+ * #GIArgument, the same way g_field_info_get_field() and
+ * g_field_info_set_field() would for each of them, but without
+ * looking up their types again.  g_struct_layout_pack() and
+ * g_struct_layout_unpack() copy the fields of simple C types to and from
+ * a packed buffer.
+ *
+ * Since: 1.58
+ */
+
+struct _GIStructLayout
+{
+  guint n_fields;
+  gsize packed_size;
+  GIStructLayoutField fields[1];
+};
+
+static guint16
+get_scalar_size (GITypeTag tag)
+{
+  switch (tag)
+    {
+    case GI_TYPE_TAG_BOOLEAN:
+      return sizeof (gboolean);
+    case GI_TYPE_TAG_INT8:
+    case GI_TYPE_TAG_UINT8:
+      return sizeof (guint8);
+    case GI_TYPE_TAG_INT16:
+    case GI_TYPE_TAG_UINT16:
+      return sizeof (guint16);
+    case GI_TYPE_TAG_INT32:
+    case GI_TYPE_TAG_UINT32:
+    case GI_TYPE_TAG_UNICHAR:
+      return sizeof (guint32);
+    case GI_TYPE_TAG_INT64:
+    case GI_TYPE_TAG_UINT64:
+      return sizeof (guint64);
+    case GI_TYPE_TAG_GTYPE:
+      return sizeof (gsize);
+    case GI_TYPE_TAG_FLOAT:
+      return sizeof (gfloat);
+    case GI_TYPE_TAG_DOUBLE:
+      return sizeof (gdouble);
+    default:
+      return 0;
+    }
+}
+
+static void
+init_field (GIStructLayoutField *field,
+            GIFieldInfo         *field_info)
+{
+  GIFieldInfoFlags flags;
+  GITypeInfo *type_info;
+  GIBaseInfo *interface;
+  GIInfoType interface_type;
+  gboolean readable, writable;
+
+  flags = g_field_info_get_flags (field_info);
+  readable = (flags & GI_FIELD_IS_READABLE) != 0;
+  writable = (flags & GI_FIELD_IS_WRITABLE) != 0;
+
+  type_info = g_field_info_get_type (field_info);
+  field->offset = g_field_info_get_offset (field_info);
+  field->tag = g_type_info_get_tag (type_info);
+
+  if (field->tag == GI_TYPE_TAG_INTERFACE)
+    {
+      interface = g_type_info_get_interface (type_info);
+      interface_type = g_base_info_get_type (interface);
+    }
+  else
+    {
+      interface = NULL;
+      interface_type = GI_INFO_TYPE_INVALID;
+    }
+
+  if (g_type_info_is_pointer (type_info))
+    {
+      field->is_pointer = TRUE;
+      field->readable = readable;
+      /* Setting other pointers would need memory management */
+      field->writable = writable &&
+        (interface_type == GI_INFO_TYPE_OBJECT ||
+         interface_type == GI_INFO_TYPE_INTERFACE);
+    }
+  else if (interface_type == GI_INFO_TYPE_ENUM ||
+           interface_type == GI_INFO_TYPE_FLAGS)
+    {
+      field->tag = g_enum_info_get_storage_type ((GIEnumInfo *)interface);
+      field->size = get_scalar_size (field->tag);
+      field->is_enum = TRUE;
+      field->readable = readable && field->size > 0;
+      field->writable = writable && field->size > 0;
+    }
+  else if (field->tag == GI_TYPE_TAG_ARRAY)
+    {
+      /* Read as a pointer to the embedded fixed-size array */
+      field->readable = readable;
+    }
+  else if (field->tag != GI_TYPE_TAG_INTERFACE)
+    {
+      field->size = get_scalar_size (field->tag);
+      field->readable = readable && field->size > 0;
+      field->writable = writable && field->size > 0;
+    }
+
+  if (interface)
+    g_base_info_unref (interface);
+  g_base_info_unref ((GIBaseInfo *)type_info);
+}
+
+/**
+ * g_struct_layout_new: (skip)
+ * @info: a #GIStructInfo, #GIUnionInfo or #GIObjectInfo
+ *
+ * Builds the layout of the fields of @info.  Building it looks up the
+ * type of every field, so it should be kept around for as long as the
+ * type is used.
+ *
+ * Returns: (transfer full): the #GIStructLayout, free it with
+ * g_struct_layout_free() when done
+ *
+ * Since: 1.58
+ */
+GIStructLayout *
+g_struct_layout_new (GIBaseInfo *info)
+{
+  GIStructLayout *layout;
+  GIInfoType type;
+  gint n_fields;
+  gint i;
+
+  g_return_val_if_fail (info != NULL, NULL);
+
+  type = g_base_info_get_type (info);
+  switch (type)
+    {
+    case GI_INFO_TYPE_STRUCT:
+    case GI_INFO_TYPE_BOXED:
+      n_fields = g_struct_info_get_n_fields ((GIStructInfo *)info);
+      break;
+    case GI_INFO_TYPE_UNION:
+      n_fields = g_union_info_get_n_fields ((GIUnionInfo *)info);
+      break;
+    case GI_INFO_TYPE_OBJECT:
+      n_fields = g_object_info_get_n_fields ((GIObjectInfo *)info);
+      break;
+    default:
+      g_return_val_if_reached (NULL);
+    }
+
+  layout = g_malloc0 (G_STRUCT_OFFSET (GIStructLayout, fields) +
+                      MAX (n_fields, 1) * sizeof (GIStructLayoutField));
+  layout->n_fields = n_fields;
+
+  for (i = 0; i < n_fields; i++)
+    {
+      GIStructLayoutField *field = &layout->fields[i];
+      GIFieldInfo *field_info;
+
+      if (type == GI_INFO_TYPE_UNION)
+        field_info = g_union_info_get_field ((GIUnionInfo *)info, i);
+      else if (type == GI_INFO_TYPE_OBJECT)
+        field_info = g_object_info_get_field ((GIObjectInfo *)info, i);
+      else
+        field_info = g_struct_info_get_field ((GIStructInfo *)info, i);
+
+      init_field (field, field_info);
+      if (field->readable)
+        layout->packed_size += field->size;
+
+      g_base_info_unref ((GIBaseInfo *)field_info);
+    }
+
+  return layout;
+}
+
+/**
+ * g_struct_layout_free: (skip)
+ * @layout: a #GIStructLayout
+ *
+ * Frees @layout.
+ *
+ * Since: 1.58
+ */
+void
+g_struct_layout_free (GIStructLayout *layout)
+{
+  g_free (layout);
+}
+
+/**
+ * g_struct_layout_get_fields: (skip)
+ * @layout: a #GIStructLayout
+ * @n_fields: (out): return location for the number of fields
+ *
+ * Obtain the layout of every field, in the order of the fields of the
+ * info @layout was built from.
+ *
+ * Returns: (transfer none) (array length=n_fields): the fields
+ *
+ * Since: 1.58
+ */
+const GIStructLayoutField *
+g_struct_layout_get_fields (GIStructLayout *layout,
+                            guint          *n_fields)
+{
+  g_return_val_if_fail (layout != NULL, NULL);
+  g_return_val_if_fail (n_fields != NULL, NULL);
+
+  *n_fields = layout->n_fields;
+  return layout->fields;
+}
+
+/**
+ * g_struct_layout_get_values: (skip)
+ * @layout: a #GIStructLayout
+ * @mem: pointer to a block of memory representing a C structure or union
+ * @values: an array of one #GIArgument per field
+ *
+ * Reads every readable field of @layout from @mem into the #GIArgument
+ * with the same index in @values, as g_field_info_get_field() would.
+ * The other arguments are left untouched.
+ *
+ * Returns: the number of fields read
+ *
+ * Since: 1.58
+ */
+guint
+g_struct_layout_get_values (GIStructLayout *layout,
+                            gconstpointer   mem,
+                            GIArgument     *values)
+{
+  guint n_read = 0;
+  guint i;
+
+  g_return_val_if_fail (layout != NULL, 0);
+  g_return_val_if_fail (mem != NULL, 0);
+  g_return_val_if_fail (values != NULL, 0);
+
+  for (i = 0; i < layout->n_fields; i++)
+    {
+      const GIStructLayoutField *field = &layout->fields[i];
+      GIArgument *value = &values[i];
+
+      if (!field->readable)
+        continue;
+
+      if (field->is_pointer)
+        value->v_pointer = G_STRUCT_MEMBER (gpointer, mem, field->offset);
+      else if (field->is_enum)
+        {
+          /* See the FIXME in g_field_info_get_field() */
+          switch (field->size)
+            {
+            case 1:
+              value->v_int = (gint)G_STRUCT_MEMBER (guint8, mem, field->offset);
+              break;
+            case 2:
+              value->v_int = (gint)G_STRUCT_MEMBER (guint16, mem, field->offset);
+              break;
+            case 4:
+              value->v_int = (gint)G_STRUCT_MEMBER (guint32, mem, field->offset);
+              break;
+            case 8:
+              value->v_int = (gint)G_STRUCT_MEMBER (guint64, mem, field->offset);
+              break;
+            default:
+              g_assert_not_reached ();
+            }
+        }
+      else
+        {
+          switch (field->tag)
+            {
+            case GI_TYPE_TAG_BOOLEAN:
+              value->v_boolean = G_STRUCT_MEMBER (gboolean, mem, field->offset) != FALSE;
+              break;
+            case GI_TYPE_TAG_INT8:
+            case GI_TYPE_TAG_UINT8:
+              value->v_uint8 = G_STRUCT_MEMBER (guint8, mem, field->offset);
+              break;
+            case GI_TYPE_TAG_INT16:
+            case GI_TYPE_TAG_UINT16:
+              value->v_uint16 = G_STRUCT_MEMBER (guint16, mem, field->offset);
+              break;
+            case GI_TYPE_TAG_INT32:
+            case GI_TYPE_TAG_UINT32:
+            case GI_TYPE_TAG_UNICHAR:
+              value->v_uint32 = G_STRUCT_MEMBER (guint32, mem, field->offset);
+              break;
+            case GI_TYPE_TAG_INT64:
+            case GI_TYPE_TAG_UINT64:
+              value->v_uint64 = G_STRUCT_MEMBER (guint64, mem, field->offset);
+              break;
+            case GI_TYPE_TAG_GTYPE:
+              value->v_size = G_STRUCT_MEMBER (gsize, mem, field->offset);
+              break;
+            case GI_TYPE_TAG_FLOAT:
+              value->v_float = G_STRUCT_MEMBER (gfloat, mem, field->offset);
+              break;
+            case GI_TYPE_TAG_DOUBLE:
+              value->v_double = G_STRUCT_MEMBER (gdouble, mem, field->offset);
+              break;
+            case GI_TYPE_TAG_ARRAY:
+              value->v_pointer = G_STRUCT_MEMBER_P (mem, field->offset);
+              break;
+            default:
+              g_assert_not_reached ();
+            }
+        }
+
+      n_read++;
+    }
+
+  return n_read;
+}
+
+/**
+ * g_struct_layout_set_values: (skip)
+ * @layout: a #GIStructLayout
+ * @mem: pointer to a block of memory representing a C structure or union
+ * @values: an array of one #GIArgument per field
+ *
+ * Writes every writable field of @layout in @mem from the #GIArgument
+ * with the same index in @values, as g_field_info_set_field() would.
+ * The other arguments are ignored.
+ *
+ * Returns: the number of fields written
+ *
+ * Since: 1.58
+ */
+guint
+g_struct_layout_set_values (GIStructLayout   *layout,
+                            gpointer          mem,
+                            const GIArgument *values)
+{
+  guint n_written = 0;
+  guint i;
+
+  g_return_val_if_fail (layout != NULL, 0);
+  g_return_val_if_fail (mem != NULL, 0);
+  g_return_val_if_fail (values != NULL, 0);
+
+  for (i = 0; i < layout->n_fields; i++)
+    {
+      const GIStructLayoutField *field = &layout->fields[i];
+      const GIArgument *value = &values[i];
+
+      if (!field->writable)
+        continue;
+
+      if (field->is_pointer)
+        G_STRUCT_MEMBER (gpointer, mem, field->offset) = value->v_pointer;
+      else if (field->is_enum)
+        {
+          switch (field->size)
+            {
+            case 1:
+              G_STRUCT_MEMBER (guint8, mem, field->offset) = (guint8)value->v_int;
+              break;
+            case 2:
+              G_STRUCT_MEMBER (guint16, mem, field->offset) = (guint16)value->v_int;
+              break;
+            case 4:
+              G_STRUCT_MEMBER (guint32, mem, field->offset) = (guint32)value->v_int;
+              break;
+            case 8:
+              G_STRUCT_MEMBER (guint64, mem, field->offset) = (guint64)value->v_int;
+              break;
+            default:
+              g_assert_not_reached ();
+            }
+        }
+      else
+        {
+          switch (field->tag)
+            {
+            case GI_TYPE_TAG_BOOLEAN:
+              G_STRUCT_MEMBER (gboolean, mem, field->offset) = value->v_boolean != FALSE;
+              break;
+            case GI_TYPE_TAG_INT8:
+            case GI_TYPE_TAG_UINT8:
+              G_STRUCT_MEMBER (guint8, mem, field->offset) = value->v_uint8;
+              break;
+            case GI_TYPE_TAG_INT16:
+            case GI_TYPE_TAG_UINT16:
+              G_STRUCT_MEMBER (guint16, mem, field->offset) = value->v_uint16;
+              break;
+            case GI_TYPE_TAG_INT32:
+            case GI_TYPE_TAG_UINT32:
+            case GI_TYPE_TAG_UNICHAR:
+              G_STRUCT_MEMBER (guint32, mem, field->offset) = value->v_uint32;
+              break;
+            case GI_TYPE_TAG_INT64:
+            case GI_TYPE_TAG_UINT64:
+              G_STRUCT_MEMBER (guint64, mem, field->offset) = value->v_uint64;
+              break;
+            case GI_TYPE_TAG_GTYPE:
+              G_STRUCT_MEMBER (gsize, mem, field->offset) = value->v_size;
+              break;
+            case GI_TYPE_TAG_FLOAT:
+              G_STRUCT_MEMBER (gfloat, mem, field->offset) = value->v_float;
+              break;
+            case GI_TYPE_TAG_DOUBLE:
+              G_STRUCT_MEMBER (gdouble, mem, field->offset) = value->v_double;
+              break;
+            default:
+              g_assert_not_reached ();
+            }
+        }
+
+      n_written++;
+    }
+
+  return n_written;
+}
+
+/**
+ * g_struct_layout_get_packed_size: (skip)
+ * @layout: a #GIStructLayout
+ *
+ * Obtain the size of the buffer written by g_struct_layout_pack().
+ *
+ * Returns: the size in bytes
+ *
+ * Since: 1.58
+ */
+gsize
+g_struct_layout_get_packed_size (GIStructLayout *layout)
+{
+  g_return_val_if_fail (layout != NULL, 0);
+
+  return layout->packed_size;
+}
+
+/**
+ * g_struct_layout_pack: (skip)
+ * @layout: a #GIStructLayout
+ * @mem: pointer to a block of memory representing a C structure or union
+ * @buffer: a buffer of g_struct_layout_get_packed_size() bytes
+ *
+ * Copies the readable fields of @layout which have a packed size, that
+ * is those of simple C types, from @mem to @buffer.  They are stored one
+ * after the other in the order of the fields, in host byte order and
+ * without any padding.
+ *
+ * Since: 1.58
+ */
+void
+g_struct_layout_pack (GIStructLayout *layout,
+                      gconstpointer   mem,
+                      guint8         *buffer)
+{
+  guint i;
+
+  g_return_if_fail (layout != NULL);
+  g_return_if_fail (mem != NULL);
+  g_return_if_fail (buffer != NULL || layout->packed_size == 0);
+
+  for (i = 0; i < layout->n_fields; i++)
+    {
+      const GIStructLayoutField *field = &layout->fields[i];
+
+      if (!field->readable || field->size == 0)
+        continue;
+
+      memcpy (buffer, G_STRUCT_MEMBER_P (mem, field->offset), field->size);
+      buffer += field->size;
+    }
+}
+
+/**
+ * g_struct_layout_unpack: (skip)
+ * @layout: a #GIStructLayout
+ * @buffer: a buffer written by g_struct_layout_pack()
+ * @mem: pointer to a block of memory representing a C structure or union
+ *
+ * Copies the fields packed in @buffer back to @mem.  Fields which are
+ * packed but not writable are skipped.
+ *
+ * Since: 1.58
+ */
+void
+g_struct_layout_unpack (GIStructLayout *layout,
+                        const guint8   *buffer,
+                        gpointer        mem)
+{
+  guint i;
+
+  g_return_if_fail (layout != NULL);
+  g_return_if_fail (buffer != NULL || layout->packed_size == 0);
+  g_return_if_fail (mem != NULL);
+
+  for (i = 0; i < layout->n_fields; i++)
+    {
+      const GIStructLayoutField *field = &layout->fields[i];
+
+      if (!field->readable || field->size == 0)
+        continue;
+
+      if (field->writable)
+        memcpy (G_STRUCT_MEMBER_P (mem, field->offset), buffer, field->size);
+      buffer += field->size;
+    }
+}
@@ -0,0 +1,93 @@
+/* -*- mode: C; c-file-style: "gnu"; indent-tabs-mode: nil; -*-
+ * GObject introspection: Struct layouts
+ *
+ * This library is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2 of the License, or (at your option) any later version.
+ *
+ * This library is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with this library; if not, write to the
+ * Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+ * Boston, MA 02111-1307, USA.
+ */
+
+#ifndef __GISTRUCTLAYOUT_H__
+#define __GISTRUCTLAYOUT_H__
+
+#if !defined (__GIREPOSITORY_H_INSIDE__) && !defined (GI_COMPILATION)
+#error "Only <girepository.h> can be included directly."
+#endif
+
+#include <gitypes.h>
+
+G_BEGIN_DECLS
+
+typedef struct _GIStructLayout GIStructLayout;
+
+/**
+ * GIStructLayoutField:
+ * @offset: offset of the field in the structure, in bytes
+ * @size: number of bytes the field takes in a packed buffer, or 0 if it
+ *   is not packed
+ * @tag: the #GITypeTag of the field; the storage type for enums and flags
+ * @is_pointer: whether the field holds a pointer
+ * @is_enum: whether the field holds an enum or flags value
+ * @readable: whether g_struct_layout_get_values() reads the field
+ * @writable: whether g_struct_layout_set_values() writes the field
+ *
+ * How a field is read and written by the bulk accessors of a
+ * #GIStructLayout.
+ */
+typedef struct {
+  guint32   offset;
+  guint16   size;
+  guint8    tag;
+  guint     is_pointer : 1;
+  guint     is_enum    : 1;
+  guint     readable   : 1;
+  guint     writable   : 1;
+} GIStructLayoutField;
+
+GI_AVAILABLE_IN_1_58
+GIStructLayout *          g_struct_layout_new             (GIBaseInfo       *info);
+
+GI_AVAILABLE_IN_1_58
+void                      g_struct_layout_free            (GIStructLayout   *layout);
+
+GI_AVAILABLE_IN_1_58
+const GIStructLayoutField *g_struct_layout_get_fields     (GIStructLayout   *layout,
+                                                           guint            *n_fields);
+
+GI_AVAILABLE_IN_1_58
+guint                     g_struct_layout_get_values      (GIStructLayout   *layout,
+                                                           gconstpointer     mem,
+                                                           GIArgument       *values);
+
+GI_AVAILABLE_IN_1_58
+guint                     g_struct_layout_set_values      (GIStructLayout   *layout,
+                                                           gpointer          mem,
+                                                           const GIArgument *values);
+
+GI_AVAILABLE_IN_1_58
+gsize                     g_struct_layout_get_packed_size (GIStructLayout   *layout);
+
+GI_AVAILABLE_IN_1_58
+void                      g_struct_layout_pack            (GIStructLayout   *layout,
+                                                           gconstpointer     mem,
+                                                           guint8           *buffer);
+
+GI_AVAILABLE_IN_1_58
+void                      g_struct_layout_unpack          (GIStructLayout   *layout,
+                                                           const guint8     *buffer,
+                                                           gpointer          mem);
+
+G_END_DECLS
+
+
+#endif  /* __GISTRUCTLAYOUT_H__ */
@@ -239,6 +239,9 @@ typedef enum {
  *   variable-size blobs.
  * @union_blob_size: See @entry_blob_size.
  * @sections: Offset of section blob array
+ * @checksum: The first bytes of the SHA-256 digest of the typelib, computed
+ *   with this field zeroed; see g_typelib_compute_checksum().  All zeros in
+ *   typelibs written without a checksum.
  * @padding: TODO
  *
  * The header structure appears exactly once at the beginning of a typelib.  It is a
@@ -285,7 +288,9 @@ typedef struct {
 
   guint32 sections;
 
-  guint16 padding[6];
+  guint8  checksum[8];
+
+  guint16 padding[2];
 } Header;
 
 /**
@@ -1199,6 +1204,8 @@ typedef struct {
   guint32 value;
 } AttributeBlob;
 
+typedef struct _GITypelibProfile GITypelibProfile;
+
 struct _GITypelib {
   /* <private> */
   guchar *data;
@@ -1207,6 +1214,13 @@ struct _GITypelib {
   GMappedFile *mfile;
   GList *modules;
   gboolean open_attempted;
+  GHashTable *field_offsets;
+  GHashTable *vfunc_locations;
+  GHashTable *enum_tables;
+  gboolean cache_infos;
+  GHashTable *infos;
+  GITypelibProfile *profile;
+  gboolean validated;
 };
 
 DirEntry *g_typelib_get_dir_entry (GITypelib *typelib,
@@ -1221,6 +1235,10 @@ DirEntry *g_typelib_get_dir_entry_by_gtype_name (GITypelib *typelib,
 DirEntry *g_typelib_get_dir_entry_by_error_domain (GITypelib *typelib,
 						   GQuark     error_domain);
 
+const guint32 *g_typelib_get_field_offsets (GITypelib *typelib,
+                                            guint32    offset,
+                                            guint16    n_fields);
+
 gboolean  g_typelib_matches_gtype_name_prefix (GITypelib *typelib,
 					       const gchar *gtype_name);
 
@@ -1273,6 +1291,33 @@ GI_AVAILABLE_IN_ALL
 gboolean g_typelib_validate (GITypelib  *typelib,
 			     GError    **error);
 
+/* defined in girepository.c */
+void _g_typelib_profile_blob      (GITypelib *typelib,
+				   guint32    offset);
+void _g_typelib_profile_dir_entry (GITypelib *typelib,
+				   guint16    index);
+
+GI_AVAILABLE_IN_1_58
+gboolean g_typelib_validate_parallel (GITypelib  *typelib,
+				      guint       n_threads,
+				      GError    **error);
+
+/**
+ * G_TYPELIB_DIGEST_LEN:
+ *
+ * The length of the digests computed by g_typelib_compute_checksum().
+ */
+#define G_TYPELIB_DIGEST_LEN 32
+
+GI_AVAILABLE_IN_1_58
+void     g_typelib_compute_checksum (const guint8 *data,
+				     gsize         len,
+				     guint8       *digest);
+
+GI_AVAILABLE_IN_1_58
+gboolean g_typelib_validate_cached (GITypelib  *typelib,
+				    GError    **error);
+
 
 /* defined in gibaseinfo.c */
 AttributeBlob *_attribute_blob_find_first (GIBaseInfo *info,
@@ -22,16 +22,25 @@
 
 #include "config.h"
 
+#include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 
 #include <glib.h>
+#include <glib/gstdio.h>
 
 #include "gitypelib-internal.h"
 
+/* Nesting is at most a few levels deep (e.g. a method of an object); deeper
+ * levels are still counted but left out of error messages, so that
+ * validating never allocates unless it fails.
+ */
+#define MAX_CONTEXT_DEPTH 8
+
 typedef struct {
   GITypelib *typelib;
-  GSList *context_stack;
+  const char *context_stack[MAX_CONTEXT_DEPTH];
+  guint context_depth;
 } ValidateContext;
 
 #define ALIGN_VALUE(this, boundary) \
@@ -40,15 +49,16 @@ typedef struct {
 static void
 push_context (ValidateContext *ctx, const char *name)
 {
-  ctx->context_stack = g_slist_prepend (ctx->context_stack, (char*)name);
+  if (ctx->context_depth < MAX_CONTEXT_DEPTH)
+    ctx->context_stack[ctx->context_depth] = name;
+  ctx->context_depth++;
 }
 
 static void
 pop_context (ValidateContext *ctx)
 {
-  g_assert (ctx->context_stack != NULL);
-  ctx->context_stack = g_slist_delete_link (ctx->context_stack,
-					    ctx->context_stack);
+  g_assert (ctx->context_depth > 0);
+  ctx->context_depth--;
 }
 
 static gboolean
@@ -149,6 +159,23 @@ g_typelib_get_dir_entry (GITypelib *typelib,
   return (DirEntry *)&typelib->data[header->directory + (index - 1) * header->entry_blob_size];
 }
 
+/* Records an entry found by one of the lookups below in the access
+ * profile; the entries passed over by their scans are left out.
+ */
+static DirEntry *
+profile_found_entry (GITypelib *typelib,
+		     DirEntry  *entry)
+{
+  Header *header = (Header *)typelib->data;
+
+  if (G_UNLIKELY (typelib->profile != NULL))
+    _g_typelib_profile_dir_entry (typelib,
+				  ((guint8 *) entry - &typelib->data[header->directory]) /
+				  header->entry_blob_size + 1);
+
+  return entry;
+}
+
 static Section *
 get_section_by_id (GITypelib   *typelib,
 		   SectionType  section_type)
@@ -197,7 +224,7 @@ g_typelib_get_dir_entry_by_name (GITypelib *typelib,
 	  entry = g_typelib_get_dir_entry (typelib, i);
 	  entry_name = g_typelib_get_string (typelib, entry->name);
 	  if (strcmp (name, entry_name) == 0)
-	    return entry;
+	    return profile_found_entry (typelib, entry);
 	}
       return NULL;
     }
@@ -210,7 +237,7 @@ g_typelib_get_dir_entry_by_name (GITypelib *typelib,
       entry = g_typelib_get_dir_entry (typelib, index + 1);
       entry_name = g_typelib_get_string (typelib, entry->name);
       if (strcmp (name, entry_name) == 0)
-	return entry;
+	return profile_found_entry (typelib, entry);
       return NULL;
     }
 }
@@ -245,7 +272,7 @@ g_typelib_get_dir_entry_by_gtype_name (GITypelib *typelib,
 
       type = g_typelib_get_string (typelib, blob->gtype_name);
       if (strcmp (type, gtype_name) == 0)
-	return entry;
+	return profile_found_entry (typelib, entry);
     }
   return NULL;
 }
@@ -397,11 +424,67 @@ g_typelib_get_dir_entry_by_error_domain (GITypelib *typelib,
 
       enum_domain_string = g_typelib_get_string (typelib, blob->error_domain);
       if (strcmp (domain_string, enum_domain_string) == 0)
-	return entry;
+	return profile_found_entry (typelib, entry);
     }
   return NULL;
 }
 
+G_LOCK_DEFINE_STATIC (field_offsets);
+
+/**
+ * g_typelib_get_field_offsets:
+ * @typelib: a #GITypelib
+ * @offset: offset of the first #FieldBlob of a struct or object
+ * @n_fields: the number of fields
+ *
+ * Fields with an embedded type are followed by its #CallbackBlob, so
+ * finding the #FieldBlob of a given field means walking all the fields
+ * before it.  This returns a table of the offsets of the @n_fields
+ * fields starting at @offset, followed by the offset just past the last
+ * one, so that callers can index fields in constant time.  The table is
+ * built on first use and kept until @typelib is freed.
+ *
+ * Returns: (transfer none): the table of @n_fields + 1 offsets
+ */
+const guint32 *
+g_typelib_get_field_offsets (GITypelib *typelib,
+                             guint32    offset,
+                             guint16    n_fields)
+{
+  Header *header = (Header *)typelib->data;
+  guint32 *offsets;
+  guint32 end;
+  guint i;
+
+  G_LOCK (field_offsets);
+
+  if (typelib->field_offsets == NULL)
+    typelib->field_offsets = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+
+  offsets = g_hash_table_lookup (typelib->field_offsets, GUINT_TO_POINTER (offset));
+  if (offsets == NULL)
+    {
+      offsets = g_new (guint32, n_fields + 1);
+      end = offset;
+      for (i = 0; i < n_fields; i++)
+        {
+          FieldBlob *field_blob = (FieldBlob *)&typelib->data[end];
+
+          offsets[i] = end;
+          end += header->field_blob_size;
+          if (field_blob->has_embedded_type)
+            end += header->callback_blob_size;
+        }
+      offsets[n_fields] = end;
+      g_hash_table_insert (typelib->field_offsets,
+                           GUINT_TO_POINTER (offset), offsets);
+    }
+
+  G_UNLOCK (field_offsets);
+
+  return offsets;
+}
+
 /**
  * g_typelib_check_sanity:
  *
@@ -2039,24 +2122,17 @@ validate_blob (ValidateContext *ctx,
 }
 
 static gboolean
-validate_directory (ValidateContext   *ctx,
-		    GError            **error)
+validate_directory_entries (ValidateContext  *ctx,
+			    guint             start,
+			    guint             end,
+			    GError          **error)
 {
   GITypelib *typelib = ctx->typelib;
   Header *header = (Header *)typelib->data;
   DirEntry *entry;
-  gint i;
-
-  if (typelib->len < header->directory + header->n_entries * sizeof (DirEntry))
-    {
-      g_set_error (error,
-		   G_TYPELIB_ERROR,
-		   G_TYPELIB_ERROR_INVALID,
-		   "The buffer is too short");
-      return FALSE;
-    }
+  guint i;
 
-  for (i = 0; i < header->n_entries; i++)
+  for (i = start; i < end; i++)
     {
       entry = g_typelib_get_dir_entry (typelib, i + 1);
 
@@ -2115,6 +2191,95 @@ validate_directory (ValidateContext   *ctx,
   return TRUE;
 }
 
+/* Entries are validated independently of each other, so the directory
+ * can be split into shards validated on their own threads, each with
+ * its own context.  Errors are reported for the first failing shard, so
+ * they don't depend on the number of threads.
+ */
+typedef struct {
+  ValidateContext ctx;
+  guint start;
+  guint end;
+  gboolean valid;
+  GError *error;
+} ValidateShard;
+
+/* Not worth a thread for fewer entries */
+#define MIN_ENTRIES_PER_SHARD 64
+
+static gpointer
+validate_shard_thread (gpointer data)
+{
+  ValidateShard *shard = data;
+
+  shard->valid = validate_directory_entries (&shard->ctx, shard->start,
+					     shard->end, &shard->error);
+
+  return NULL;
+}
+
+static gboolean
+validate_directory (ValidateContext   *ctx,
+		    guint              n_shards,
+		    GError            **error)
+{
+  GITypelib *typelib = ctx->typelib;
+  Header *header = (Header *)typelib->data;
+  ValidateShard *shards;
+  GThread **threads;
+  gboolean valid = TRUE;
+  guint i;
+
+  if (typelib->len < header->directory + header->n_entries * sizeof (DirEntry))
+    {
+      g_set_error (error,
+		   G_TYPELIB_ERROR,
+		   G_TYPELIB_ERROR_INVALID,
+		   "The buffer is too short");
+      return FALSE;
+    }
+
+  n_shards = MIN (n_shards, header->n_entries / MIN_ENTRIES_PER_SHARD);
+  if (n_shards <= 1)
+    return validate_directory_entries (ctx, 0, header->n_entries, error);
+
+  shards = g_new0 (ValidateShard, n_shards);
+  threads = g_new0 (GThread *, n_shards);
+
+  for (i = 0; i < n_shards; i++)
+    {
+      shards[i].ctx.typelib = typelib;
+      shards[i].start = (guint) ((guint64) header->n_entries * i / n_shards);
+      shards[i].end = (guint) ((guint64) header->n_entries * (i + 1) / n_shards);
+
+      /* The first shard is validated on the calling thread */
+      if (i > 0)
+        threads[i] = g_thread_new ("gi-validate", validate_shard_thread, &shards[i]);
+    }
+
+  validate_shard_thread (&shards[0]);
+
+  for (i = 0; i < n_shards; i++)
+    {
+      if (threads[i] != NULL)
+        g_thread_join (threads[i]);
+
+      if (valid && !shards[i].valid)
+        {
+          valid = FALSE;
+          *ctx = shards[i].ctx;
+          g_propagate_error (error, shards[i].error);
+        }
+      else
+        g_clear_error (&shards[i].error);
+    }
+
+  g_free (threads);
+  g_free (shards);
+
+  return valid;
+}
+
 static gboolean
 validate_attributes (ValidateContext *ctx,
 		     GError       **error)
@@ -2139,21 +2304,21 @@ prefix_with_context (GError **error,
 		     const char *section,
 		     ValidateContext *ctx)
 {
-  GString *str = g_string_new (NULL);
-  GSList *link;
+  GString *str;
   char *buf;
+  guint i;
 
-  link = ctx->context_stack;
-  if (!link)
+  if (ctx->context_depth == 0)
     {
       g_prefix_error (error, "In %s:", section);
       return;
     }
 
-  for (; link; link = link->next)
+  str = g_string_new (NULL);
+  for (i = MIN (ctx->context_depth, MAX_CONTEXT_DEPTH); i > 0; i--)
     {
-      g_string_append (str, link->data);
-      if (link->next)
+      g_string_append (str, ctx->context_stack[i - 1]);
+      if (i > 1)
 	g_string_append_c (str, '/');
     }
   g_string_append_c (str, ')');
@@ -2162,6 +2327,36 @@ prefix_with_context (GError **error,
   g_free (buf);
 }
 
+static gboolean
+validate_typelib (GITypelib  *typelib,
+		  guint       n_threads,
+		  GError    **error)
+{
+  ValidateContext ctx;
+  ctx.typelib = typelib;
+  ctx.context_depth = 0;
+
+  if (!validate_header (&ctx, error))
+    {
+      prefix_with_context (error, "In header", &ctx);
+      return FALSE;
+    }
+
+  if (!validate_directory (&ctx, n_threads, error))
+    {
+      prefix_with_context (error, "directory", &ctx);
+      return FALSE;
+    }
+
+  if (!validate_attributes (&ctx, error))
+    {
+      prefix_with_context (error, "attributes", &ctx);
+      return FALSE;
+    }
+
+  return TRUE;
+}
+
 /**
  * g_typelib_validate:
  * @typelib: TODO
@@ -2175,28 +2370,211 @@ gboolean
 g_typelib_validate (GITypelib     *typelib,
 		     GError       **error)
 {
-  ValidateContext ctx;
-  ctx.typelib = typelib;
-  ctx.context_stack = NULL;
+  return validate_typelib (typelib, 1, error);
+}
 
-  if (!validate_header (&ctx, error))
+/**
+ * g_typelib_validate_parallel:
+ * @typelib: a #GITypelib
+ * @n_threads: the maximum number of threads to use, or 0 for one per
+ *   processor
+ * @error: a #GError
+ *
+ * Like g_typelib_validate(), but the entries of the directory are split
+ * across up to @n_threads threads, including the calling one.  Small
+ * typelibs are validated on the calling thread only.  The error
+ * reported for an invalid typelib is the same as with
+ * g_typelib_validate().
+ *
+ * Returns: %TRUE if @typelib is valid
+ *
+ * Since: 1.58
+ */
+gboolean
+g_typelib_validate_parallel (GITypelib  *typelib,
+			     guint       n_threads,
+			     GError    **error)
+{
+  if (n_threads == 0)
+    n_threads = g_get_num_processors ();
+
+  return validate_typelib (typelib, n_threads, error);
+}
+
+/**
+ * g_typelib_compute_checksum:
+ * @data: the contents of a typelib
+ * @len: the length of @data, at least sizeof (Header)
+ * @digest: (out caller-allocates): return location for
+ *   %G_TYPELIB_DIGEST_LEN bytes
+ *
+ * Computes the SHA-256 digest of a typelib, leaving out the checksum
+ * stored in its header.  The compiler stores the first bytes of the
+ * digest in the header.
+ *
+ * Since: 1.58
+ */
+void
+g_typelib_compute_checksum (const guint8 *data,
+			    gsize         len,
+			    guint8       *digest)
+{
+  GChecksum *checksum;
+  gsize start = G_STRUCT_OFFSET (Header, checksum);
+  gsize end = start + sizeof (((Header *) NULL)->checksum);
+  gsize digest_len = G_TYPELIB_DIGEST_LEN;
+
+  g_return_if_fail (len >= sizeof (Header));
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, data, start);
+  g_checksum_update (checksum, data + end, len - end);
+  g_checksum_get_digest (checksum, digest, &digest_len);
+  g_checksum_free (checksum);
+}
+
+/* Persistent set of the digests of typelibs which passed
+ * g_typelib_validate(), one hexadecimal digest per line.
+ */
+#define MAX_VALIDATED_TYPELIBS 1024
+
+G_LOCK_DEFINE_STATIC (validation_cache);
+static GHashTable *validation_cache = NULL;
+/* Resolved once, so the cache is read from and written to the same file */
+static gchar *validation_cache_path = NULL;
+
+static gchar *
+get_validation_cache_path (void)
+{
+  const gchar *path = g_getenv ("GI_TYPELIB_VALIDATION_CACHE");
+
+  if (path != NULL)
+    return g_strdup (path);
+
+  return g_build_filename (g_get_user_cache_dir (), "gobject-introspection",
+			   "validated-typelibs", NULL);
+}
+
+static void
+load_validation_cache (void)
+{
+  gchar *contents;
+  gchar **lines;
+  gint i;
+
+  validation_cache = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  validation_cache_path = get_validation_cache_path ();
+
+  if (g_file_get_contents (validation_cache_path, &contents, NULL, NULL))
     {
-      prefix_with_context (error, "In header", &ctx);
-      return FALSE;
+      lines = g_strsplit (contents, "\n", -1);
+      for (i = 0; lines[i] != NULL; i++)
+	{
+	  if (strlen (lines[i]) == G_TYPELIB_DIGEST_LEN * 2)
+	    g_hash_table_add (validation_cache, g_strdup (lines[i]));
+	}
+      g_strfreev (lines);
+      g_free (contents);
     }
+}
+
+static void
+record_validated (const gchar *digest)
+{
+  gchar *dirname;
+  gboolean start_over;
+  FILE *file;
+
+  dirname = g_path_get_dirname (validation_cache_path);
+
+  /* Start over rather than letting the cache grow with every update */
+  start_over = g_hash_table_size (validation_cache) >= MAX_VALIDATED_TYPELIBS;
+  if (start_over)
+    g_hash_table_remove_all (validation_cache);
+  g_hash_table_add (validation_cache, g_strdup (digest));
+
+  file = NULL;
+  if (g_mkdir_with_parents (dirname, 0700) == 0)
+    file = g_fopen (validation_cache_path, start_over ? "w" : "a");
 
-  if (!validate_directory (&ctx, error))
+  /* Failing to write only means validating again next time */
+  if (file != NULL)
     {
-      prefix_with_context (error, "directory", &ctx);
-      return FALSE;
+      fprintf (file, "%s\n", digest);
+      fclose (file);
     }
 
-  if (!validate_attributes (&ctx, error))
+  g_free (dirname);
+}
+
+/**
+ * g_typelib_validate_cached:
+ * @typelib: a #GITypelib
+ * @error: a #GError
+ *
+ * Like g_typelib_validate(), but only the first time a given typelib is
+ * seen: the digest of typelibs which pass validation is recorded in a
+ * persistent cache, in the file named by the GI_TYPELIB_VALIDATION_CACHE
+ * environment variable or in the user cache directory, and later calls
+ * for the same contents only compute the digest.  The variable is only
+ * read the first time the cache is used.  If the header of
+ * @typelib has a checksum, it must match the contents.
+ *
+ * Returns: %TRUE if @typelib is valid
+ *
+ * Since: 1.58
+ */
+gboolean
+g_typelib_validate_cached (GITypelib  *typelib,
+			   GError    **error)
+{
+  Header *header = (Header *)typelib->data;
+  guint8 digest[G_TYPELIB_DIGEST_LEN];
+  gchar hex[G_TYPELIB_DIGEST_LEN * 2 + 1];
+  gboolean has_checksum = FALSE;
+  gboolean validated;
+  guint i;
+
+  /* The contents of a typelib never change */
+  if (typelib->validated)
+    return TRUE;
+
+  g_typelib_compute_checksum (typelib->data, typelib->len, digest);
+
+  for (i = 0; i < sizeof (header->checksum); i++)
+    has_checksum |= header->checksum[i] != 0;
+
+  if (has_checksum &&
+      memcmp (header->checksum, digest, sizeof (header->checksum)) != 0)
     {
-      prefix_with_context (error, "attributes", &ctx);
+      g_set_error (error,
+		   G_TYPELIB_ERROR,
+		   G_TYPELIB_ERROR_INVALID_HEADER,
+		   "Typelib checksum mismatch");
       return FALSE;
     }
 
+  for (i = 0; i < G_TYPELIB_DIGEST_LEN; i++)
+    g_snprintf (hex + 2 * i, 3, "%02x", digest[i]);
+
+  G_LOCK (validation_cache);
+  if (validation_cache == NULL)
+    load_validation_cache ();
+  validated = g_hash_table_contains (validation_cache, hex);
+  G_UNLOCK (validation_cache);
+
+  if (!validated)
+    {
+      if (!g_typelib_validate (typelib, error))
+	return FALSE;
+
+      G_LOCK (validation_cache);
+      record_validated (hex);
+      G_UNLOCK (validation_cache);
+    }
+
+  typelib->validated = TRUE;
+
   return TRUE;
 }
 
@@ -2458,6 +2836,14 @@ g_typelib_free (GITypelib *typelib)
       g_list_foreach (typelib->modules, (GFunc) (void *) g_module_close, NULL);
       g_list_free (typelib->modules);
     }
+  if (typelib->field_offsets)
+    g_hash_table_destroy (typelib->field_offsets);
+  if (typelib->vfunc_locations)
+    g_hash_table_destroy (typelib->vfunc_locations);
+  if (typelib->enum_tables)
+    g_hash_table_destroy (typelib->enum_tables);
+  if (typelib->infos)
+    g_hash_table_destroy (typelib->infos);
   g_slice_free (GITypelib, typelib);
 }
 
@@ -2475,6 +2861,31 @@ g_typelib_get_namespace (GITypelib *typelib)
   return g_typelib_get_string (typelib, ((Header *) typelib->data)->namespace);
 }
 
+/**
+ * g_typelib_enable_info_cache:
+ * @typelib: the typelib
+ *
+ * Makes the infos for @typelib shared: looking up the same blob in the
+ * same container, for instance calling g_object_info_get_method() twice
+ * with the same index, returns a new reference to the same #GIBaseInfo
+ * instead of allocating a new one.
+ *
+ * The shared infos are owned by @typelib and kept until it is freed, so
+ * memory usage is bounded by the number of distinct blobs looked up.
+ * This is meant for long-lived bindings which reflect over the same
+ * types over and over; the infos must not be used after @typelib has
+ * been freed.  There is no way to disable the cache again.
+ *
+ * Since: 1.58
+ */
+void
+g_typelib_enable_info_cache (GITypelib *typelib)
+{
+  g_return_if_fail (typelib != NULL);
+
+  typelib->cache_infos = TRUE;
+}
+
 /**
  * g_typelib_symbol:
  * @typelib: the typelib
@@ -73,6 +73,9 @@ gboolean      g_typelib_symbol                (GITypelib     *typelib,
 GI_AVAILABLE_IN_ALL
 const gchar * g_typelib_get_namespace         (GITypelib     *typelib);
 
+GI_AVAILABLE_IN_1_58
+void          g_typelib_enable_info_cache     (GITypelib     *typelib);
+
 
 G_END_DECLS
 
@@ -202,43 +202,36 @@ g_vfunc_info_get_invoker (GIVFuncInfo *info)
     g_assert_not_reached ();
 }
 
-/**
- * g_vfunc_info_get_address:
- * @info: a #GIVFuncInfo
- * @implementor_gtype: #GType implementing this virtual function
- * @error: return location for a #GError
- *
- * This method will look up where inside the type struct of @implementor_gtype
- * is the implementation for @info.
- *
- * Returns: address to a function or %NULL if an error happened
+/* Where the implementation of a vfunc is found in the class or
+ * interface structure of its implementors.
  */
-gpointer
-g_vfunc_info_get_address (GIVFuncInfo      *vfunc_info,
-                          GType             implementor_gtype,
-                          GError          **error)
+typedef struct {
+  gint  offset;
+  GType interface_type; /* G_TYPE_INVALID for object vfuncs */
+} VFuncLocation;
+
+G_LOCK_DEFINE_STATIC (vfunc_locations);
+
+static VFuncLocation *
+find_vfunc_location (GIVFuncInfo *vfunc_info)
 {
   GIBaseInfo *container_info;
-  GIInterfaceInfo *interface_info;
-  GIObjectInfo *object_info;
   GIStructInfo *struct_info;
   GIFieldInfo *field_info = NULL;
-  int length, i, offset;
-  gpointer implementor_class, implementor_vtable;
-  gpointer func = NULL;
+  VFuncLocation *location;
+  GType interface_type;
+  int length, i;
 
   container_info = g_base_info_get_container (vfunc_info);
   if (g_base_info_get_type (container_info) == GI_INFO_TYPE_OBJECT)
     {
-      object_info = (GIObjectInfo*) container_info;
-      interface_info = NULL;
-      struct_info = g_object_info_get_class_struct (object_info);
+      struct_info = g_object_info_get_class_struct ((GIObjectInfo*) container_info);
+      interface_type = G_TYPE_INVALID;
     }
   else
     {
-      interface_info = (GIInterfaceInfo*) container_info;
-      object_info = NULL;
-      struct_info = g_interface_info_get_iface_struct (interface_info);
+      struct_info = g_interface_info_get_iface_struct ((GIInterfaceInfo*) container_info);
+      interface_type = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo*) container_info);
     }
 
   length = g_struct_info_get_n_fields (struct_info);
@@ -256,33 +249,117 @@ g_vfunc_info_get_address (GIVFuncInfo      *vfunc_info,
       break;
     }
 
+  g_base_info_unref ((GIBaseInfo*) struct_info);
+
   if (field_info == NULL)
+    return NULL;
+
+  location = g_new (VFuncLocation, 1);
+  location->offset = g_field_info_get_offset (field_info);
+  location->interface_type = interface_type;
+  g_base_info_unref (field_info);
+
+  return location;
+}
+
+/*
+ * get_vfunc_location:
+ *
+ * Looks up the class structure field of @vfunc_info once per typelib,
+ * rather than on every g_vfunc_info_get_address() call.  Only the
+ * offset is kept: the function pointer itself is always read from the
+ * live class structure, so nothing needs invalidating when a dynamic
+ * type is unloaded and its class initialized again.
+ */
+static const VFuncLocation *
+get_vfunc_location (GIVFuncInfo *vfunc_info)
+{
+  GIRealInfo *rinfo = (GIRealInfo *)vfunc_info;
+  GITypelib *typelib = rinfo->typelib;
+  VFuncLocation *location, *existing;
+
+  G_LOCK (vfunc_locations);
+  if (typelib->vfunc_locations == NULL)
+    typelib->vfunc_locations = g_hash_table_new_full (NULL, NULL, NULL, g_free);
+  location = g_hash_table_lookup (typelib->vfunc_locations,
+                                  GUINT_TO_POINTER (rinfo->offset));
+  G_UNLOCK (vfunc_locations);
+
+  if (location != NULL)
+    return location;
+
+  /* Not done with the lock held, since this may end up calling
+   * get_type() functions */
+  location = find_vfunc_location (vfunc_info);
+  if (location == NULL)
+    return NULL;
+
+  G_LOCK (vfunc_locations);
+  existing = g_hash_table_lookup (typelib->vfunc_locations,
+                                  GUINT_TO_POINTER (rinfo->offset));
+  if (existing != NULL)
+    {
+      g_free (location);
+      location = existing;
+    }
+  else
+    g_hash_table_insert (typelib->vfunc_locations,
+                         GUINT_TO_POINTER (rinfo->offset), location);
+  G_UNLOCK (vfunc_locations);
+
+  return location;
+}
+
+/**
+ * g_vfunc_info_get_address:
+ * @info: a #GIVFuncInfo
+ * @implementor_gtype: #GType implementing this virtual function
+ * @error: return location for a #GError
+ *
+ * This method will look up where inside the type struct of @implementor_gtype
+ * is the implementation for @info.
+ *
+ * Returns: address to a function or %NULL if an error happened
+ */
+gpointer
+g_vfunc_info_get_address (GIVFuncInfo      *vfunc_info,
+                          GType             implementor_gtype,
+                          GError          **error)
+{
+  const VFuncLocation *location;
+  gpointer implementor_class, implementor_vtable;
+  gboolean class_ref = FALSE;
+  gpointer func = NULL;
+
+  location = get_vfunc_location (vfunc_info);
+  if (location == NULL)
     {
       g_set_error (error,
                    G_INVOKE_ERROR,
                    G_INVOKE_ERROR_SYMBOL_NOT_FOUND,
                    "Couldn't find struct field for this vfunc");
-      goto out;
+      return NULL;
     }
 
-  implementor_class = g_type_class_ref (implementor_gtype);
-
-  if (object_info)
+  /* Only take a reference if the class isn't initialized yet */
+  implementor_class = g_type_class_peek (implementor_gtype);
+  if (implementor_class == NULL)
     {
-      implementor_vtable = implementor_class;
+      implementor_class = g_type_class_ref (implementor_gtype);
+      class_ref = TRUE;
     }
+
+  if (location->interface_type == G_TYPE_INVALID)
+    implementor_vtable = implementor_class;
   else
-    {
-      GType interface_type;
+    implementor_vtable = g_type_interface_peek (implementor_class,
+                                                location->interface_type);
 
-      interface_type = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo*) interface_info);
-      implementor_vtable = g_type_interface_peek (implementor_class, interface_type);
-    }
+  if (implementor_vtable != NULL)
+    func = *(gpointer*) G_STRUCT_MEMBER_P (implementor_vtable, location->offset);
 
-  offset = g_field_info_get_offset (field_info);
-  func = *(gpointer*) G_STRUCT_MEMBER_P (implementor_vtable, offset);
-  g_type_class_unref (implementor_class);
-  g_base_info_unref (field_info);
+  if (class_ref)
+    g_type_class_unref (implementor_class);
 
   if (func == NULL)
     {
@@ -292,12 +369,8 @@ g_vfunc_info_get_address (GIVFuncInfo      *vfunc_info,
                    "Class %s doesn't implement %s",
                    g_type_name (implementor_gtype),
                    g_base_info_get_name ( (GIBaseInfo*) vfunc_info));
-      goto out;
     }
 
- out:
-  g_base_info_unref ((GIBaseInfo*) struct_info);
-
   return func;
 }
 
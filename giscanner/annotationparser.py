@@ -114,12 +114,27 @@ from __future__ import unicode_literals
 
 import os
 import re
+import sys
 import operator
 
 from operator import ne, gt, lt
 from collections import namedtuple, Counter, OrderedDict
 
-from .message import Position, warn, error
+from .libtoolimporter import LibtoolImporter
+from . import utils
+from .message import MessageLogger, MessageRecorder, Position, warn, error
+
+# The C tokenizer only deals with str lines, which means Python 3
+_tokenize_comment_lines = None
+if sys.version_info.major >= 3:
+    try:
+        with LibtoolImporter(None, None):
+            if 'UNINSTALLED_INTROSPECTION_SRCDIR' in os.environ:
+                from _giscanner import tokenize_comment_lines as _tokenize_comment_lines
+            else:
+                from giscanner._giscanner import tokenize_comment_lines as _tokenize_comment_lines
+    except ImportError:
+        pass
 
 
 # GTK-Doc comment block parts
@@ -508,6 +523,57 @@ TAG_VALUE_STABILITY_RE = re.compile(
     ''',
     re.UNICODE | re.VERBOSE | re.IGNORECASE)
 
+# Kinds of comment block lines, as classified by _tokenize_comment_line()
+LINE_TEXT = 0
+LINE_EMPTY = 1
+LINE_PARAMETER = 2
+LINE_TAG = 3
+
+
+def _tokenize_comment_line(line):
+    '''
+    Classify a single line of a GTK-Doc comment block using the regular expressions
+    above. This is what the tokenize_comment_lines() function of the _giscanner
+    module does for all the lines of a comment block at once, which is used instead
+    when available; it returns None for lines it leaves to this function.
+
+    :param line: a comment block line without its line break
+    :returns: a tuple ``(indent, asterisk, line_indent, kind, spans)`` where `indent` is
+              the length of the indentation before the ``' * '``, `asterisk` is
+              ``(comment_start, comment_end, end)`` of the :const:`COMMENT_ASTERISK_RE`
+              match or :const:`None`, `line_indent` is the indentation after the
+              ``' * '``, `kind` is one of the ``LINE_*`` constants, and `spans` is
+              ``(name_start, name_end, fields_start, fields_end)`` for parameters and
+              tags, relative to the line with the ``' * '`` removed
+    '''
+
+    indent = len(INDENTATION_RE.match(line).group('indentation'))
+
+    asterisk = None
+    result = COMMENT_ASTERISK_RE.match(line)
+    if result:
+        asterisk = (result.start('comment'), result.end('comment'), result.end(0))
+        line = line[result.end(0):]
+
+    line_indent = len(INDENTATION_RE.match(line).group('indentation').replace('\t', '  '))
+
+    result = PARAMETER_RE.match(line)
+    if result:
+        return (indent, asterisk, line_indent, LINE_PARAMETER,
+                (result.start('parameter_name'), result.end('parameter_name'),
+                 result.start('fields'), result.end('fields')))
+
+    if EMPTY_LINE_RE.match(line):
+        return (indent, asterisk, line_indent, LINE_EMPTY, None)
+
+    result = TAG_RE.match(line)
+    if result:
+        return (indent, asterisk, line_indent, LINE_TAG,
+                (result.start('tag_name'), result.end('tag_name'),
+                 result.start('fields'), result.end('fields')))
+
+    return (indent, asterisk, line_indent, LINE_TEXT, None)
+
 
 class GtkDocAnnotations(OrderedDict):
     '''
@@ -1166,26 +1232,24 @@ class GtkDocCommentBlockParser(object):
            http://git.gnome.org/browse/gtk-doc/tree/gtkdoc-mkdb.in#n3722
     '''
 
-    def parse_comment_blocks(self, comments):
+    def parse_comment_blocks(self, comments, jobs=1):
         '''
         Parse multiple GTK-Doc comment blocks.
 
         :param comments: an iterable of ``(comment, filename, lineno)`` tuples
+        :param jobs: number of worker processes to parse the comment blocks in, 0 for one
+                     per CPU; the result and messages do not depend on it
         :returns: a dictionary mapping identifier names to :class:`GtkDocCommentBlock` objects
         '''
 
         comment_blocks = {}
 
-        for (comment, filename, lineno) in comments:
-            try:
-                comment_block = self.parse_comment_block(comment, filename, lineno)
-            except Exception as e:
-                error('unrecoverable parse error, please file a GObject-Introspection bug'
-                      'report including the complete comment block at the indicated location. %s' %
-                      str(e),
-                      Position(filename, lineno))
-                continue
+        if jobs == 1:
+            parsed = (self._parse_comment_block_safe(*comment) for comment in comments)
+        else:
+            parsed = self._parse_comment_blocks_parallel(comments, jobs)
 
+        for comment_block in parsed:
             if comment_block is not None:
                 # Note: previous versions of this parser did not check if an identifier was
                 #       already stored in comment_blocks, so when different comment blocks where
@@ -1203,6 +1267,26 @@ class GtkDocCommentBlockParser(object):
 
         return comment_blocks
 
+    def _parse_comment_block_safe(self, comment, filename, lineno):
+        try:
+            return self.parse_comment_block(comment, filename, lineno)
+        except Exception as e:
+            error('unrecoverable parse error, please file a GObject-Introspection bug'
+                  'report including the complete comment block at the indicated location. %s' %
+                  str(e),
+                  Position(filename, lineno))
+            return None
+
+    def _parse_comment_blocks_parallel(self, comments, jobs):
+        # Comment blocks don't depend on each other, so they are parsed in worker
+        # processes which record their messages. Replaying those in the order of
+        # the comment blocks keeps the output identical to parsing them here.
+        logger = MessageLogger.get()
+        for comment_block, recorder in utils.parallel_map(_parse_comment_block_recorded,
+                                                          comments, jobs):
+            recorder.replay(logger)
+            yield comment_block
+
     def parse_comment_block(self, comment, filename, lineno):
         '''
         Parse a single GTK-Doc comment block.
@@ -1286,7 +1370,12 @@ class GtkDocCommentBlockParser(object):
         current_part = None
         returns_seen = False
 
-        for line in comment_lines:
+        if _tokenize_comment_lines is not None:
+            tokens = _tokenize_comment_lines(comment_lines, ALL_TAGS)
+        else:
+            tokens = [None] * len(comment_lines)
+
+        for line, token in zip(comment_lines, tokens):
             lineno += 1
             position = Position(filename, lineno)
 
@@ -1295,24 +1384,21 @@ class GtkDocCommentBlockParser(object):
             original_line = line
             column_offset = 0
 
+            if token is None:
+                token = _tokenize_comment_line(line)
+            indent, asterisk, line_indent, line_kind, spans = token
+
             # Store indentation level of the comment (before the ' * ')
-            result = INDENTATION_RE.match(line)
-            block_indent.append(result.group('indentation'))
+            block_indent.append(line[:indent])
 
             # Get rid of the ' * ' at the start of the line.
-            result = COMMENT_ASTERISK_RE.match(line)
-            if result:
-                comment = result.group('comment')
-                if comment:
+            if asterisk is not None:
+                comment_start, comment_end, column_offset = asterisk
+                if comment_end > comment_start:
                     error('invalid comment text:',
-                          position, None, result.start('comment'), original_line)
-
-                column_offset = result.end(0)
-                line = line[result.end(0):]
+                          position, None, comment_start, original_line)
 
-            # Store indentation level of the line (after the ' * ').
-            result = INDENTATION_RE.match(line)
-            line_indent = len(result.group('indentation').replace('\t', '  '))
+                line = line[column_offset:]
 
             ####################################################################
             # Check for GTK-Doc comment block identifier.
@@ -1392,14 +1478,13 @@ class GtkDocCommentBlockParser(object):
             ####################################################################
             # Check for comment block parameters.
             ####################################################################
-            result = PARAMETER_RE.match(line)
-            if result:
+            if line_kind == LINE_PARAMETER:
                 part_indent = line_indent
-                param_name = result.group('parameter_name')
+                name_start, name_end, param_fields_start, fields_end = spans
+                param_name = line[name_start:name_end]
                 param_name_lower = param_name.lower()
-                param_fields = result.group('fields')
-                param_fields_start = result.start('fields')
-                marker_pos = result.start('parameter_name') + column_offset
+                param_fields = line[param_fields_start:fields_end]
+                marker_pos = name_start + column_offset
 
                 if in_part not in [PART_IDENTIFIER, PART_PARAMETERS]:
                     warn('"@%s" parameter unexpected at this location:' % (param_name, ),
@@ -1470,7 +1555,7 @@ class GtkDocCommentBlockParser(object):
             #       at this location as those might be handy describing
             #       parameters from time to time...
             ####################################################################
-            if (EMPTY_LINE_RE.match(line) and in_part in [PART_IDENTIFIER, PART_PARAMETERS]):
+            if (line_kind == LINE_EMPTY and in_part in [PART_IDENTIFIER, PART_PARAMETERS]):
                 in_part = PART_DESCRIPTION
                 part_indent = line_indent
                 continue
@@ -1478,14 +1563,13 @@ class GtkDocCommentBlockParser(object):
             ####################################################################
             # Check for GTK-Doc comment block tags.
             ####################################################################
-            result = TAG_RE.match(line)
-            if result and line_indent <= part_indent:
+            if line_kind == LINE_TAG and line_indent <= part_indent:
                 part_indent = line_indent
-                tag_name = result.group('tag_name')
+                name_start, name_end, tag_fields_start, fields_end = spans
+                tag_name = line[name_start:name_end]
                 tag_name_lower = tag_name.lower()
-                tag_fields = result.group('fields')
-                tag_fields_start = result.start('fields')
-                marker_pos = result.start('tag_name') + column_offset
+                tag_fields = line[tag_fields_start:fields_end]
+                marker_pos = name_start + column_offset
 
                 if tag_name_lower in DEPRECATED_GI_ANN_TAGS:
                     # Deprecated GObject-Introspection specific tags.
@@ -1502,7 +1586,7 @@ class GtkDocCommentBlockParser(object):
                     if tag_name_lower == TAG_ATTRIBUTES:
                         transformed = ''
                         result = self._parse_fields(position,
-                                                    result.start('tag_name') + column_offset,
+                                                    name_start + column_offset,
                                                     line,
                                                     tag_fields.strip(),
                                                     None,
@@ -1632,7 +1716,7 @@ class GtkDocCommentBlockParser(object):
             # If we get here, we must be in the middle of a multiline
             # comment block, parameter or tag description.
             ####################################################################
-            if EMPTY_LINE_RE.match(line) is None:
+            if line_kind != LINE_EMPTY:
                 line = line.rstrip()
 
             if in_part in [PART_IDENTIFIER, PART_DESCRIPTION]:
@@ -1993,6 +2077,21 @@ class GtkDocCommentBlockParser(object):
                                   description_field)
 
 
+def _parse_comment_block_recorded(comment):
+    # Called by utils.parallel_map(), usually in a worker process
+    logger = MessageLogger._instance
+    recorder = MessageRecorder()
+    MessageLogger._instance = recorder
+    try:
+        comment_block = GtkDocCommentBlockParser()._parse_comment_block_safe(*comment)
+    except SystemExit:
+        # Fatal messages exit the scanner when they are replayed
+        comment_block = None
+    finally:
+        MessageLogger._instance = logger
+    return comment_block, recorder
+
+
 class GtkDocCommentBlockWriter(object):
     '''
     Serialized :class:`GtkDocCommentBlock` objects into GTK-Doc comment blocks.
@@ -503,12 +503,17 @@ functions via get_by_symbol()."""
     def get_by_ctype(self, ctype):
         return self.ctypes.get(ctype)
 
+    def get_by_gtype_name(self, gtype_name):
+        return self.type_names.get(gtype_name)
+
     def get_by_symbol(self, symbol):
         return self.symbols.get(symbol)
 
     def walk(self, callback):
+        # The chain is always empty again once a toplevel node is done
+        chain = []
         for node in self.values():
-            node.walk(callback, [])
+            node.walk(callback, chain)
 
 
 class Include(object):
@@ -24,11 +24,11 @@ from __future__ import print_function
 from __future__ import unicode_literals
 
 import errno
-import glob
 import hashlib
+import mmap
 import os
 import shutil
-import sys
+import struct
 import tempfile
 
 try:
@@ -36,22 +36,230 @@ try:
 except ImportError:
     import pickle
 
-import giscanner
+from collections import OrderedDict
+from xml.etree.ElementTree import parse, fromstring, tostring
 
+from . import ast
 from . import utils
+from .girparser import GIRParser
 
 
 _CACHE_VERSION_FILENAME = '.cache-version'
 
+# Bump whenever the layout of the index files changes. Since the nodes
+# themselves are stored as GIR fragments and parsed on demand, changes to
+# the parser do not require invalidating the cache.
+_CACHE_FORMAT_VERSION = 3
+
+# An index file consists of this header, followed by the pickled index
+# and the GIR fragments of the toplevel nodes, each of which is parsed
+# only when the node is first looked up.  The header holds the size,
+# the modification time in nanoseconds and the SHA-256 digest of the GIR
+# file the index was built from.
+_INDEX_MAGIC = b'GIRINDEX'
+_INDEX_HEADER = struct.Struct('<8sIIQq32s')
+_INDEX_STAT = struct.Struct('<Qq')
+_INDEX_STAT_OFFSET = 16
+
 
 def _get_versionhash():
-    toplevel = os.path.dirname(giscanner.__file__)
-    sources = glob.glob(os.path.join(toplevel, '*.py'))
-    sources.append(sys.argv[0])
-    # Using mtimes is a bit (5x) faster than hashing the file contents
-    mtimes = (str(os.stat(source).st_mtime) for source in sources)
-    # ASCII encoding is sufficient since we are only dealing with numbers.
-    return hashlib.sha1(''.join(mtimes).encode('ascii')).hexdigest()
+    return str(_CACHE_FORMAT_VERSION)
+
+
+def _get_stat(filename):
+    st = os.stat(filename)
+    mtime = getattr(st, 'st_mtime_ns', None)
+    if mtime is None:
+        # Python 2
+        mtime = int(st.st_mtime * 1000000000)
+    return st.st_size, mtime
+
+
+class LazyNamespace(ast.Namespace):
+    """A Namespace backed by an index file.  Toplevel nodes are only
+materialized when they are looked up by name, C type, GType name or
+symbol; iterating the namespace materializes all of them."""
+
+    def __init__(self, filename, data, index):
+        ast.Namespace.__init__(self, index['name'], index['version'],
+                               identifier_prefixes=index['identifier_prefixes'],
+                               symbol_prefixes=index['symbol_prefixes'])
+        self.shared_libraries = index['shared_libraries']
+        self.includes = set(ast.Include(name, version)
+                            for name, version in index['includes'])
+        self.c_includes = set(index['c_includes'])
+        self.exported_packages = set(index['exported_packages'])
+
+        self._filename = filename
+        self._data = data
+        self._data_offset = _INDEX_HEADER.size + index['length']
+        self._order = index['order']
+        self._fragments = index['fragments']
+        self._pending = set(range(len(self._fragments)))
+        self._name_index = index['names']
+        self._ctype_index = index['ctypes']
+        self._gtype_name_index = index['type_names']
+        self._symbol_index = index['symbols']
+        self._parser = GIRParser(types_only=True)
+
+    def _materialize(self, fragment):
+        if fragment not in self._pending:
+            return
+        self._pending.remove(fragment)
+        offset, length = self._fragments[fragment]
+        start = self._data_offset + offset
+        node = fromstring(self._data[start:start + length])
+        self._parser.parse_node(self, self._filename, node)
+
+    def _materialize_all(self):
+        if not self._pending:
+            return
+        for fragment in sorted(self._pending):
+            self._materialize(fragment)
+        # Restore document order regardless of the lookup order
+        self.names = OrderedDict((name, self.names[name])
+                                 for name in self._order if name in self.names)
+
+    def _lookup(self, index, table, key):
+        value = table.get(key)
+        if value is None and key in index:
+            self._materialize(index[key])
+            value = table.get(key)
+        return value
+
+    def get(self, name):
+        return self._lookup(self._name_index, self.names, name)
+
+    def get_by_ctype(self, ctype):
+        return self._lookup(self._ctype_index, self.ctypes, ctype)
+
+    def get_by_gtype_name(self, gtype_name):
+        return self._lookup(self._gtype_name_index, self.type_names, gtype_name)
+
+    def get_by_symbol(self, symbol):
+        return self._lookup(self._symbol_index, self.symbols, symbol)
+
+    def __iter__(self):
+        self._materialize_all()
+        return ast.Namespace.__iter__(self)
+
+    def items(self):
+        self._materialize_all()
+        return ast.Namespace.items(self)
+
+    def values(self):
+        self._materialize_all()
+        return ast.Namespace.values(self)
+
+    def remove(self, node):
+        self._materialize_all()
+        ast.Namespace.remove(self, node)
+
+
+def _build_index(filename, stat, digest, output):
+    """Write an index for the GIR file filename, of which stat holds the
+size and modification time and digest the SHA-256 digest of the
+contents, to the file object output."""
+    parser = GIRParser(types_only=True)
+    tree = parse(filename)
+    ns = parser.parse_namespace_header(filename, tree)
+    header = parser.get_namespace()
+
+    index = dict(name=header.name,
+                 version=header.version,
+                 identifier_prefixes=header.identifier_prefixes,
+                 symbol_prefixes=header.symbol_prefixes,
+                 shared_libraries=header.shared_libraries,
+                 includes=sorted((i.name, i.version) for i in header.includes),
+                 c_includes=sorted(header.c_includes),
+                 exported_packages=sorted(header.exported_packages),
+                 order=[],
+                 fragments=[],
+                 names={},
+                 ctypes={},
+                 type_names={},
+                 symbols={})
+    fragments = []
+    offset = 0
+
+    for element in ns:
+        # Parse each node on its own to find out which names it
+        # provides; this is the only point where the whole file is parsed.
+        scratch = ast.Namespace(header.name, header.version,
+                                identifier_prefixes=header.identifier_prefixes,
+                                symbol_prefixes=header.symbol_prefixes)
+        parser.parse_node(scratch, filename, element)
+        if not scratch.names:
+            continue
+        position = len(fragments)
+
+        tail = element.tail
+        element.tail = None
+        fragment = tostring(element)
+        element.tail = tail
+
+        index['fragments'].append((offset, len(fragment)))
+        for name in scratch.names:
+            index['order'].append(name)
+            index['names'][name] = position
+        for ctype in scratch.ctypes:
+            index['ctypes'][ctype] = position
+        for gtype_name in scratch.type_names:
+            index['type_names'][gtype_name] = position
+        for symbol in scratch.symbols:
+            index['symbols'][symbol] = position
+        fragments.append(fragment)
+        offset += len(fragment)
+
+    data = pickle.dumps(index, 2)
+    index['length'] = len(data)
+    output.write(_INDEX_HEADER.pack(_INDEX_MAGIC, _CACHE_FORMAT_VERSION,
+                                    len(data), stat[0], stat[1], digest))
+    output.write(data)
+    for fragment in fragments:
+        output.write(fragment)
+
+
+def _update_index_stat(index_filename, stat):
+    try:
+        with open(index_filename, 'r+b') as f:
+            f.seek(_INDEX_STAT_OFFSET)
+            f.write(_INDEX_STAT.pack(*stat))
+    except (IOError, OSError) as e:
+        # Permission denied
+        if e.errno != errno.EACCES:
+            raise
+
+
+def _load_index(filename, stat, get_digest, index_filename):
+    """Load the index index_filename of the GIR file filename.  The
+digest of the file is only computed, by calling get_digest, when its
+size or modification time differ from the ones recorded in the index."""
+    with open(index_filename, 'rb') as f:
+        try:
+            data = mmap.mmap(f.fileno(), 0, access=mmap.ACCESS_READ)
+        except (ValueError, EnvironmentError):
+            # Empty file
+            return None
+    if len(data) < _INDEX_HEADER.size:
+        return None
+    magic, version, length, size, mtime, index_digest = \
+        _INDEX_HEADER.unpack(data[:_INDEX_HEADER.size])
+    if magic != _INDEX_MAGIC or version != _CACHE_FORMAT_VERSION:
+        return None
+    if (size, mtime) != stat:
+        if index_digest != get_digest():
+            # Built from an older version of the file
+            return None
+        # Only touched; record the new time so the next load doesn't
+        # need to hash the file again
+        _update_index_stat(index_filename, stat)
+    try:
+        index = pickle.loads(data[_INDEX_HEADER.size:_INDEX_HEADER.size + length])
+    except (AttributeError, EOFError, ValueError, pickle.UnpicklingError):
+        return None
+    index['length'] = length
+    return LazyNamespace(filename, data, index)
 
 
 class CacheStore(object):
@@ -108,15 +316,21 @@ class CacheStore(object):
         # on a read only home directory where we just disable
         # the cache all together.
         if self._directory is None:
-            return
-        # Assume UTF-8 encoding for the filenames. This doesn't matter so much
-        # as long as the results of this method always produce the same hash.
-        hexdigest = hashlib.sha1(filename.encode('utf-8')).hexdigest()
-        return os.path.join(self._directory, hexdigest)
+            return None
+        # One entry per file, replaced whenever the file changes, so
+        # the cache doesn't grow with every edit of an included GIR
+        path = os.path.realpath(filename).encode('utf-8')
+        return os.path.join(self._directory,
+                            hashlib.sha256(path).hexdigest() + '.index')
 
-    def _cache_is_valid(self, store_filename, filename):
-        return (os.stat(store_filename).st_mtime >=
-                os.stat(filename).st_mtime)
+    def _get_digest(self, filename):
+        # Entries are checked against the contents of the file, so they
+        # stay valid when it is only touched
+        checksum = hashlib.sha256()
+        with open(filename, 'rb') as f:
+            for chunk in iter(lambda: f.read(1 << 20), b''):
+                checksum.update(chunk)
+        return checksum.digest()
 
     def _remove_filename(self, filename):
         try:
@@ -134,23 +348,16 @@ class CacheStore(object):
                 continue
             self._remove_filename(os.path.join(self._directory, filename))
 
-    def store(self, filename, data):
-        store_filename = self._get_filename(filename)
-        if store_filename is None:
-            return
-
-        if (os.path.exists(store_filename) and self._cache_is_valid(store_filename, filename)):
-            return None
-
+    def _store(self, filename, stat, digest, store_filename):
         tmp_fd, tmp_filename = tempfile.mkstemp(prefix='g-ir-scanner-cache-')
         try:
             with os.fdopen(tmp_fd, 'wb') as tmp_file:
-                pickle.dump(data, tmp_file)
+                _build_index(filename, stat, digest, tmp_file)
         except (IOError, OSError) as e:
             # No space left on device
             if e.errno == errno.ENOSPC:
                 self._remove_filename(tmp_filename)
-                return
+                return False
             else:
                 raise
 
@@ -160,26 +367,34 @@ class CacheStore(object):
             # Permission denied
             if e.errno == errno.EACCES:
                 self._remove_filename(tmp_filename)
+                return False
             else:
                 raise
+        return True
 
-    def load(self, filename):
+    def load_namespace(self, filename):
+        """Return a lazily loaded, types-only Namespace for the GIR file
+filename, building the index first if necessary.  Returns None if the
+cache is disabled or not writable."""
         store_filename = self._get_filename(filename)
         if store_filename is None:
-            return
-        try:
-            fd = open(store_filename, 'rb')
-        except (IOError, OSError) as e:
-            if e.errno == errno.ENOENT:
-                return None
-            else:
-                raise
-        if not self._cache_is_valid(store_filename, filename):
             return None
-        try:
-            data = pickle.load(fd)
-        except (AttributeError, EOFError, ValueError, pickle.BadPickleGet):
-            # Broken cache entry, remove it
+
+        stat = _get_stat(filename)
+        digests = []
+
+        def get_digest():
+            if not digests:
+                digests.append(self._get_digest(filename))
+            return digests[0]
+
+        if os.path.exists(store_filename):
+            namespace = _load_index(filename, stat, get_digest, store_filename)
+            if namespace is not None:
+                return namespace
+            # Broken or outdated cache entry, remove it
             self._remove_filename(store_filename)
-            data = None
-        return data
+
+        if not self._store(filename, stat, get_digest(), store_filename):
+            return None
+        return _load_index(filename, stat, get_digest, store_filename)
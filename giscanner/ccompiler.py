@@ -184,8 +184,11 @@ class CCompiler(object):
                 else:
                     args.append('-l' + library)
 
-    def preprocess(self, source, output, cpp_options):
+    def preprocess(self, source, output, cpp_options, keep_macros=False):
         extra_postargs = ['-C']
+        if keep_macros:
+            assert self.can_keep_macros()
+            extra_postargs.append('-dD')
         (include_paths, macros, postargs) = self._set_cpp_options(cpp_options)
 
         # We always want to include the current path
@@ -354,6 +357,11 @@ class CCompiler(object):
     def check_is_msvc(self):
         return isinstance(self.compiler, MSVCCompiler)
 
+    def can_keep_macros(self):
+        """Whether preprocess() can keep the #define directives in its
+        output, for the source scanner to collect them"""
+        return not self.check_is_msvc()
+
     # Private APIs
     def _set_cpp_options(self, options):
         includes = []
@@ -53,6 +53,13 @@ def doc_main(args):
     parser.add_argument("-I", "--add-include-path",
                       action="append", dest="include_paths", default=[],
                       help="include paths for other GIR files")
+    parser.add_argument("-j", "--jobs",
+                        action="store", dest="jobs", type=int, default=1,
+                        help="Number of processes used to render pages, 0 for one per CPU")
+    parser.add_argument("--incremental",
+                        action="store_true", dest="incremental", default=False,
+                        help="Only render the pages whose nodes, or the nodes they "
+                             "reference, changed since the last incremental run")
     parser.add_argument("-s", "--write-sections-file",
                         action="store_const", dest="format", const="sections",
                         help="Backwards-compatible equivalent to -f sections")
@@ -80,6 +87,6 @@ def doc_main(args):
             write_sections_file(fp, sections_file)
     else:
         writer = DocWriter(transformer, args.language, args.format)
-        writer.write(args.output)
+        writer.write(args.output, args.jobs, args.incremental)
 
     return 0
@@ -26,8 +26,11 @@ from __future__ import division
 from __future__ import print_function
 from __future__ import unicode_literals
 
+import hashlib
+import json
 import os
 import re
+import shutil
 import sys
 import tempfile
 
@@ -36,7 +39,9 @@ from mako.lookup import TemplateLookup
 import markdown
 from markdown.extensions.headerid import HeaderIdExtension
 
-from . import ast, xmlwriter
+import giscanner
+from . import ast, utils, xmlwriter
+from .girwriter import GIRWriter
 from .utils import to_underscores
 from .mdextensions import InlineMarkdown
 
@@ -65,6 +70,10 @@ language_mimes = {
     "yaml": "application/x-yaml",
 }
 
+# The reference recorded for pages which depend on the set of nodes in
+# the namespace rather than on particular nodes.
+MEMBERS_REFERENCE = '*'
+
 
 def make_page_id(node, recursive=False):
     if isinstance(node, ast.Namespace):
@@ -224,6 +233,9 @@ class DocFormatter(object):
         # we won't insert paragraphs and will respect new lines.
         self._processing_code = False
         self._processing_attr = False
+        # The GINames of the toplevel nodes looked up while rendering a
+        # page, when recording them for an incremental run.
+        self._references = None
 
     def escape(self, text):
         return saxutils.escape(text)
@@ -257,27 +269,54 @@ class DocFormatter(object):
 
         return result
 
+    def start_references(self):
+        self._references = set()
+
+    def finish_references(self):
+        references = self._references
+        self._references = None
+        return references
+
+    def _add_reference(self, node):
+        if self._references is None:
+            return node
+        if node is None:
+            # Whatever was looked up might be added to the namespace later
+            self._references.add(MEMBERS_REFERENCE)
+            return node
+        while isinstance(getattr(node, 'parent', None), ast.Node):
+            node = node.parent
+        if isinstance(node, ast.Node) and node.namespace is not None:
+            self._references.add(node.gi_name)
+        return node
+
+    def _lookup_typenode(self, typeobj):
+        node = self._transformer.lookup_typenode(typeobj)
+        if node is not None or typeobj.target_giname:
+            self._add_reference(node)
+        return node
+
     def _resolve_type(self, ident):
         try:
             matches = self._transformer.split_ctype_namespaces(ident)
         except ValueError:
-            return None
+            return self._add_reference(None)
         for namespace, name in matches:
             node = namespace.get(name)
             if node:
-                return node
-        return None
+                return self._add_reference(node)
+        return self._add_reference(None)
 
     def _resolve_symbol(self, symbol):
         try:
             matches = self._transformer.split_csymbol_namespaces(symbol)
         except ValueError:
-            return None
+            return self._add_reference(None)
         for namespace, name in matches:
             node = namespace.get_by_symbol(symbol)
             if node:
-                return node
-        return None
+                return self._add_reference(node)
+        return self._add_reference(None)
 
     def _find_thing(self, list_, name):
         for item in list_:
@@ -587,7 +626,7 @@ class DocFormatter(object):
 
         parent_chain = [node]
         while node.parent_type:
-            node = self._transformer.lookup_typenode(node.parent_type)
+            node = self._lookup_typenode(node.parent_type)
             parent_chain.append(node)
 
         parent_chain.reverse()
@@ -603,7 +642,7 @@ class DocFormatter(object):
         parent_chain = self.get_class_hierarchy(node)
         types = []
         for p in parent_chain:
-            types += [self._transformer.lookup_typenode(t) for t in p.interfaces]
+            types += [self._lookup_typenode(t) for t in p.interfaces]
         types += [t for t in parent_chain if t is not node]
         return types
 
@@ -619,7 +658,7 @@ class DocFormatter(object):
         if f.name == 'g_type_instance':
             return True  # this field on GObject is not exposed
 
-        field_typenode = self._transformer.lookup_typenode(f.type)
+        field_typenode = self._lookup_typenode(f.type)
         if not field_typenode:
             return False
 
@@ -632,7 +671,7 @@ class DocFormatter(object):
             return False  # parent instance heuristics only apply to classes
 
         if node.parent_type:
-            parent_typenode = self._transformer.lookup_typenode(node.parent_type)
+            parent_typenode = self._lookup_typenode(node.parent_type)
             if field_typenode == parent_typenode:
                 return True  # guess that it's a parent instance field
 
@@ -656,9 +695,12 @@ class DocFormatter(object):
         node_name = node.namespace.name + '.' + node.name
         impl = []
 
+        # A class implementing the interface might be added later, too
+        self._add_reference(None)
         for c in node.namespace.values():
             if not isinstance(c, ast.Class):
                 continue
+            self._add_reference(c)
             for implemented in c.interfaces:
                 if implemented.target_giname == node_name:
                     impl.append(c)
@@ -695,7 +737,7 @@ class DocFormatterC(DocFormatter):
         elif type_.target_fundamental:
             return type_.target_fundamental
         else:
-            node = self._transformer.lookup_typenode(type_)
+            node = self._lookup_typenode(type_)
             return getattr(node, 'ctype')
 
     def format_function_name(self, func):
@@ -872,7 +914,7 @@ class DocFormatterGjs(DocFormatterIntrospectableBase):
         if isinstance(node, ast.Class):
             is_gparam_subclass = False
             if node.parent_type:
-                parent = self._transformer.lookup_typenode(node.parent_type)
+                parent = self._lookup_typenode(node.parent_type)
                 while parent:
                     if parent.namespace.name == 'GObject' and \
                        parent.name == 'ParamSpec':
@@ -880,7 +922,7 @@ class DocFormatterGjs(DocFormatterIntrospectableBase):
                         break
                     if parent.parent_type is None:
                         break
-                    parent = self._transformer.lookup_typenode(parent.parent_type)
+                    parent = self._lookup_typenode(parent.parent_type)
             if is_gparam_subclass:
                 return False
 
@@ -948,9 +990,12 @@ class DocFormatterGjs(DocFormatterIntrospectableBase):
             if link:
                 nsname = self._transformer.namespace.name
                 if giname.startswith(nsname + '.'):
+                    # Only for the reference, so the page is rendered
+                    # again when the type is renamed or removed
+                    self._lookup_typenode(type_)
                     return '<link xref="%s">%s</link>' % (giname, giname)
                 else:
-                    resolved = self._transformer.lookup_typenode(type_)
+                    resolved = self._lookup_typenode(type_)
                     if resolved:
                         return self.format_xref(resolved)
             return giname
@@ -1056,7 +1101,7 @@ class DocFormatterGjs(DocFormatterIntrospectableBase):
                (None, 'none', 'gpointer', 'utf8', 'filename', 'va_list'):
                 return True
 
-            resolved = self._transformer.lookup_typenode(node.type)
+            resolved = self._lookup_typenode(node.type)
             if resolved:
                 if isinstance(resolved, ast.Compound) and node.type.ctype[-1] != '*':
                     return self._struct_is_simple(resolved)
@@ -1298,67 +1343,276 @@ class DocWriter(object):
 
         self._lookup = self._get_template_lookup()
 
-    def _get_template_lookup(self):
+    def _get_template_dir(self):
         if 'UNINSTALLED_INTROSPECTION_SRCDIR' in os.environ:
             top_srcdir = os.environ['UNINSTALLED_INTROSPECTION_SRCDIR']
             srcdir = os.path.join(top_srcdir, 'giscanner')
         else:
             srcdir = os.path.dirname(__file__)
 
-        template_dir = os.path.join(srcdir, 'doctemplates',
-                                    self._formatter.output_format)
+        return os.path.join(srcdir, 'doctemplates',
+                            self._formatter.output_format)
 
-        return TemplateLookup(directories=[template_dir],
+    def _get_template_lookup(self):
+        return TemplateLookup(directories=[self._get_template_dir()],
                               module_directory=tempfile.mkdtemp(),
                               output_encoding='utf-8')
 
-    def write(self, output):
+    def _get_environment_digest(self):
+        """Returns a digest of everything other than the namespace that
+the pages depend on, so that an incremental run renders them all again
+when it changes."""
+        digest = hashlib.sha1()
+        digest.update(('%s\0%s\0%s\0' % (giscanner.__version__,
+                                          self._output_format,
+                                          self._language)).encode('utf-8'))
+        template_dir = self._get_template_dir()
+        for dirpath, dirnames, filenames in os.walk(template_dir):
+            dirnames.sort()
+            for filename in sorted(filenames):
+                path = os.path.join(dirpath, filename)
+                relpath = os.path.relpath(path, template_dir)
+                digest.update(relpath.encode('utf-8') + b'\0')
+                with open(path, 'rb') as fp:
+                    digest.update(fp.read())
+        return digest.hexdigest()
+
+    def write(self, output, jobs=1, incremental=False):
         try:
             os.makedirs(output)
         except OSError:
             # directory already made
             pass
 
-        self._walk_node(output, self._transformer.namespace, [])
-        self._transformer.namespace.walk(lambda node, chain: self._walk_node(output, node, chain))
+        pages = []
+        self._walk_node(pages, self._transformer.namespace, [])
+        self._transformer.namespace.walk(lambda node, chain: self._walk_node(pages, node, chain))
+
+        if not incremental:
+            self._render_pages(pages, output, jobs, False)
+            return
+
+        index = PageIndex(self._transformer, output,
+                          self._get_environment_digest())
+        index.remove_stale([make_page_id(node) for node, chain in pages])
+        outdated = [(node, chain) for node, chain in pages
+                    if index.is_outdated(node, make_page_id(node))]
+        references = self._render_pages(outdated, output, jobs, True)
+        for (node, chain), page_references in zip(outdated, references):
+            page_id = make_page_id(node)
+            file_name = page_id + self._formatter.output_extension
+            if chain:
+                page_references.add(chain[0].gi_name)
+            elif not isinstance(node, ast.Namespace):
+                page_references.add(node.gi_name)
+            index.set_page(page_id, file_name, page_references)
+        index.save()
+
+    def _render_pages(self, pages, output, jobs, record):
+        """Renders @pages, returning the set of references recorded for each
+if @record is True."""
+        if jobs == 1:
+            return [self._render_node(node, chain, output, record)
+                    for node, chain in pages]
+
+        # Every page is written to its own file, so they can be rendered by
+        # forked workers in any order. Load the templates first so that the
+        # workers don't all compile them again.
+        global _render_state
+        for node, chain in pages:
+            self._lookup.get_template(self._get_template_name(node))
+        _render_state = (self, pages, output, record)
+        try:
+            return utils.parallel_map(_render_page, range(len(pages)), jobs)
+        finally:
+            _render_state = None
 
-    def _walk_node(self, output, node, chain):
+    def _walk_node(self, pages, node, chain):
         if isinstance(node, ast.Function) and node.moved_to is not None:
             return False
         if self._formatter.should_render_node(node):
-            self._render_node(node, chain, output)
+            pages.append((node, list(chain)))
 
             # hack: fields are not Nodes in the ast, so we don't
             # see them in the visit. Handle them manually here
             if isinstance(node, (ast.Compound, ast.Class)):
                 chain.append(node)
                 for f in node.fields:
-                    self._walk_node(output, f, chain)
+                    self._walk_node(pages, f, chain)
                 chain.pop()
             return True
         return False
 
-    def _render_node(self, node, chain, output):
+    def _get_template_name(self, node):
+        return '%s/%s.tmpl' % (self._language, get_node_kind(node))
+
+    def _render_node(self, node, chain, output, record=False):
         namespace = self._transformer.namespace
 
         # A bit of a hack...maybe this should be an official API
         node._chain = list(chain)
 
         page_kind = get_node_kind(node)
-        template_name = '%s/%s.tmpl' % (self._language, page_kind)
+        template_name = self._get_template_name(node)
         page_id = make_page_id(node)
 
         template = self._lookup.get_template(template_name)
-        result = template.render(namespace=namespace,
-                                 node=node,
-                                 page_id=page_id,
-                                 page_kind=page_kind,
-                                 get_node_kind=get_node_kind,
-                                 formatter=self._formatter,
-                                 ast=ast)
+        if record:
+            self._formatter.start_references()
+        try:
+            result = template.render(namespace=namespace,
+                                     node=node,
+                                     page_id=page_id,
+                                     page_kind=page_kind,
+                                     get_node_kind=get_node_kind,
+                                     formatter=self._formatter,
+                                     ast=ast)
+        finally:
+            references = self._formatter.finish_references()
 
         output_base_name = page_id + self._formatter.output_extension
         output_file_name = os.path.join(os.path.abspath(output),
                                         output_base_name)
         with open(output_file_name, 'wb') as fp:
             fp.write(result)
+        return references
+
+
+class _NodeDigester(GIRWriter):
+    """Computes a digest of the GIR written for single toplevel nodes."""
+
+    def __init__(self):
+        # Skip GIRWriter.__init__(), which writes a whole repository
+        super(GIRWriter, self).__init__()
+        self.disable_whitespace()
+
+    def get_digest(self, node):
+        self._digest = hashlib.sha1()
+        self._namespace = node.namespace
+        try:
+            self._write_node(node)
+        finally:
+            self._namespace = None
+            self._data.seek(0)
+            self._data.truncate()
+        return self._digest.hexdigest()
+
+
+class PageIndex(object):
+    """The state kept in the output directory by incremental runs of
+g-ir-doc-tool.
+
+For every page written it records the toplevel nodes the page was
+rendered from and looked up while rendering, along with a digest of
+their GIR.  A page is only outdated when one of those digests changed,
+so editing the documentation of one node only renders the pages of
+that node and of the nodes linking to it again."""
+
+    FILENAME = '.g-ir-doc-tool-index.json'
+    VERSION = 1
+
+    def __init__(self, transformer, output, environment):
+        self._transformer = transformer
+        self._output = output
+        self._environment = environment
+        self._digester = _NodeDigester()
+        self._digests = {}
+        self._pages = {}
+        self._old_digests = {}
+        self._old_pages = {}
+        self._load()
+
+    def _get_path(self):
+        return os.path.join(self._output, self.FILENAME)
+
+    def _load(self):
+        try:
+            with open(self._get_path()) as fp:
+                data = json.load(fp)
+        except (IOError, OSError, ValueError):
+            return
+        if not isinstance(data, dict) or \
+           data.get('version') != self.VERSION or \
+           data.get('environment') != self._environment:
+            return
+        self._old_digests = data['digests']
+        self._old_pages = data['pages']
+
+    def get_digest(self, reference):
+        digest = self._digests.get(reference, False)
+        if digest is not False:
+            return digest
+
+        namespace = self._transformer.namespace
+        if reference == MEMBERS_REFERENCE:
+            names = '\0'.join(sorted(namespace.names))
+            digest = hashlib.sha1(names.encode('utf-8')).hexdigest()
+        else:
+            try:
+                node = self._transformer.lookup_giname(reference)
+            except KeyError:
+                node = None
+            digest = self._digester.get_digest(node) if node is not None else None
+        self._digests[reference] = digest
+        return digest
+
+    def remove_stale(self, page_ids):
+        """Removes the files of the pages previously written which are not
+in @page_ids any more."""
+        page_ids = set(page_ids)
+        for page_id, page in self._old_pages.items():
+            if page_id in page_ids:
+                continue
+            try:
+                os.unlink(os.path.join(self._output, page['file']))
+            except OSError:
+                pass
+
+    def is_outdated(self, node, page_id):
+        # The index pages list all the others
+        if isinstance(node, ast.Namespace):
+            return True
+        page = self._old_pages.get(page_id)
+        if page is None:
+            return True
+        if not os.path.exists(os.path.join(self._output, page['file'])):
+            return True
+        for reference in page['references']:
+            if reference not in self._old_digests or \
+               self.get_digest(reference) != self._old_digests[reference]:
+                return True
+        self._pages[page_id] = page
+        return False
+
+    def set_page(self, page_id, file_name, references):
+        self._pages[page_id] = {'file': file_name,
+                                'references': sorted(references)}
+
+    def save(self):
+        digests = {}
+        for page in self._pages.values():
+            for reference in page['references']:
+                digests[reference] = self.get_digest(reference)
+
+        data = {'version': self.VERSION,
+                'environment': self._environment,
+                'digests': digests,
+                'pages': self._pages}
+        path = self._get_path()
+        with open(path + '.tmp', 'w') as fp:
+            json.dump(data, fp, sort_keys=True)
+        # On Unix, this would just be os.rename() but Windows
+        # doesn't allow that.
+        shutil.move(path + '.tmp', path)
+
+
+# The (writer, pages, output, record) of the DocWriter.write() call
+# rendering pages in worker processes, which inherit it when they are
+# forked.
+_render_state = None
+
+
+def _render_page(index):
+    writer, pages, output, record = _render_state
+    node, chain = pages[index]
+    return writer._render_node(node, chain, output, record)
@@ -24,11 +24,15 @@ from __future__ import division
 from __future__ import print_function
 from __future__ import unicode_literals
 
+import glob
+import hashlib
 import os
 import sys
 import shlex
+import shutil
 import subprocess
 import tempfile
+import time
 
 from .gdumpparser import IntrospectionBinary
 from . import pkgconfig, utils
@@ -73,6 +77,32 @@ main(int argc, char **argv)
 """
 
 
+# Environment variables which influence how the binary is built
+_BUILD_ENVIRONMENT = ['CC', 'CFLAGS', 'CPPFLAGS', 'LDFLAGS', 'PKG_CONFIG_PATH']
+
+# Cached binaries which haven't been used for this many seconds are
+# removed whenever a new one is stored
+_CACHE_MAX_AGE = 30 * 24 * 60 * 60
+
+
+def _get_library_files(libraries, library_paths):
+    """Returns the files that a link against libraries may pick up,
+so that changing one of them invalidates cached binaries."""
+    files = []
+    for library in libraries:
+        if library.endswith('.la'):
+            candidates = [library]
+        else:
+            candidates = []
+            for directory in ['.'] + library_paths:
+                for pattern in ['lib%s.so*', 'lib%s.a', 'lib%s.dylib',
+                                '%s.dll', 'lib%s.dll.a', '%s.lib']:
+                    candidates.extend(sorted(glob.glob(
+                        os.path.join(directory, pattern % (library, )))))
+        files.extend(f for f in candidates if os.path.isfile(f))
+    return files
+
+
 class CompilerError(Exception):
     pass
 
@@ -164,6 +194,28 @@ class DumpCompiler(object):
 
         bin_path = self._generate_tempfile(tmpdir, ext)
 
+        cached_path = None
+        if self._options.dump_cache_dir:
+            # libtool produces wrapper scripts which cannot be relocated
+            # into another temporary directory
+            if utils.get_libtool_command(self._options):
+                if not self._options.quiet:
+                    print("g-ir-scanner: not caching introspection binary "
+                          "built with libtool")
+            else:
+                cached_path = os.path.join(self._options.dump_cache_dir,
+                                           self._get_cache_key(c_path) + ext)
+                if os.path.isfile(cached_path):
+                    if not self._options.quiet:
+                        print("g-ir-scanner: using cached introspection binary %s" % (
+                            cached_path, ))
+                        sys.stdout.flush()
+                    shutil.copy2(cached_path, bin_path)
+                    # Keep it from being pruned
+                    os.utime(cached_path, None)
+                    self._set_runtime_paths()
+                    return IntrospectionBinary([bin_path], tmpdir)
+
         try:
             introspection_obj = self._compile(c_path)
         except CompilerError as e:
@@ -178,10 +230,89 @@ class DumpCompiler(object):
                 utils.rmtree(tmpdir)
             raise SystemExit('linking of temporary binary failed: ' + str(e))
 
+        if cached_path is not None:
+            self._store_in_cache(bin_path, cached_path)
+
         return IntrospectionBinary([bin_path], tmpdir)
 
     # Private API
 
+    def _get_cache_key(self, c_path):
+        """Hashes everything that goes into building the binary: the
+generated source, the compiler and linker flags and the contents of the
+libraries being linked against."""
+        is_msvc = self._compiler.check_is_msvc()
+        inputs = []
+        with open(c_path, 'rb') as f:
+            inputs.append(f.read())
+        inputs.append(os.getcwd())
+        inputs.append(self._compiler.compiler_cmd)
+        inputs.extend(self._linker_cmd)
+        inputs.extend(pkgconfig.cflags(self._packages, msvc_syntax=is_msvc))
+        inputs.extend(pkgconfig.libs(self._packages, msvc_syntax=is_msvc))
+        inputs.extend(self._options.cflags)
+        inputs.extend(self._options.cpp_includes)
+        inputs.append(repr(self._options.external_library))
+        inputs.extend(self._options.libraries)
+        inputs.extend(self._options.extra_libraries)
+        inputs.extend(self._options.library_paths)
+        for envvar in _BUILD_ENVIRONMENT:
+            inputs.append('%s=%s' % (envvar, os.environ.get(envvar, '')))
+        for library in _get_library_files(self._options.libraries +
+                                           self._options.extra_libraries,
+                                           self._options.library_paths):
+            library_checksum = hashlib.sha256()
+            with open(library, 'rb') as f:
+                for chunk in iter(lambda: f.read(65536), b''):
+                    library_checksum.update(chunk)
+            inputs.append('%s:%s' % (os.path.abspath(library),
+                                     library_checksum.hexdigest()))
+
+        checksum = hashlib.sha256()
+        for value in inputs:
+            if not isinstance(value, bytes):
+                value = value.encode('utf-8')
+            checksum.update(value)
+            checksum.update(b'\0')
+        return checksum.hexdigest()
+
+    def _store_in_cache(self, bin_path, cached_path):
+        cache_dir = os.path.dirname(cached_path)
+        tmp_path = None
+        try:
+            utils.makedirs(cache_dir, exist_ok=True)
+            tmp_fd, tmp_path = tempfile.mkstemp(prefix='.tmp-', dir=cache_dir)
+            os.close(tmp_fd)
+            shutil.copy2(bin_path, tmp_path)
+            shutil.move(tmp_path, cached_path)
+        except (IOError, OSError) as e:
+            if tmp_path is not None and os.path.exists(tmp_path):
+                os.unlink(tmp_path)
+            if not self._options.quiet:
+                print("g-ir-scanner: failed to cache introspection binary: %s" % (e, ))
+            return
+        self._prune_cache(cache_dir)
+
+    def _prune_cache(self, cache_dir):
+        oldest = time.time() - _CACHE_MAX_AGE
+        for filename in os.listdir(cache_dir):
+            filename = os.path.join(cache_dir, filename)
+            try:
+                if os.path.getmtime(filename) < oldest:
+                    os.unlink(filename)
+            except OSError:
+                # Removed by another process, permission denied
+                pass
+
+    def _set_runtime_paths(self):
+        # Linking against the library also sets up the runtime library
+        # search path which the cached binary needs as well
+        if not self._options.external_library:
+            self._compiler.get_internal_link_flags([], None,
+                                                   self._options.libraries,
+                                                   self._options.extra_libraries,
+                                                   self._options.library_paths)
+
     def _generate_tempfile(self, tmpdir, suffix=''):
         tmpl = '%s-%s%s' % (self._options.namespace_name,
                             self._options.namespace_version, suffix)
@@ -26,6 +26,7 @@ from __future__ import unicode_literals
 import os
 import sys
 import tempfile
+import time
 import subprocess
 from xml.etree.cElementTree import parse
 
@@ -68,10 +69,11 @@ class UnknownTypeError(Exception):
 
 class GDumpParser(object):
 
-    def __init__(self, transformer):
+    def __init__(self, transformer, dump_shards=1):
         self._transformer = transformer
         self._namespace = transformer.namespace
         self._binary = None
+        self._dump_shards = dump_shards
         self._get_type_functions = []
         self._error_quark_functions = []
         self._error_domains = {}
@@ -150,6 +152,8 @@ class GDumpParser(object):
 blob containing data gleaned from GObject's primitive introspection."""
         in_path = os.path.join(self._binary.tmpdir, 'functions.txt')
         with open(in_path, 'w') as f:
+            if self._dump_shards > 1:
+                f.write('shards:%d\n' % (self._dump_shards, ))
             for func in self._get_type_functions:
                 f.write('get-type:')
                 f.write(func)
@@ -172,12 +176,17 @@ blob containing data gleaned from GObject's primitive introspection."""
 
         # Invoke the binary, having written our get_type functions to types.txt
         try:
+            start = time.time()
             try:
                 subprocess.check_call(args, stdout=sys.stdout, stderr=sys.stderr)
             except subprocess.CalledProcessError as e:
                 # Clean up temporaries
                 raise SystemExit(e)
-            return parse(out_path)
+            utils.debug_timing('dump', start)
+            start = time.time()
+            tree = parse(out_path)
+            utils.debug_timing('dump parse', start)
+            return tree
         finally:
             if not utils.have_debug_flag('save-temps'):
                 utils.rmtree(self._binary.tmpdir)
@@ -75,6 +75,30 @@ class GIRParser(object):
     def get_namespace(self):
         return self._namespace
 
+    def parse_namespace_header(self, filename, tree):
+        """Parse the includes and the namespace attributes of tree, but
+none of its nodes.  Returns the namespace element; its children can then
+be handed to parse_node() one at a time."""
+        self._filename_stack.append(os.path.abspath(filename))
+        self._namespace = None
+        self._pkgconfig_packages = set()
+        self._includes = set()
+        self._c_includes = set()
+        self._c_prefix = None
+        ns = self._parse_namespace_header(tree.getroot())
+        self._filename_stack.pop()
+        return ns
+
+    def parse_node(self, namespace, filename, node):
+        """Parse a single toplevel element of a namespace, appending the
+resulting node to namespace."""
+        self._filename_stack.append(os.path.abspath(filename))
+        self._namespace = namespace
+        method = self._get_parser_methods().get(node.tag)
+        if method is not None:
+            method(node)
+        self._filename_stack.pop()
+
     # Private
 
     def _find_first_child(self, node, name_or_names):
@@ -101,6 +125,15 @@ class GIRParser(object):
         return curfile
 
     def _parse_api(self, root):
+        ns = self._parse_namespace_header(root)
+        parser_methods = self._get_parser_methods()
+
+        for node in ns.getchildren():
+            method = parser_methods.get(node.tag)
+            if method is not None:
+                method(node)
+
+    def _parse_namespace_header(self, root):
         assert root.tag == _corens('repository')
         version = root.attrib['version']
         if version != COMPATIBLE_GIR_VERSION:
@@ -132,7 +165,9 @@ class GIRParser(object):
         self._namespace.includes = self._includes
         self._namespace.c_includes = self._c_includes
         self._namespace.exported_packages = self._pkgconfig_packages
+        return ns
 
+    def _get_parser_methods(self):
         parser_methods = {
             _corens('alias'): self._parse_alias,
             _corens('bitfield'): self._parse_enumeration_bitfield,
@@ -148,10 +183,7 @@ class GIRParser(object):
             parser_methods[_corens('constant')] = self._parse_constant
             parser_methods[_corens('function')] = self._parse_function
 
-        for node in ns.getchildren():
-            method = parser_methods.get(node.tag)
-            if method is not None:
-                method(node)
+        return parser_methods
 
     def _parse_include(self, node):
         include = ast.Include(node.attrib['name'], node.attrib['version'])
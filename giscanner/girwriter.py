@@ -35,8 +35,8 @@ COMPATIBLE_GIR_VERSION = '1.2'
 
 class GIRWriter(XMLWriter):
 
-    def __init__(self, namespace):
-        super(GIRWriter, self).__init__()
+    def __init__(self, namespace, output=None, digest=None):
+        super(GIRWriter, self).__init__(output, digest)
         self.write_comment(
             'This file was automatically generated from C sources - DO NOT EDIT!\n'
             'To affect the contents of this file, edit the original C definitions,\n'
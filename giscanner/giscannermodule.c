@@ -25,6 +25,7 @@
 #include <Python.h>
 #include "sourcescanner.h"
 #include <stdio.h>
+#include <string.h>
 #include <glib-object.h>
 
 #ifndef Py_TYPE
@@ -35,9 +36,11 @@
     #define MOD_INIT(name) PyMODINIT_FUNC PyInit_##name(void)
     #define MOD_ERROR_RETURN NULL
     #define PyInt_FromLong PyLong_FromLong
+    #define PySlice_Cast(ob) (ob)
 #else
     #define MOD_INIT(name) DL_EXPORT(void) init##name(void)
     #define MOD_ERROR_RETURN
+    #define PySlice_Cast(ob) ((PySliceObject *)(ob))
 #endif
 
 /* forward declaration */
@@ -72,6 +75,10 @@ static PyObject * pygi_source_type_new (GISourceType *type);
 typedef struct {
   PyObject_HEAD
   GISourceSymbol *symbol;
+  /* Converted on first access */
+  PyObject *ident;
+  PyObject *base_type;
+  PyObject *source_filename;
 } PyGISourceSymbol;
 
 typedef struct {
@@ -79,9 +86,26 @@ typedef struct {
   GISourceScanner *scanner;
 } PyGISourceScanner;
 
+/* A read-only sequence over (part of) the symbols or comments of a
+ * scanner, which only wraps the elements that are accessed.
+ */
+typedef struct {
+  PyObject_HEAD
+  GPtrArray *array;
+  PyObject * (*wrap) (gpointer data);
+  /* The positions in array of the elements, or NULL for all the
+   * elements from start on */
+  guint *positions;
+  guint start;
+  Py_ssize_t length;
+  /* Wrapped elements, created on first access */
+  PyObject **items;
+} PyGISourceSequence;
+
 NEW_CLASS (PyGISourceSymbol, "SourceSymbol", GISourceSymbol, 10);
 NEW_CLASS (PyGISourceType, "SourceType", GISourceType, 9);
-NEW_CLASS (PyGISourceScanner, "SourceScanner", GISourceScanner, 8);
+NEW_CLASS (PyGISourceScanner, "SourceScanner", GISourceScanner, 13);
+NEW_CLASS (PyGISourceSequence, "SourceSequence", GISourceSequence, 1);
 
 
 /* Symbol */
@@ -100,9 +124,27 @@ pygi_source_symbol_new (GISourceSymbol *symbol)
   self = (PyGISourceSymbol *)PyObject_New (PyGISourceSymbol,
 					   &PyGISourceSymbol_Type);
   self->symbol = symbol;
+  self->ident = NULL;
+  self->base_type = NULL;
+  self->source_filename = NULL;
   return (PyObject*)self;
 }
 
+static void
+pygi_source_symbol_dealloc (PyGISourceSymbol *self)
+{
+  Py_XDECREF (self->ident);
+  Py_XDECREF (self->base_type);
+  Py_XDECREF (self->source_filename);
+  PyObject_Del (self);
+}
+
+static PyObject *
+pygi_source_symbol_wrap (gpointer data)
+{
+  return pygi_source_symbol_new (data);
+}
+
 static PyObject *
 symbol_get_type (PyGISourceSymbol *self,
 		 void             *context)
@@ -128,21 +170,31 @@ static PyObject *
 symbol_get_ident (PyGISourceSymbol *self,
 		  void            *context)
 {
-
-  if (!self->symbol->ident)
+  if (!self->ident)
     {
-      Py_INCREF(Py_None);
-      return Py_None;
+      if (!self->symbol->ident)
+        {
+          Py_INCREF(Py_None);
+          self->ident = Py_None;
+        }
+      else if (!(self->ident = PyUnicode_FromString (self->symbol->ident)))
+        return NULL;
     }
 
-  return PyUnicode_FromString (self->symbol->ident);
+  Py_INCREF (self->ident);
+  return self->ident;
 }
 
 static PyObject *
 symbol_get_base_type (PyGISourceSymbol *self,
 		      void             *context)
 {
-  return pygi_source_type_new (self->symbol->base_type);
+  if (!self->base_type &&
+      !(self->base_type = pygi_source_type_new (self->symbol->base_type)))
+    return NULL;
+
+  Py_INCREF (self->base_type);
+  return self->base_type;
 }
 
 static PyObject *
@@ -203,13 +255,19 @@ static PyObject *
 symbol_get_source_filename (PyGISourceSymbol *self,
                             void             *context)
 {
-  if (!self->symbol->source_filename)
+  if (!self->source_filename)
     {
-      Py_INCREF(Py_None);
-      return Py_None;
+      if (!self->symbol->source_filename)
+        {
+          Py_INCREF(Py_None);
+          self->source_filename = Py_None;
+        }
+      else if (!(self->source_filename = PyUnicode_FromString (self->symbol->source_filename)))
+        return NULL;
     }
 
-  return PyUnicode_FromString (self->symbol->source_filename);
+  Py_INCREF (self->source_filename);
+  return self->source_filename;
 }
 
 static const PyGetSetDef _PyGISourceSymbol_getsets[] = {
@@ -344,6 +402,150 @@ static const PyGetSetDef _PyGISourceType_getsets[] = {
 
 
 
+/* Sequence */
+
+static PyObject *
+pygi_source_sequence_new (GPtrArray  *array,
+                          PyObject * (*wrap) (gpointer data),
+                          guint       start,
+                          guint      *positions,
+                          Py_ssize_t  length)
+{
+  PyGISourceSequence *self;
+
+  self = (PyGISourceSequence *)PyObject_New (PyGISourceSequence,
+                                             &PyGISourceSequence_Type);
+  if (!self)
+    {
+      g_free (positions);
+      return NULL;
+    }
+
+  self->array = g_ptr_array_ref (array);
+  self->wrap = wrap;
+  self->positions = positions;
+  self->start = start;
+  self->length = length;
+  self->items = g_new0 (PyObject *, length);
+  return (PyObject*)self;
+}
+
+static void
+pygi_source_sequence_dealloc (PyGISourceSequence *self)
+{
+  Py_ssize_t i;
+
+  for (i = 0; i < self->length; i++)
+    Py_XDECREF (self->items[i]);
+  g_free (self->items);
+  g_free (self->positions);
+  g_ptr_array_unref (self->array);
+  PyObject_Del (self);
+}
+
+static Py_ssize_t
+pygi_source_sequence_length (PyGISourceSequence *self)
+{
+  return self->length;
+}
+
+static PyObject *
+pygi_source_sequence_item (PyGISourceSequence *self,
+                           Py_ssize_t          i)
+{
+  if (i < 0 || i >= self->length)
+    {
+      PyErr_SetString (PyExc_IndexError, "SourceSequence index out of range");
+      return NULL;
+    }
+
+  if (!self->items[i])
+    {
+      guint position = self->positions ? self->positions[i] : self->start + i;
+
+      self->items[i] = self->wrap (g_ptr_array_index (self->array, position));
+      if (!self->items[i])
+        return NULL;
+    }
+
+  Py_INCREF (self->items[i]);
+  return self->items[i];
+}
+
+static PyObject *
+pygi_source_sequence_subscript (PyGISourceSequence *self,
+                                PyObject           *key)
+{
+  if (PyIndex_Check (key))
+    {
+      Py_ssize_t i = PyNumber_AsSsize_t (key, PyExc_IndexError);
+
+      if (i == -1 && PyErr_Occurred ())
+        return NULL;
+      if (i < 0)
+        i += self->length;
+      return pygi_source_sequence_item (self, i);
+    }
+  else if (PySlice_Check (key))
+    {
+      Py_ssize_t start, stop, step, length, i;
+      PyObject *list;
+
+      if (PySlice_GetIndicesEx (PySlice_Cast (key), self->length,
+                                &start, &stop, &step, &length) < 0)
+        return NULL;
+
+      list = PyList_New (length);
+      if (!list)
+        return NULL;
+
+      for (i = 0; i < length; i++, start += step)
+        {
+          PyObject *item = pygi_source_sequence_item (self, start);
+
+          if (!item)
+            {
+              Py_DECREF (list);
+              return NULL;
+            }
+          PyList_SET_ITEM (list, i, item);
+        }
+
+      return list;
+    }
+
+  PyErr_Format (PyExc_TypeError,
+                "SourceSequence indices must be integers or slices, not %s",
+                Py_TYPE (key)->tp_name);
+  return NULL;
+}
+
+static PySequenceMethods _PyGISourceSequence_as_sequence = {
+  (lenfunc)pygi_source_sequence_length,
+  0,
+  0,
+  (ssizeargfunc)pygi_source_sequence_item,
+};
+
+static PyMappingMethods _PyGISourceSequence_as_mapping = {
+  (lenfunc)pygi_source_sequence_length,
+  (binaryfunc)pygi_source_sequence_subscript,
+  0
+};
+
+/* Clamps start and end (-1 for the end) to the length of array */
+static void
+pygi_source_sequence_clamp (GPtrArray  *array,
+                            Py_ssize_t *start,
+                            Py_ssize_t *end)
+{
+  if (*end < 0 || *end > (Py_ssize_t) array->len)
+    *end = array->len;
+  *start = CLAMP (*start, 0, *end);
+}
+
+
+
 /* Scanner */
 
 static int
@@ -495,89 +697,538 @@ pygi_source_scanner_set_macro_scan (PyGISourceScanner *self,
 }
 
 static PyObject *
-pygi_source_scanner_get_symbols (PyGISourceScanner *self, G_GNUC_UNUSED PyObject *unused)
+pygi_source_scanner_set_collect_macros (PyGISourceScanner *self,
+                                        PyObject          *args)
 {
-  GSList *l, *symbols;
-  PyObject *list;
-  int i = 0;
+  int collect_macros;
+
+  if (!PyArg_ParseTuple (args, "i:SourceScanner.set_collect_macros", &collect_macros))
+    return NULL;
+
+  gi_source_scanner_set_collect_macros (self->scanner, collect_macros);
+
+  Py_INCREF (Py_None);
+  return Py_None;
+}
+
+/* get_symbols([types[, start[, end]]]): returns a SourceSequence of the
+ * symbols from position start to end (-1 for all), or only of those of
+ * which the type is in the sequence types, without wrapping the others.
+ */
+static PyObject *
+pygi_source_scanner_get_symbols (PyGISourceScanner *self,
+                                 PyObject          *args)
+{
+  PyObject *types = Py_None;
+  Py_ssize_t start = 0, end = -1, length, i;
+  GPtrArray *symbols;
+  PyObject *iter, *item;
+  guint32 type_mask = 0;
+  guint *positions;
+
+  if (!PyArg_ParseTuple (args, "|Onn:SourceScanner.get_symbols",
+                         &types, &start, &end))
+    return NULL;
 
   symbols = gi_source_scanner_get_symbols (self->scanner);
-  list = PyList_New (g_slist_length (symbols));
+  pygi_source_sequence_clamp (symbols, &start, &end);
+
+  if (types == Py_None)
+    return pygi_source_sequence_new (symbols, pygi_source_symbol_wrap,
+                                     start, NULL, end - start);
+
+  iter = PyObject_GetIter (types);
+  if (!iter)
+    return NULL;
 
-  for (l = symbols; l; l = l->next)
+  while ((item = PyIter_Next (iter)))
     {
-      PyObject *item = pygi_source_symbol_new (l->data);
-      PyList_SetItem (list, i++, item);
+      long type = PyLong_AsLong (item);
+
+      Py_DECREF (item);
+      if (type == -1 && PyErr_Occurred ())
+        break;
+      if (type < 0 || type >= 32)
+        {
+          PyErr_Format (PyExc_ValueError, "invalid symbol type %ld", type);
+          break;
+        }
+      type_mask |= 1u << type;
     }
+  Py_DECREF (iter);
+
+  if (PyErr_Occurred ())
+    return NULL;
+
+  positions = g_new (guint, end - start);
+  length = 0;
+  for (i = start; i < end; i++)
+    {
+      GISourceSymbol *symbol = g_ptr_array_index (symbols, i);
+
+      if (type_mask & (1u << symbol->type))
+        positions[length++] = i;
+    }
+
+  return pygi_source_sequence_new (symbols, pygi_source_symbol_wrap,
+                                   0, positions, length);
+}
+
+static PyObject *
+pygi_source_comment_wrap (gpointer data)
+{
+  GISourceComment *comment = data;
+  PyObject *comment_obj;
+  PyObject *filename_obj;
+  PyObject *item;
+
+  if (comment->comment)
+    {
+      comment_obj = PyUnicode_FromString (comment->comment);
+      if (!comment_obj)
+        {
+          g_print ("Comment is not valid Unicode in %s line %d\n", comment->filename, comment->line);
+          PyErr_Clear ();
+          Py_INCREF (Py_None);
+          comment_obj = Py_None;
+        }
+    }
+  else
+    {
+      Py_INCREF (Py_None);
+      comment_obj = Py_None;
+    }
+
+  if (comment->filename)
+    {
+      filename_obj = PyUnicode_FromString (comment->filename);
+    }
+  else
+    {
+      Py_INCREF (Py_None);
+      filename_obj = Py_None;
+    }
+
+  item = Py_BuildValue ("(OOi)", comment_obj, filename_obj, comment->line);
+
+  Py_DECREF (comment_obj);
+  Py_XDECREF (filename_obj);
+  return item;
+}
+
+/* get_comments([start[, end]]): returns a SourceSequence of
+ * (comment, filename, line) tuples */
+static PyObject *
+pygi_source_scanner_get_comments (PyGISourceScanner *self,
+                                  PyObject          *args)
+{
+  Py_ssize_t start = 0, end = -1;
+  GPtrArray *comments;
+
+  if (!PyArg_ParseTuple (args, "|nn:SourceScanner.get_comments", &start, &end))
+    return NULL;
+
+  comments = gi_source_scanner_get_comments (self->scanner);
+  pygi_source_sequence_clamp (comments, &start, &end);
+
+  return pygi_source_sequence_new (comments, pygi_source_comment_wrap,
+                                   start, NULL, end - start);
+}
+
+static PyObject *
+pygi_source_scanner_get_typedefs (PyGISourceScanner *self, G_GNUC_UNUSED PyObject *unused)
+{
+  GHashTableIter iter;
+  gpointer key;
+  PyObject *list;
+  int i = 0;
+
+  list = PyList_New (g_hash_table_size (self->scanner->typedef_table));
+
+  g_hash_table_iter_init (&iter, self->scanner->typedef_table);
+  while (g_hash_table_iter_next (&iter, &key, NULL))
+    PyList_SetItem (list, i++, PyUnicode_FromString (key));
 
-  g_slist_free (symbols);
-  Py_INCREF (list);
   return list;
 }
 
 static PyObject *
-pygi_source_scanner_get_comments (PyGISourceScanner *self, G_GNUC_UNUSED PyObject *unused)
+pygi_source_scanner_add_typedef (PyGISourceScanner *self,
+                                 PyObject          *args)
+{
+  char *name;
+
+  if (!PyArg_ParseTuple (args, "s:SourceScanner.add_typedef", &name))
+    return NULL;
+
+  g_hash_table_insert (self->scanner->typedef_table,
+                       g_strdup (name), GINT_TO_POINTER (TRUE));
+
+  Py_INCREF (Py_None);
+  return Py_None;
+}
+
+static PyObject *
+pygi_source_scanner_get_constants (PyGISourceScanner *self, G_GNUC_UNUSED PyObject *unused)
 {
-  GSList *l, *comments;
+  GHashTableIter iter;
+  gpointer key, value;
   PyObject *list;
   int i = 0;
 
-  comments = gi_source_scanner_get_comments (self->scanner);
-  list = PyList_New (g_slist_length (comments));
+  list = PyList_New (g_hash_table_size (self->scanner->const_table));
 
-  for (l = comments; l; l = l->next)
+  g_hash_table_iter_init (&iter, self->scanner->const_table);
+  while (g_hash_table_iter_next (&iter, &key, &value))
     {
-      GISourceComment *comment = l->data;
-      PyObject *comment_obj;
-      PyObject *filename_obj;
-      PyObject *item;
+      GISourceSymbol *symbol = value;
 
-      if (comment->comment)
+      PyList_SetItem (list, i++,
+                      Py_BuildValue ("(sLsi)", (char *) key,
+                                     (long long) symbol->const_int,
+                                     symbol->source_filename, symbol->line));
+    }
+
+  return list;
+}
+
+/* Seeds the table of enumeration constants which may be referenced from
+ * constant expressions, e.g. when the declarations were loaded from a
+ * cache instead of being parsed.
+ */
+static PyObject *
+pygi_source_scanner_add_constant (PyGISourceScanner *self,
+                                  PyObject          *args)
+{
+  char *ident;
+  long long value;
+  char *filename;
+  int line;
+  GFile *file;
+  GISourceSymbol *symbol;
+
+  if (!PyArg_ParseTuple (args, "sLsi:SourceScanner.add_constant",
+                         &ident, &value, &filename, &line))
+    return NULL;
+
+  file = g_file_new_for_path (filename);
+  symbol = gi_source_symbol_new (CSYMBOL_TYPE_OBJECT, file, line);
+  g_object_unref (file);
+
+  symbol->ident = g_strdup (ident);
+  symbol->const_int_set = TRUE;
+  symbol->const_int = value;
+  g_hash_table_insert (self->scanner->const_table, g_strdup (ident), symbol);
+
+  Py_INCREF (Py_None);
+  return Py_None;
+}
+
+static const PyMethodDef _PyGISourceScanner_methods[] = {
+  { "get_comments", (PyCFunction) pygi_source_scanner_get_comments, METH_VARARGS },
+  { "get_symbols", (PyCFunction) pygi_source_scanner_get_symbols, METH_VARARGS },
+  { "append_filename", (PyCFunction) pygi_source_scanner_append_filename, METH_VARARGS },
+  { "parse_file", (PyCFunction) pygi_source_scanner_parse_file, METH_VARARGS },
+  { "parse_macros", (PyCFunction) pygi_source_scanner_parse_macros, METH_VARARGS },
+  { "lex_filename", (PyCFunction) pygi_source_scanner_lex_filename, METH_VARARGS },
+  { "set_macro_scan", (PyCFunction) pygi_source_scanner_set_macro_scan, METH_VARARGS },
+  { "set_collect_macros", (PyCFunction) pygi_source_scanner_set_collect_macros, METH_VARARGS },
+  { "get_typedefs", (PyCFunction) pygi_source_scanner_get_typedefs, METH_NOARGS },
+  { "add_typedef", (PyCFunction) pygi_source_scanner_add_typedef, METH_VARARGS },
+  { "get_constants", (PyCFunction) pygi_source_scanner_get_constants, METH_NOARGS },
+  { "add_constant", (PyCFunction) pygi_source_scanner_add_constant, METH_VARARGS },
+  { NULL, NULL, 0 }
+};
+
+/* GTK-Doc comment tokenizer
+ *
+ * Classifies the lines of a GTK-Doc comment block the same way the
+ * regular expressions in annotationparser.py do, so the parser only
+ * needs to fall back to them for the identifier line.  Only ASCII lines
+ * are handled; for any other line None is returned and the regular
+ * expressions are used, so that the unicode semantics of \s and \w
+ * and case folding are kept.
+ */
+
+enum {
+  COMMENT_LINE_TEXT,
+  COMMENT_LINE_EMPTY,
+  COMMENT_LINE_PARAMETER,
+  COMMENT_LINE_TAG
+};
+
+/* The ASCII characters matched by \s in a unicode regular expression */
+static gboolean
+comment_is_space (char c)
+{
+  return c == ' ' || (c >= '\t' && c <= '\r') || (c >= '\x1c' && c <= '\x1f');
+}
+
+static gboolean
+comment_is_word (char c)
+{
+  return g_ascii_isalnum (c) || c == '_';
+}
+
+static Py_ssize_t
+comment_skip_space (const char *line, Py_ssize_t i, Py_ssize_t len)
+{
+  while (i < len && comment_is_space (line[i]))
+    i++;
+  return i;
+}
+
+/* Returns the position of the ':' following name_end, or -1 */
+static Py_ssize_t
+comment_find_delimiter (const char *line, Py_ssize_t name_end, Py_ssize_t len)
+{
+  Py_ssize_t i = comment_skip_space (line, name_end, len);
+
+  return (i < len && line[i] == ':') ? i : -1;
+}
+
+/* PARAMETER_RE: ^\s*@(?P<parameter_name>[\w-]*\w|.*?\.\.\.)\s*:\s*(?P<fields>.*?)\s*$ */
+static gboolean
+comment_match_parameter (const char *line, Py_ssize_t start, Py_ssize_t len,
+                         Py_ssize_t *name_end, Py_ssize_t *delimiter)
+{
+  Py_ssize_t i;
+
+  for (i = start; i < len && (comment_is_word (line[i]) || line[i] == '-'); i++)
+    ;
+  if (i > start && comment_is_word (line[i - 1]))
+    {
+      *delimiter = comment_find_delimiter (line, i, len);
+      if (*delimiter >= 0)
         {
-          comment_obj = PyUnicode_FromString (comment->comment);
-          if (!comment_obj)
-            {
-              g_print ("Comment is not valid Unicode in %s line %d\n", comment->filename, comment->line);
-              Py_INCREF (Py_None);
-              comment_obj = Py_None;
-            }
+          *name_end = i;
+          return TRUE;
         }
-      else
+    }
+
+  for (i = start; i + 3 <= len; i++)
+    {
+      if (line[i] != '.' || line[i + 1] != '.' || line[i + 2] != '.')
+        continue;
+      *delimiter = comment_find_delimiter (line, i + 3, len);
+      if (*delimiter >= 0)
         {
-          Py_INCREF (Py_None);
-          comment_obj = Py_None;
+          *name_end = i + 3;
+          return TRUE;
         }
+    }
+
+  return FALSE;
+}
 
-      if (comment->filename)
+/* TAG_RE: ^\s*(?P<tag_name>tag|tag|...)\s*:\s*(?P<fields>.*?)\s*$, ignoring
+ * case, with the spaces in the tag names matching any whitespace
+ */
+static gboolean
+comment_match_tag (const char *line, Py_ssize_t start, Py_ssize_t len,
+                   const char **tags, Py_ssize_t n_tags,
+                   Py_ssize_t *name_end, Py_ssize_t *delimiter)
+{
+  Py_ssize_t t;
+
+  for (t = 0; t < n_tags; t++)
+    {
+      const char *tag = tags[t];
+      Py_ssize_t i = start;
+
+      for (; *tag != '\0' && i < len; tag++, i++)
+        {
+          if (*tag == ' ' ? !comment_is_space (line[i])
+                          : g_ascii_tolower (line[i]) != g_ascii_tolower (*tag))
+            break;
+        }
+      if (*tag != '\0')
+        continue;
+
+      *delimiter = comment_find_delimiter (line, i, len);
+      if (*delimiter >= 0)
+        {
+          *name_end = i;
+          return TRUE;
+        }
+    }
+
+  return FALSE;
+}
+
+static PyObject *
+comment_tokenize_line (const char *line, Py_ssize_t len,
+                       const char **tags, Py_ssize_t n_tags)
+{
+  PyObject *asterisk;
+  PyObject *spans;
+  Py_ssize_t indent, line_indent, offset, i;
+  Py_ssize_t name_start, name_end = 0, delimiter = 0;
+  Py_ssize_t fields_start, fields_end;
+  const char *star;
+  int kind;
+
+  /* INDENTATION_RE */
+  indent = comment_skip_space (line, 0, len);
+
+  /* COMMENT_ASTERISK_RE: the invalid comment text runs up to the
+   * whitespace before the first asterisk */
+  star = memchr (line, '*', len);
+  if (star != NULL)
+    {
+      Py_ssize_t comment_end = star - line;
+
+      while (comment_end > indent && comment_is_space (line[comment_end - 1]))
+        comment_end--;
+      offset = star - line + 1;
+      if (offset < len && comment_is_space (line[offset]))
+        offset++;
+
+      asterisk = Py_BuildValue ("(nnn)", indent, comment_end, offset);
+      line += offset;
+      len -= offset;
+    }
+  else
+    {
+      Py_INCREF (Py_None);
+      asterisk = Py_None;
+    }
+
+  /* INDENTATION_RE again, counting tabs as two spaces */
+  line_indent = 0;
+  for (i = 0; i < len && comment_is_space (line[i]); i++)
+    line_indent += line[i] == '\t' ? 2 : 1;
+
+  kind = COMMENT_LINE_TEXT;
+  name_start = i;
+  if (i == len)
+    kind = COMMENT_LINE_EMPTY;
+  else if (line[i] == '@')
+    {
+      name_start = i + 1;
+      if (comment_match_parameter (line, name_start, len, &name_end, &delimiter))
+        kind = COMMENT_LINE_PARAMETER;
+    }
+  else if (comment_match_tag (line, i, len, tags, n_tags, &name_end, &delimiter))
+    kind = COMMENT_LINE_TAG;
+
+  if (kind == COMMENT_LINE_PARAMETER || kind == COMMENT_LINE_TAG)
+    {
+      fields_start = comment_skip_space (line, delimiter + 1, len);
+      fields_end = len;
+      while (fields_end > fields_start && comment_is_space (line[fields_end - 1]))
+        fields_end--;
+      spans = Py_BuildValue ("(nnnn)", name_start, name_end, fields_start, fields_end);
+    }
+  else
+    {
+      Py_INCREF (Py_None);
+      spans = Py_None;
+    }
+
+  return Py_BuildValue ("(nNniN)", indent, asterisk, line_indent, kind, spans);
+}
+
+static const char *
+comment_get_ascii (PyObject *obj, Py_ssize_t *len)
+{
+  const char *str;
+  Py_ssize_t i;
+
+#if PY_MAJOR_VERSION >= 3
+  if (!PyUnicode_Check (obj))
+    return NULL;
+  str = PyUnicode_AsUTF8AndSize (obj, len);
+#else
+  if (!PyString_Check (obj))
+    return NULL;
+  str = PyString_AS_STRING (obj);
+  *len = PyString_GET_SIZE (obj);
+#endif
+  if (str == NULL)
+    {
+      PyErr_Clear ();
+      return NULL;
+    }
+
+  for (i = 0; i < *len; i++)
+    if ((unsigned char) str[i] >= 0x80)
+      return NULL;
+
+  return str;
+}
+
+static PyObject *
+pygi_tokenize_comment_lines (G_GNUC_UNUSED PyObject *unused,
+                             PyObject                *args)
+{
+  PyObject *lines, *tags;
+  PyObject *lines_seq = NULL, *tags_seq = NULL;
+  PyObject *result = NULL;
+  const char **tag_names = NULL;
+  Py_ssize_t n_lines, n_tags, i;
+
+  if (!PyArg_ParseTuple (args, "OO:tokenize_comment_lines", &lines, &tags))
+    return NULL;
+
+  lines_seq = PySequence_Fast (lines, "lines must be a sequence");
+  if (lines_seq == NULL)
+    goto out;
+  tags_seq = PySequence_Fast (tags, "tags must be a sequence");
+  if (tags_seq == NULL)
+    goto out;
+
+  n_tags = PySequence_Fast_GET_SIZE (tags_seq);
+  tag_names = g_new (const char *, n_tags);
+  for (i = 0; i < n_tags; i++)
+    {
+      Py_ssize_t len;
+
+      tag_names[i] = comment_get_ascii (PySequence_Fast_GET_ITEM (tags_seq, i), &len);
+      if (tag_names[i] == NULL)
         {
-          filename_obj = PyUnicode_FromString (comment->filename);
+          PyErr_SetString (PyExc_TypeError, "tags must be ASCII strings");
+          goto out;
         }
+    }
+
+  n_lines = PySequence_Fast_GET_SIZE (lines_seq);
+  result = PyList_New (n_lines);
+  if (result == NULL)
+    goto out;
+
+  for (i = 0; i < n_lines; i++)
+    {
+      PyObject *item;
+      const char *line;
+      Py_ssize_t len;
+
+      line = comment_get_ascii (PySequence_Fast_GET_ITEM (lines_seq, i), &len);
+      if (line != NULL)
+        item = comment_tokenize_line (line, len, tag_names, n_tags);
       else
         {
           Py_INCREF (Py_None);
-          filename_obj = Py_None;
+          item = Py_None;
         }
 
-      item = Py_BuildValue ("(OOi)", comment_obj, filename_obj, comment->line);
-      PyList_SetItem (list, i++, item);
-
-      Py_DECREF (comment_obj);
-      Py_DECREF (filename_obj);
+      if (item == NULL)
+        {
+          Py_CLEAR (result);
+          goto out;
+        }
+      PyList_SET_ITEM (result, i, item);
     }
 
-  g_slist_free (comments);
-  Py_INCREF (list);
-  return list;
+out:
+  g_free (tag_names);
+  Py_XDECREF (lines_seq);
+  Py_XDECREF (tags_seq);
+  return result;
 }
 
-static const PyMethodDef _PyGISourceScanner_methods[] = {
-  { "get_comments", (PyCFunction) pygi_source_scanner_get_comments, METH_NOARGS },
-  { "get_symbols", (PyCFunction) pygi_source_scanner_get_symbols, METH_NOARGS },
-  { "append_filename", (PyCFunction) pygi_source_scanner_append_filename, METH_VARARGS },
-  { "parse_file", (PyCFunction) pygi_source_scanner_parse_file, METH_VARARGS },
-  { "parse_macros", (PyCFunction) pygi_source_scanner_parse_macros, METH_VARARGS },
-  { "lex_filename", (PyCFunction) pygi_source_scanner_lex_filename, METH_VARARGS },
-  { "set_macro_scan", (PyCFunction) pygi_source_scanner_set_macro_scan, METH_VARARGS },
+static const PyMethodDef _PyGIScanner_functions[] = {
+  { "tokenize_comment_lines", (PyCFunction) pygi_tokenize_comment_lines, METH_VARARGS },
   { NULL, NULL, 0 }
 };
 
@@ -589,7 +1240,7 @@ static struct PyModuleDef moduledef = {
 	NULL, /* m_name */
 	NULL, /* m_doc */
 	0,
-	NULL,
+	(PyMethodDef*)_PyGIScanner_functions,
 	NULL
 };
 #endif /* PY_MAJOR_VERSION >= 3 */
@@ -612,7 +1263,7 @@ MOD_INIT(_giscanner)
     moduledef.m_name = module_name;
     m = PyModule_Create (&moduledef);
 #else
-    m = Py_InitModule (module_name, NULL);
+    m = Py_InitModule (module_name, (PyMethodDef*)_PyGIScanner_functions);
 #endif
     d = PyModule_GetDict (m);
 
@@ -621,11 +1272,17 @@ MOD_INIT(_giscanner)
     REGISTER_TYPE (d, "SourceScanner", PyGISourceScanner_Type);
 
     PyGISourceSymbol_Type.tp_getset = (PyGetSetDef*)_PyGISourceSymbol_getsets;
+    PyGISourceSymbol_Type.tp_dealloc = (destructor)pygi_source_symbol_dealloc;
     REGISTER_TYPE (d, "SourceSymbol", PyGISourceSymbol_Type);
 
     PyGISourceType_Type.tp_getset = (PyGetSetDef*)_PyGISourceType_getsets;
     REGISTER_TYPE (d, "SourceType", PyGISourceType_Type);
 
+    PyGISourceSequence_Type.tp_as_sequence = &_PyGISourceSequence_as_sequence;
+    PyGISourceSequence_Type.tp_as_mapping = &_PyGISourceSequence_as_mapping;
+    PyGISourceSequence_Type.tp_dealloc = (destructor)pygi_source_sequence_dealloc;
+    REGISTER_TYPE (d, "SourceSequence", PyGISourceSequence_Type);
+
 #if PY_MAJOR_VERSION >= 3
     return m;
 #endif
@@ -24,6 +24,7 @@ from __future__ import unicode_literals
 from . import ast
 from . import message
 from .annotationparser import TAG_RETURNS
+from .passmanager import PassManager
 
 
 class IntrospectablePass(object):
@@ -36,13 +37,22 @@ class IntrospectablePass(object):
     # Public API
 
     def validate(self):
-        self._namespace.walk(self._introspectable_alias_analysis)
-        self._namespace.walk(self._propagate_callable_skips)
-        self._namespace.walk(self._analyze_node)
-        self._namespace.walk(self._introspectable_callable_analysis)
-        self._namespace.walk(self._introspectable_callable_analysis)
-        self._namespace.walk(self._introspectable_pass3)
-        self._namespace.walk(self._remove_non_reachable_backcompat_copies)
+        passes = PassManager(self._namespace)
+        aliases = passes.add('alias analysis', self._introspectable_alias_analysis)
+        skips = passes.add('callable skips', self._propagate_callable_skips,
+                           requires=[aliases])
+        nodes = passes.add('node analysis', self._analyze_node,
+                           requires=[skips])
+        # Run twice, since a callable may refer to a callback that is
+        # only found to be non-introspectable later in the same walk.
+        callables = passes.add('callable analysis', self._introspectable_callable_analysis,
+                               requires=[nodes])
+        callables = passes.add('callable analysis 2', self._introspectable_callable_analysis,
+                               requires=[callables])
+        passes.add('field analysis', self._introspectable_pass3,
+                   requires=[callables])
+        passes.add('backcompat copies', self._remove_non_reachable_backcompat_copies)
+        passes.run()
 
     def _parameter_warning(self, parent, param, text, position=None):
         # Suppress VFunctions and Callbacks warnings for now
@@ -37,6 +37,7 @@ from .annotationparser import (OPT_ARRAY_FIXED_SIZE, OPT_ARRAY_LENGTH, OPT_ARRAY
                                OPT_OUT_CALLEE_ALLOCATES, OPT_OUT_CALLER_ALLOCATES,
                                OPT_TRANSFER_CONTAINER, OPT_TRANSFER_FLOATING, OPT_TRANSFER_NONE)
 
+from .passmanager import PassManager
 from .utils import to_underscores_noprefix
 
 
@@ -56,28 +57,54 @@ class MainTransformer(object):
                           '* Not including .h files to be scanned\n'
                           '* Broken --identifier-prefix')
 
+        passes = PassManager(self._namespace)
+
         # Some initial namespace surgery
-        self._namespace.walk(self._pass_fixup_hidden_fields)
+        passes.add('hidden fields', self._pass_fixup_hidden_fields)
 
         # We have a rough tree which should have most of of the types
         # we know about.  Let's attempt closure; walk over all of the
         # Type() types and see if they match up with something.
-        self._namespace.walk(self._pass_type_resolution)
+        resolution = passes.add('type resolution', self._pass_type_resolution)
 
         # Read in annotations needed early
-        self._namespace.walk(self._pass_read_annotations_early)
+        early = passes.add('early annotations', self._pass_read_annotations_early)
 
         # Determine some default values for transfer etc.
         # based on the current tree.
-        self._namespace.walk(self._pass_callable_defaults)
+        defaults = passes.add('callable defaults', self._pass_callable_defaults,
+                              requires=[resolution, early])
 
         # Read in most annotations now.
-        self._namespace.walk(self._pass_read_annotations)
+        passes.add('annotations', self._pass_read_annotations,
+                   requires=[defaults])
 
         # Now that we've possibly seen more types from annotations,
-        # do another type resolution pass.
-        self._namespace.walk(self._pass_type_resolution)
+        # do another type resolution pass.  Annotations only add types
+        # to the node they are on, so this can run in the same walk.
+        passes.add('type resolution 2', self._pass_type_resolution)
+
+        passes.add_step('method pairing', self._pair_methods)
+
+        # Some annotations need to be post function pairing
+        annotations2 = passes.add('annotations 2', self._pass_read_annotations2)
+
+        # Another type resolution pass after we've parsed virtuals, etc.
+        # Invoker annotations are merged into the virtual methods of the
+        # parent class, so this has to wait for the whole namespace.
+        passes.add('type resolution 3', self._pass_type_resolution,
+                   requires=[annotations2])
 
+        passes.add('pass3', self._pass3)
+
+        passes.run()
+
+        # TODO - merge into pass3
+        self._pair_quarks_with_enums()
+
+    # Private
+
+    def _pair_methods(self):
         # Generate a reverse mapping "bar_baz" -> BarBaz
         for node in self._namespace.values():
             if isinstance(node, ast.Registered) and node.get_type is not None:
@@ -93,19 +120,6 @@ class MainTransformer(object):
             if isinstance(node, (ast.Class, ast.Interface)):
                 self._pair_class_virtuals(node)
 
-        # Some annotations need to be post function pairing
-        self._namespace.walk(self._pass_read_annotations2)
-
-        # Another type resolution pass after we've parsed virtuals, etc.
-        self._namespace.walk(self._pass_type_resolution)
-
-        self._namespace.walk(self._pass3)
-
-        # TODO - merge into pass3
-        self._pair_quarks_with_enums()
-
-    # Private
-
     def _pass_fixup_hidden_fields(self, node, chain):
         """Hide all callbacks starting with _; the typical
         usage is void (*_gtk_reserved1)(void);"""
@@ -207,6 +207,29 @@ class MessageLogger(object):
                  prefix="symbol='%s'" % (symbol.ident, ))
 
 
+class MessageRecorder(MessageLogger):
+    """
+    A MessageLogger which keeps the messages instead of printing them,
+    so that work done in a worker process can replay them to the real
+    logger, in order, with replay().
+    """
+
+    def __init__(self):
+        # Nothing else, recorders are pickled to get them out of the worker
+        self.messages = []
+
+    def log(self, log_type, text, positions=None, prefix=None, marker_pos=None, marker_line=None):
+        if type(positions) == set:
+            positions = list(positions)
+        self.messages.append((log_type, text, positions, prefix, marker_pos, marker_line))
+        if log_type == FATAL:
+            raise SystemExit(text)
+
+    def replay(self, logger):
+        for message in self.messages:
+            logger.log(*message)
+
+
 def log_node(log_type, node, text, context=None, positions=None):
     ml = MessageLogger.get()
     ml.log_node(log_type, node, text, context=context, positions=positions)
@@ -0,0 +1,148 @@
+# -*- Mode: Python -*-
+#
+# This library is free software; you can redistribute it and/or
+# modify it under the terms of the GNU Lesser General Public
+# License as published by the Free Software Foundation; either
+# version 2 of the License, or (at your option) any later version.
+#
+# This library is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+# Lesser General Public License for more details.
+#
+# You should have received a copy of the GNU Lesser General Public
+# License along with this library; if not, write to the
+# Free Software Foundation, Inc., 59 Temple Place - Suite 330,
+# Boston, MA 02111-1307, USA.
+#
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import time
+
+from . import utils
+
+
+class Pass(object):
+    """A callback run on every node of a namespace, with the same
+signature and return value as the callbacks of ast.Namespace.walk()."""
+
+    def __init__(self, name, callback, requires):
+        self.name = name
+        self.callback = callback
+        self.requires = requires
+        self.elapsed = 0.0
+
+
+class Step(object):
+    """A function run once between passes, e.g. to rearrange the
+namespace in ways that can't be done while walking it."""
+
+    def __init__(self, name, function):
+        self.name = name
+        self.function = function
+        self.elapsed = 0.0
+
+
+class PassManager(object):
+    """Runs a sequence of passes over a namespace.
+
+Passes are run in the order they were added.  A pass which reads
+state that other passes set on *other* nodes lists those passes in
+its requires argument; it is then only started once they have been
+run over the whole namespace.  All other passes are fused into a
+single traversal of the tree, running one after the other on each
+node.  A pass returning False stops only that pass from descending
+into the children of the node."""
+
+    def __init__(self, namespace):
+        self._namespace = namespace
+        self._actions = []
+
+    def add(self, name, callback, requires=()):
+        for required in requires:
+            assert required in self._actions, required
+        action = Pass(name, callback, requires)
+        self._actions.append(action)
+        return action
+
+    def add_step(self, name, function):
+        action = Step(name, function)
+        self._actions.append(action)
+        return action
+
+    def run(self):
+        timing = utils.have_debug_flag('timing')
+        for group in self._schedule():
+            if isinstance(group, Step):
+                start = time.time()
+                group.function()
+                group.elapsed += time.time() - start
+            elif timing:
+                self._walk([self._timed(p) for p in group])
+            else:
+                self._walk([p.callback for p in group])
+
+        if timing:
+            for action in self._actions:
+                utils.debug_elapsed(action.name, action.elapsed)
+
+    # Private
+
+    def _schedule(self):
+        group = []
+        for action in self._actions:
+            if isinstance(action, Step):
+                if group:
+                    yield group
+                    group = []
+                yield action
+                continue
+            if any(required in group for required in action.requires):
+                yield group
+                group = []
+            group.append(action)
+        if group:
+            yield group
+
+    def _timed(self, action):
+        callback = action.callback
+
+        def timed_callback(node, chain):
+            start = time.time()
+            try:
+                return callback(node, chain)
+            finally:
+                action.elapsed += time.time() - start
+        return timed_callback
+
+    def _walk(self, callbacks):
+        if len(callbacks) == 1:
+            self._namespace.walk(callbacks[0])
+            return
+
+        # The walk is depth first, so a pass which stopped descending at
+        # some depth resumes with the next node at that depth or above.
+        stopped_at = [None] * len(callbacks)
+
+        def visit(node, chain):
+            depth = len(chain)
+            descend = False
+            for i, callback in enumerate(callbacks):
+                stopped = stopped_at[i]
+                if stopped is not None:
+                    if depth > stopped:
+                        continue
+                    stopped_at[i] = None
+                res = callback(node, chain)
+                assert res in (True, False), \
+                    "Walk function must return boolean, not %r" % (res, )
+                if res:
+                    descend = True
+                else:
+                    stopped_at[i] = depth
+            return descend
+
+        self._namespace.walk(visit)
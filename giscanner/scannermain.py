@@ -26,6 +26,7 @@ from __future__ import print_function
 from __future__ import unicode_literals
 
 import errno
+import hashlib
 import optparse
 import os
 import shutil
@@ -211,6 +212,33 @@ match the namespace prefix.""")
     parser.add_option("", "--filelist",
                       action="store", dest="filelist", default=[],
                       help="file containing headers and sources to be scanned")
+    parser.add_option("", "--dump-shards",
+                      action="store", dest="dump_shards", type="int", default=1,
+                      help="number of threads used by the introspection binary "
+                           "to dump properties and signals")
+    parser.add_option("", "--jobs",
+                      action="store", dest="jobs", type="int", default=1,
+                      help="number of processes used to parse comment "
+                           "blocks, and headers with --parallel-headers, "
+                           "0 for one per CPU")
+    parser.add_option("", "--parallel-headers",
+                      action="store_true", dest="parallel_headers", default=False,
+                      help="preprocess and parse groups of headers as separate "
+                           "translation units, one per job; each header has "
+                           "to include the headers it depends on")
+    parser.add_option("", "--combined-macro-scan",
+                      action="store_true", dest="combined_macro_scan", default=False,
+                      help="collect the #define constants of the headers while "
+                           "parsing their declarations, instead of scanning "
+                           "the headers again")
+    parser.add_option("", "--dump-cache-dir",
+                      action="store", dest="dump_cache_dir", default=None,
+                      help="directory in which built introspection binaries "
+                           "are cached and reused across runs")
+    parser.add_option("", "--source-cache-dir",
+                      action="store", dest="source_cache_dir", default=None,
+                      help="directory in which parsed header declarations "
+                           "are cached and reused across runs")
 
     group = get_preprocessor_option_group(parser)
     parser.add_option_group(group)
@@ -230,6 +258,9 @@ match the namespace prefix.""")
     parser.add_option('', "--reparse-validate",
                       action="store_true", dest="reparse_validate_gir", default=False,
                       help=optparse.SUPPRESS_HELP)
+    parser.add_option('', "--reparse-validate-structure",
+                      action="store_true", dest="reparse_validate_structure", default=False,
+                      help=optparse.SUPPRESS_HELP)
     parser.add_option("", "--typelib-xml",
                       action="store_true", dest="typelib_xml",
                       help=optparse.SUPPRESS_HELP)
@@ -256,12 +287,11 @@ def _error(msg):
     raise SystemExit('ERROR: %s' % (msg, ))
 
 
-def passthrough_gir(path, f):
+def passthrough_gir(path, f, digest=None):
     parser = GIRParser()
     parser.parse(path)
 
-    writer = GIRWriter(parser.get_namespace())
-    f.write(writer.get_encoded_xml())
+    GIRWriter(parser.get_namespace(), output=f, digest=digest)
 
 
 def test_codegen(optstring,
@@ -381,7 +411,8 @@ def create_transformer(namespace, options):
                               identifier_filter_cmd=identifier_filter_cmd,
                               symbol_filter_cmd=symbol_filter_cmd)
     transformer.set_include_paths(options.include_paths)
-    if options.passthrough_gir or options.reparse_validate_gir:
+    if (options.passthrough_gir or options.reparse_validate_gir
+            or options.reparse_validate_structure):
         transformer.disable_cache()
         transformer.set_passthrough_mode()
 
@@ -402,7 +433,7 @@ def create_transformer(namespace, options):
 def create_binary(transformer, options, args):
     # Transform the C AST nodes into higher level
     # GLib/GObject nodes
-    gdump_parser = GDumpParser(transformer)
+    gdump_parser = GDumpParser(transformer, dump_shards=options.dump_shards)
 
     # Do enough parsing that we have the get_type() functions to reference
     # when creating the introspection binary
@@ -435,20 +466,25 @@ def create_source_scanner(options, args):
     # Run the preprocessor, tokenize and construct simple
     # objects representing the raw C symbols
     ss = SourceScanner()
+    ss.set_cache_dir(getattr(options, 'source_cache_dir', None))
+    ss.set_combined_macro_scan(getattr(options, 'combined_macro_scan', False))
+    ss.set_parallel_headers(getattr(options, 'parallel_headers', False))
     ss.set_cpp_options(options.cpp_includes,
                        options.cpp_defines,
                        options.cpp_undefines,
                        cflags=options.cflags)
-    ss.parse_files(filenames)
+    ss.parse_files(filenames, getattr(options, 'jobs', 1))
     ss.parse_macros(filenames)
     return ss
 
 
-def write_output(data, options):
-    """Write encoded XML 'data' to the filename specified in 'options'."""
+def write_output(writer_class, namespace, options):
+    """Write 'namespace' using 'writer_class' to the filename specified in
+'options'.  The output is written as it is generated rather than built up
+in memory first."""
     if options.output == "-":
-        output = sys.stdout
-    elif options.reparse_validate_gir:
+        output = getattr(sys.stdout, 'buffer', sys.stdout)
+    elif options.reparse_validate_gir or options.reparse_validate_structure:
         main_f, main_f_name = tempfile.mkstemp(suffix='.gir')
 
         if (os.path.isfile(options.output)):
@@ -457,16 +493,30 @@ def write_output(data, options):
             os.chmod(main_f_name,
                      stat.S_IWUSR | stat.S_IRUSR | stat.S_IRGRP | stat.S_IROTH)
 
-        with os.fdopen(main_f, 'wb') as main_f:
-            main_f.write(data)
-
-        temp_f, temp_f_name = tempfile.mkstemp(suffix='.gir')
-        with os.fdopen(temp_f, 'wb') as temp_f:
-            passthrough_gir(main_f_name, temp_f)
-        if not utils.files_are_identical(main_f_name, temp_f_name):
-            _error("Failed to re-parse gir file; scanned='%s' passthrough='%s'" % (
-                main_f_name, temp_f_name))
-        os.unlink(temp_f_name)
+        if options.reparse_validate_structure:
+            # Only compare the digests of what both writers emit, instead
+            # of writing out the passthrough copy and comparing the files.
+            main_digest = hashlib.sha1()
+            with os.fdopen(main_f, 'wb') as main_f:
+                writer_class(namespace, output=main_f, digest=main_digest)
+
+            passthrough_digest = hashlib.sha1()
+            with open(os.devnull, 'wb') as null_f:
+                passthrough_gir(main_f_name, null_f, passthrough_digest)
+            if main_digest.digest() != passthrough_digest.digest():
+                _error("Failed to re-parse gir file; structure of scanned='%s' "
+                       "differs after passthrough" % (main_f_name, ))
+        else:
+            with os.fdopen(main_f, 'wb') as main_f:
+                writer_class(namespace, output=main_f)
+
+            temp_f, temp_f_name = tempfile.mkstemp(suffix='.gir')
+            with os.fdopen(temp_f, 'wb') as temp_f:
+                passthrough_gir(main_f_name, temp_f)
+            if not utils.files_are_identical(main_f_name, temp_f_name):
+                _error("Failed to re-parse gir file; scanned='%s' passthrough='%s'" % (
+                    main_f_name, temp_f_name))
+            os.unlink(temp_f_name)
         try:
             shutil.move(main_f_name, options.output)
         except OSError as e:
@@ -475,13 +525,37 @@ def write_output(data, options):
             raise
         return 0
     else:
+        # Stream into a temporary file next to the output and only move it
+        # over the output once it is complete, so that a failure doesn't
+        # leave a truncated file behind which looks up to date.
         try:
-            output = open(options.output, 'wb')
-        except IOError as e:
+            output_f, output_f_name = tempfile.mkstemp(
+                suffix='.gir', prefix='.tmp-',
+                dir=os.path.dirname(os.path.abspath(options.output)))
+        except (IOError, OSError) as e:
             _error("opening output for writing: %s" % (e.strerror, ))
 
+        if os.path.isfile(options.output):
+            shutil.copymode(options.output, output_f_name)
+        else:
+            os.chmod(output_f_name,
+                     stat.S_IWUSR | stat.S_IRUSR | stat.S_IRGRP | stat.S_IROTH)
+
+        try:
+            with os.fdopen(output_f, 'wb') as output:
+                writer_class(namespace, output=output)
+            shutil.move(output_f_name, options.output)
+        except (IOError, OSError) as e:
+            os.unlink(output_f_name)
+            _error("while writing output: %s" % (e.strerror, ))
+        except BaseException:
+            os.unlink(output_f_name)
+            raise
+        return 0
+
     try:
-        output.write(data)
+        writer_class(namespace, output=output)
+        output.flush()
     except IOError as e:
         _error("while writing output: %s" % (e.strerror, ))
 
@@ -494,7 +568,8 @@ def scanner_main(args):
         import distutils
         distutils.log.set_threshold(distutils.log.DEBUG)
     if options.passthrough_gir:
-        passthrough_gir(options.passthrough_gir, sys.stdout)
+        passthrough_gir(options.passthrough_gir,
+                        getattr(sys.stdout, 'buffer', sys.stdout))
     if options.test_codegen:
         return test_codegen(options.test_codegen,
                             options.function_decoration,
@@ -538,10 +613,10 @@ def scanner_main(args):
     ss = create_source_scanner(options, args)
 
     cbp = GtkDocCommentBlockParser()
-    blocks = cbp.parse_comment_blocks(ss.get_comments())
+    blocks = cbp.parse_comment_blocks(ss.get_comments(), options.jobs)
 
     # Transform the C symbols into AST nodes
-    transformer.parse(ss.get_symbols())
+    transformer.parse(ss.get_symbols(transformer.PARSED_SYMBOL_TYPES))
 
     if not options.header_only:
         shlibs = create_binary(transformer, options, args)
@@ -575,9 +650,6 @@ def scanner_main(args):
 
     transformer.namespace.c_includes = options.c_includes
     transformer.namespace.exported_packages = exported_packages
-    writer = Writer(transformer.namespace)
-    data = writer.get_encoded_xml()
-
-    write_output(data, options)
+    write_output(Writer, transformer.namespace, options)
 
     return 0
@@ -1777,6 +1777,40 @@ gi_source_scanner_parse_macros (GISourceScanner *scanner, GList *filenames)
   g_unlink (tmp_name);
 }
 
+/* Parses the #define lines kept by the lexer while parsing preprocessor
+ * output, see gi_source_scanner_set_collect_macros().  They are written
+ * the same way gi_source_scanner_parse_macros() writes them.
+ */
+static void
+parse_collected_macros (GISourceScanner *scanner)
+{
+  GError *error = NULL;
+  char *tmp_name = NULL;
+  FILE *fmacros;
+  int fd;
+
+  fd = g_file_open_tmp ("gen-introspect-XXXXXX.h", &tmp_name, &error);
+  if (fd == -1)
+    {
+      g_warning ("Cannot parse macros: %s", error->message);
+      g_error_free (error);
+      return;
+    }
+
+  fmacros = fdopen (fd, "w+");
+  fwrite (scanner->macros->str, 1, scanner->macros->len, fmacros);
+  g_string_truncate (scanner->macros, 0);
+  rewind (fmacros);
+
+  scanner->macro_scan = TRUE;
+  gi_source_scanner_parse_file (scanner, fmacros);
+  scanner->macro_scan = FALSE;
+
+  fclose (fmacros);
+  g_unlink (tmp_name);
+  g_free (tmp_name);
+}
+
 gboolean
 gi_source_scanner_parse_file (GISourceScanner *scanner, FILE *file)
 {
@@ -1787,6 +1821,9 @@ gi_source_scanner_parse_file (GISourceScanner *scanner, FILE *file)
   yyparse (scanner);
   yyin = NULL;
 
+  if (scanner->macros && scanner->macros->len > 0 && !scanner->macro_scan)
+    parse_collected_macros (scanner);
+
   return TRUE;
 }
 
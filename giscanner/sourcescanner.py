@@ -24,12 +24,26 @@ from __future__ import division
 from __future__ import print_function
 from __future__ import unicode_literals
 
+import errno
+import hashlib
 import os
+import re
+import shutil
+import sys
 import tempfile
+import time
+
+try:
+    import cPickle as pickle
+except ImportError:
+    import pickle
+
+import giscanner
 
 from .libtoolimporter import LibtoolImporter
 from .message import Position
 from .ccompiler import CCompiler
+from . import utils
 
 with LibtoolImporter(None, None):
     if 'UNINSTALLED_INTROSPECTION_SRCDIR' in os.environ:
@@ -226,12 +240,190 @@ class SourceSymbol(object):
                         self._symbol.line)
 
 
+class CachedSourceType(object):
+    """Stand-in for a C SourceType which was loaded from the SourceCache."""
+    __slots__ = ['type', 'storage_class_specifier', 'type_qualifier',
+                 'function_specifier', 'name', 'base_type', 'child_list',
+                 'is_bitfield']
+
+    def __init__(self, data):
+        (self.type, self.storage_class_specifier, self.type_qualifier,
+         self.function_specifier, self.name, base_type, child_list,
+         self.is_bitfield) = data
+        self.base_type = CachedSourceType(base_type) if base_type else None
+        self.child_list = [CachedSourceSymbol(c) if c else None for c in child_list]
+
+    @staticmethod
+    def serialize(stype):
+        if stype is None:
+            return None
+        return (stype.type, stype.storage_class_specifier, stype.type_qualifier,
+                stype.function_specifier, stype.name,
+                CachedSourceType.serialize(stype.base_type),
+                [CachedSourceSymbol.serialize(c) if c is not None else None
+                 for c in stype.child_list],
+                stype.is_bitfield)
+
+
+class CachedSourceSymbol(object):
+    """Stand-in for a C SourceSymbol which was loaded from the SourceCache."""
+    __slots__ = ['type', 'ident', 'base_type', 'const_int', 'const_double',
+                 'const_string', 'const_boolean', 'source_filename', 'line',
+                 'private']
+
+    def __init__(self, data):
+        (self.type, self.ident, base_type, self.const_int, self.const_double,
+         self.const_string, self.const_boolean, self.source_filename,
+         self.line, self.private) = data
+        self.base_type = CachedSourceType(base_type) if base_type else None
+
+    @staticmethod
+    def serialize(symbol):
+        return (symbol.type, symbol.ident,
+                CachedSourceType.serialize(symbol.base_type),
+                symbol.const_int, symbol.const_double, symbol.const_string,
+                symbol.const_boolean, symbol.source_filename, symbol.line,
+                symbol.private)
+
+
+class SourceCache(object):
+    """Persistent cache of the declarations parsed from preprocessed
+headers.
+
+The preprocessor output of a translation unit is split where each of its
+headers is first entered, and the pieces are cached separately.  An entry
+is keyed on the text of its piece, the preprocessor options, and the
+typedefs and enumeration constants of earlier pieces which it refers to,
+so editing a header only invalidates the pieces whose text or use of
+earlier declarations changed.  Entries which haven't been used for
+_MAX_AGE seconds are removed whenever new ones are stored."""
+
+    # Bump when the format of the cached entries changes
+    _VERSION = 2
+
+    _MAX_AGE = 30 * 24 * 60 * 60
+
+    _LINE_MARKER_RE = re.compile(br'^#(?:line)?\s*\d+\s+"((?:[^"\\]|\\.)*)"',
+                                 re.MULTILINE)
+    _IDENTIFIER_RE = re.compile(br'[A-Za-z_][A-Za-z0-9_]*')
+
+    def __init__(self, directory):
+        self._directory = directory
+
+    def split(self, preprocessed, headers):
+        """Splits the preprocessor output preprocessed before the first
+line marker of each of headers.  Returns a list of (piece, filenames)
+pairs, filenames being the files the line markers of the piece name."""
+        pieces = []
+        start = 0
+        filenames = set()
+        seen = set()
+        for match in self._LINE_MARKER_RE.finditer(preprocessed):
+            filename = match.group(1).replace(b'\\\\', b'\\')
+            filename = filename.decode('utf-8', 'replace')
+            if filename in headers and filename not in seen:
+                seen.add(filename)
+                if match.start() > start:
+                    pieces.append((preprocessed[start:match.start()], filenames))
+                    start = match.start()
+                    filenames = set()
+            filenames.add(filename)
+        pieces.append((preprocessed[start:], filenames))
+        return pieces
+
+    def get_key(self, piece, cpp_options, filenames, typedefs, constants):
+        """Hashes piece with the preprocessor options, the files of which
+the declarations are kept and the typedefs and constants it refers to."""
+        identifiers = set(i.decode('ascii')
+                          for i in self._IDENTIFIER_RE.findall(piece))
+        values = [str(self._VERSION), giscanner.__version__, sys.version,
+                  os.environ.get('CC', ''), os.environ.get('CPPFLAGS', ''),
+                  os.environ.get('CFLAGS', '')] + cpp_options
+        values.extend(sorted(filenames))
+        values.extend(sorted(identifiers.intersection(typedefs)))
+        values.extend('%s=%d' % (name, constants[name][1])
+                      for name in sorted(identifiers.intersection(constants)))
+
+        checksum = hashlib.sha256()
+        for value in values:
+            checksum.update(value.encode('utf-8'))
+            checksum.update(b'\0')
+        checksum.update(piece)
+        return checksum.hexdigest()
+
+    def lookup(self, key):
+        filename = os.path.join(self._directory, key)
+        try:
+            with open(filename, 'rb') as f:
+                entry = pickle.load(f)
+        except (IOError, OSError, EOFError, ValueError, pickle.UnpicklingError):
+            return None
+        try:
+            # Keep it from being pruned
+            os.utime(filename, None)
+        except OSError:
+            pass
+        return entry
+
+    def _remove_filename(self, filename):
+        try:
+            os.unlink(filename)
+        except OSError:
+            # Removed by another process, permission denied
+            pass
+
+    def store(self, key, entry):
+        try:
+            utils.makedirs(self._directory, exist_ok=True)
+            tmp_fd, tmp_filename = tempfile.mkstemp(prefix='.tmp-', dir=self._directory)
+        except (IOError, OSError) as e:
+            # Permission denied, no space left on device
+            if e.errno not in (errno.EACCES, errno.ENOSPC):
+                raise
+            return
+
+        try:
+            with os.fdopen(tmp_fd, 'wb') as tmp_file:
+                pickle.dump(entry, tmp_file, pickle.HIGHEST_PROTOCOL)
+            shutil.move(tmp_filename, os.path.join(self._directory, key))
+        except (IOError, OSError) as e:
+            self._remove_filename(tmp_filename)
+            # Permission denied, no space left on device
+            if e.errno not in (errno.EACCES, errno.ENOSPC):
+                raise
+
+    def prune(self):
+        """Removes the entries which haven't been used for _MAX_AGE seconds."""
+        try:
+            filenames = os.listdir(self._directory)
+        except OSError:
+            return
+        oldest = time.time() - self._MAX_AGE
+        for filename in filenames:
+            filename = os.path.join(self._directory, filename)
+            try:
+                if os.path.getmtime(filename) < oldest:
+                    os.unlink(filename)
+            except OSError:
+                # Removed by another process, permission denied
+                pass
+
+
 class SourceScanner(object):
 
     def __init__(self):
         self._scanner = CSourceScanner()
         self._filenames = []
         self._cpp_options = []
+        self._cache = None
+        # (index, items) pairs of symbols and comments loaded from the
+        # cache, to be spliced into those of the C scanner
+        self._cached_symbols = []
+        self._cached_comments = []
+        self._combined_macro_scan = False
+        self._parallel_headers = False
+        # Headers of which parse_files() collected the macros
+        self._macros_scanned = set()
 
     # Public API
 
@@ -245,7 +437,27 @@ class SourceScanner(object):
                 if opt not in self._cpp_options:
                     self._cpp_options.append(opt)
 
-    def parse_files(self, filenames):
+    def set_cache_dir(self, directory):
+        self._cache = SourceCache(directory) if directory else None
+
+    def set_combined_macro_scan(self, combined):
+        """Have parse_files() collect the #define constants of the headers
+from the preprocessor output it parses the declarations from, so that
+parse_macros() doesn't read and lex them a second time.  Only the macros
+defined with the preprocessor options in effect are found this way."""
+        self._combined_macro_scan = combined
+
+    def set_parallel_headers(self, parallel):
+        """Have parse_files() split the headers in groups, one per job,
+which are preprocessed and parsed as separate translation units in worker
+processes.  Each header should then include the headers it depends on;
+by default all headers are parsed as a single translation unit."""
+        self._parallel_headers = parallel
+
+    def parse_files(self, filenames, jobs=1):
+        """Parses the given headers and sources.  The headers are split
+in groups of about the same size, one per job, if set_parallel_headers()
+was called; otherwise they are parsed as a single translation unit."""
         for filename in filenames:
             # self._scanner expects file names to be canonicalized and symlinks to be resolved
             filename = os.path.realpath(filename)
@@ -259,20 +471,66 @@ class SourceScanner(object):
             else:
                 headers.append(filename)
 
-        self._parse(headers)
+        if self._combined_macro_scan and CCompiler().can_keep_macros():
+            self._macros_scanned.update(headers)
+
+        if self._parallel_headers:
+            groups = self._split_headers(headers, utils.get_job_count(jobs))
+        else:
+            groups = [headers]
+        if len(groups) <= 1:
+            self._parse(headers)
+            return
+
+        # Start the workers from the typedefs and enumeration constants
+        # known so far, and merge their results in the order of the headers
+        typedefs = self._scanner.get_typedefs()
+        constants = self._scanner.get_constants()
+        for entry in utils.parallel_map(_parse_header_group,
+                                        [(self._cpp_options, self._cache,
+                                          self._combined_macro_scan, group,
+                                          typedefs, constants)
+                                         for group in groups],
+                                        len(groups)):
+            self._load_cached(entry)
 
     def parse_macros(self, filenames):
-        self._scanner.set_macro_scan(True)
         # self._scanner expects file names to be canonicalized and symlinks to be resolved
-        self._scanner.parse_macros([os.path.realpath(f) for f in filenames])
+        filenames = [os.path.realpath(f) for f in filenames]
+        filenames = [f for f in filenames if f not in self._macros_scanned]
+        if not filenames:
+            return
+        self._scanner.set_macro_scan(True)
+        self._scanner.parse_macros(filenames)
         self._scanner.set_macro_scan(False)
 
-    def get_symbols(self):
-        for symbol in self._scanner.get_symbols():
-            yield SourceSymbol(self._scanner, symbol)
+    def get_symbols(self, types=None):
+        """Iterates over the symbols, or only over those with one of the
+given CSYMBOL_TYPE_* types.  Filtering is done by the C scanner, so the
+other symbols are never converted."""
+        if types is not None:
+            types = frozenset(types)
+        start = 0
+        for index, cached_symbols in self._cached_symbols + [(-1, [])]:
+            for symbol in self._scanner.get_symbols(types, start, index):
+                yield SourceSymbol(self._scanner, symbol)
+            for symbol in cached_symbols:
+                if types is None or symbol.type in types:
+                    yield SourceSymbol(self._scanner, symbol)
+            start = index
 
     def get_comments(self):
-        return self._scanner.get_comments()
+        comments = self._scanner.get_comments()
+        if not self._cached_comments:
+            return comments
+        result = []
+        start = 0
+        for index, cached_comments in self._cached_comments:
+            result.extend(comments[start:index])
+            result.extend(cached_comments)
+            start = index
+        result.extend(comments[start:])
+        return result
 
     def dump(self):
         print('-' * 30)
@@ -281,6 +539,50 @@ class SourceScanner(object):
 
     # Private
 
+    def _split_headers(self, headers, count):
+        # Contiguous groups of about the same size, as every group is
+        # preprocessed with the headers it includes
+        if count <= 1 or len(headers) <= 1:
+            return [headers] if headers else []
+        sizes = []
+        for filename in headers:
+            try:
+                sizes.append(os.path.getsize(filename))
+            except OSError:
+                sizes.append(0)
+        count = min(count, len(headers))
+        target = sum(sizes) / count
+        groups = [[]]
+        size = 0
+        for filename, filesize in zip(headers, sizes):
+            if (groups[-1] and size + filesize / 2 > target * len(groups) and
+                    len(groups) < count):
+                groups.append([])
+            groups[-1].append(filename)
+            size += filesize
+        return groups
+
+    def _get_entry(self):
+        # The symbols, comments, typedefs and constants of this scanner,
+        # in the format of a SourceCache entry
+        return {
+            'symbols': [CachedSourceSymbol.serialize(s._symbol)
+                        for s in self.get_symbols()],
+            'comments': list(self.get_comments()),
+            'typedefs': self._scanner.get_typedefs(),
+            'constants': self._scanner.get_constants(),
+        }
+
+    def _load_cached(self, entry):
+        self._cached_symbols.append((len(self._scanner.get_symbols()),
+                                     [CachedSourceSymbol(s) for s in entry['symbols']]))
+        self._cached_comments.append((len(self._scanner.get_comments()),
+                                      entry['comments']))
+        for name in entry['typedefs']:
+            self._scanner.add_typedef(name)
+        for constant in entry['constants']:
+            self._scanner.add_constant(*constant)
+
     def _parse(self, filenames):
         if not filenames:
             return
@@ -289,6 +591,7 @@ class SourceScanner(object):
         undefs = []
 
         cc = CCompiler()
+        keep_macros = self._combined_macro_scan and cc.can_keep_macros()
 
         tmp_fd_cpp, tmp_name_cpp = tempfile.mkstemp(prefix='g-ir-cpp-',
                                                     suffix='.c',
@@ -304,15 +607,85 @@ class SourceScanner(object):
 
         cc.preprocess(tmp_name_cpp,
                       tmpfile_output,
-                      self._cpp_options)
+                      self._cpp_options,
+                      keep_macros)
 
         os.unlink(tmp_name_cpp)
+
+        if self._cache is not None:
+            self._parse_cached(tmpfile_output, tmp_name_cpp, filenames,
+                               keep_macros)
+            os.unlink(tmpfile_output)
+            return
+
         fp = open(tmpfile_output, 'r')
 
+        self._scanner.set_collect_macros(keep_macros)
         self._scanner.parse_file(fp.fileno())
+        self._scanner.set_collect_macros(False)
         fp.close()
         os.unlink(tmpfile_output)
 
+    def _parse_cached(self, preprocessed, source, filenames, keep_macros):
+        # The entries include the macros when they are collected
+        cpp_options = self._cpp_options + (['-dD'] if keep_macros else [])
+        kept = set(self._filenames)
+        typedefs = set(self._scanner.get_typedefs())
+        constants = dict((c[0], c) for c in self._scanner.get_constants())
+
+        with open(preprocessed, 'rb') as fp:
+            contents = fp.read()
+        # The line markers name the temporary source, which would change
+        # the key of every piece from one run to the next
+        source = source.encode('utf-8')
+        for name in [source, source.replace(b'\\', b'\\\\')]:
+            contents = contents.replace(b'"' + name + b'"', b'"g-ir-cpp.c"')
+
+        stored = False
+        for piece, piece_filenames in self._cache.split(contents, set(filenames)):
+            key = self._cache.get_key(piece, cpp_options, kept & piece_filenames,
+                                      typedefs, constants)
+            entry = self._cache.lookup(key)
+            if entry is not None:
+                self._load_cached(entry)
+            else:
+                entry = self._parse_piece(piece, keep_macros, typedefs, constants)
+                self._cache.store(key, entry)
+                stored = True
+            typedefs.update(entry['typedefs'])
+            constants.update((c[0], c) for c in entry['constants'])
+
+        if stored:
+            self._cache.prune()
+
+    def _parse_piece(self, piece, keep_macros, typedefs, constants):
+        # Parses a piece of preprocessor output, returning what it added
+        # in the format of a SourceCache entry
+        n_symbols = len(self._scanner.get_symbols())
+        n_comments = len(self._scanner.get_comments())
+
+        tmp_fd, tmp_name = tempfile.mkstemp(prefix='g-ir-cpp-', suffix='.i',
+                                            dir=os.getcwd())
+        with os.fdopen(tmp_fd, 'wb') as fp:
+            fp.write(piece)
+
+        fp = open(tmp_name, 'r')
+        self._scanner.set_collect_macros(keep_macros)
+        self._scanner.parse_file(fp.fileno())
+        self._scanner.set_collect_macros(False)
+        fp.close()
+        os.unlink(tmp_name)
+
+        return {
+            'symbols': [CachedSourceSymbol.serialize(s)
+                        for s in self._scanner.get_symbols(None, n_symbols)],
+            'comments': list(self._scanner.get_comments(n_comments)),
+            'typedefs': [name for name in self._scanner.get_typedefs()
+                         if name not in typedefs],
+            'constants': [c for c in self._scanner.get_constants()
+                          if constants.get(c[0]) != c],
+        }
+
     def _write_preprocess_src(self, fp, defines, undefs, filenames):
         # Write to the temp file for feeding into the preprocessor
         for define in defines:
@@ -323,3 +696,21 @@ class SourceScanner(object):
             fp.write(('#undef %s\n' % (undef, )).encode())
         for filename in filenames:
             fp.write(('#include <%s>\n' % (filename, )).encode())
+
+
+def _parse_header_group(args):
+    # Called by utils.parallel_map(), usually in a worker process
+    cpp_options, cache, combined_macro_scan, filenames, typedefs, constants = args
+    ss = SourceScanner()
+    ss._cpp_options = cpp_options
+    ss._cache = cache
+    ss._combined_macro_scan = combined_macro_scan
+    for filename in filenames:
+        ss._scanner.append_filename(filename)
+        ss._filenames.append(filename)
+    for name in typedefs:
+        ss._scanner.add_typedef(name)
+    for constant in constants:
+        ss._scanner.add_constant(*constant)
+    ss._parse(filenames)
+    return ss._get_entry()
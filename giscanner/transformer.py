@@ -46,9 +46,56 @@ class TransformerException(Exception):
     pass
 
 
+class _PrefixIndex(object):
+    """Maps the prefixes of a set of namespaces back to the namespaces,
+so that finding the namespaces a C name may belong to only costs a
+dictionary lookup per distinct prefix length."""
+
+    def __init__(self, namespaces, get_prefixes):
+        self.unprefixed = []  # Namespaces with no prefix, last resort
+        self._prefixes = {}  # prefix -> [(namespace position, prefix position, namespace)]
+        self._matches = {}  # name -> [(namespace, stripped name, prefix length)]
+        for order, ns in enumerate(namespaces):
+            prefixes = get_prefixes(ns)
+            if not prefixes:
+                self.unprefixed.append(ns)
+                continue
+            for position, prefix in enumerate(prefixes):
+                self._prefixes.setdefault(prefix, []).append((order, position, ns))
+        self._lengths = sorted(set(len(prefix) for prefix in self._prefixes))
+
+    def lookup(self, name):
+        """Return the namespaces with a prefix of name, in namespace
+order, along with the stripped name and the length of the prefix.  For
+each namespace, the first of its prefixes which matches is used."""
+        matches = self._matches.get(name)
+        if matches is not None:
+            return matches
+
+        best = {}
+        for length in self._lengths:
+            if length > len(name):
+                break
+            for order, position, ns in self._prefixes.get(name[:length], ()):
+                if order not in best or position < best[order][0]:
+                    best[order] = (position, ns, length)
+        matches = [(ns, name[length:], length)
+                   for order, (position, ns, length) in sorted(best.items())]
+        self._matches[name] = matches
+        return matches
+
+
 class Transformer(object):
     namespace = property(lambda self: self._namespace)
 
+    # The types of the symbols parse() creates nodes for, so the others
+    # (variable declarations) can be left out when getting them from the
+    # SourceScanner
+    PARSED_SYMBOL_TYPES = (CSYMBOL_TYPE_FUNCTION, CSYMBOL_TYPE_TYPEDEF,
+                           CSYMBOL_TYPE_STRUCT, CSYMBOL_TYPE_ENUM,
+                           CSYMBOL_TYPE_MEMBER, CSYMBOL_TYPE_UNION,
+                           CSYMBOL_TYPE_CONST)
+
     def __init__(self, namespace, accept_unprefixed=False,
                  identifier_filter_cmd=None, symbol_filter_cmd=None):
         self._cachestore = CacheStore()
@@ -57,6 +104,7 @@ class Transformer(object):
         self._pkg_config_packages = set()
         self._typedefs_ns = {}
         self._parsed_includes = {}  # <string namespace -> Namespace>
+        self._prefix_indexes = {}  # <string kind -> _PrefixIndex>
         self._includepaths = []
         self._passthrough_mode = False
         self._identifier_filter_cmd = identifier_filter_cmd
@@ -210,32 +258,32 @@ None."""
         if extra_include_dirs is not None:
             self.set_include_paths(extra_include_dirs)
         self.set_passthrough_mode()
-        parser = self._parse_include(filename)
-        self._namespace = parser.get_namespace()
+        self._namespace = self._parse_include(filename)
         del self._parsed_includes[self._namespace.name]
+        self._prefix_indexes.clear()
         return self
 
     def _parse_include(self, filename, uninstalled=False):
-        parser = None
-        if self._cachestore is not None:
-            parser = self._cachestore.load(filename)
-        if parser is None:
+        namespace = None
+        # The cache only holds the types, passthrough mode needs everything
+        if self._cachestore is not None and not self._passthrough_mode:
+            namespace = self._cachestore.load_namespace(filename)
+        if namespace is None:
             parser = GIRParser(types_only=not self._passthrough_mode)
             parser.parse(filename)
-            if self._cachestore is not None:
-                self._cachestore.store(filename, parser)
+            namespace = parser.get_namespace()
 
-        for include in parser.get_namespace().includes:
+        for include in namespace.includes:
             if include.name not in self._parsed_includes:
                 dep_filename = self._find_include(include)
                 self._parse_include(dep_filename)
 
         if not uninstalled:
-            for pkg in parser.get_namespace().exported_packages:
+            for pkg in namespace.exported_packages:
                 self._pkg_config_packages.add(pkg)
-        namespace = parser.get_namespace()
         self._parsed_includes[namespace.name] = namespace
-        return parser
+        self._prefix_indexes.clear()
+        return namespace
 
     def _iter_namespaces(self):
         """Return an iterator over all included namespaces; the
@@ -254,6 +302,25 @@ currently-scanned namespace is first."""
         else:
             return 0, val[2]
 
+    def _get_prefix_index(self, kind):
+        index = self._prefix_indexes.get(kind)
+        if index is not None:
+            return index
+
+        def symbol_prefixes(prefixes):
+            return [prefix if prefix.endswith('_') else prefix + '_'
+                    for prefix in prefixes]
+
+        if kind == 'identifier':
+            get_prefixes = lambda ns: ns.identifier_prefixes
+        elif kind == 'ucase-symbol':
+            get_prefixes = lambda ns: symbol_prefixes(ns._ucase_symbol_prefixes)
+        else:
+            get_prefixes = lambda ns: symbol_prefixes(ns.symbol_prefixes)
+        index = _PrefixIndex(self._iter_namespaces(), get_prefixes)
+        self._prefix_indexes[kind] = index
+        return index
+
     def _split_c_string_for_namespace_matches(self, name, is_identifier=False):
         if not is_identifier and self._symbol_filter_cmd:
             proc = subprocess.Popen(self._symbol_filter_cmd,
@@ -268,24 +335,15 @@ currently-scanned namespace is first."""
             name = proc_name.decode('ascii')
             name = name.strip()
 
-        matches = []  # Namespaces which might contain this name
-        unprefixed_namespaces = []  # Namespaces with no prefix, last resort
-        for ns in self._iter_namespaces():
-            if is_identifier:
-                prefixes = ns.identifier_prefixes
-            elif name[0].isupper():
-                prefixes = ns._ucase_symbol_prefixes
-            else:
-                prefixes = ns.symbol_prefixes
-            if prefixes:
-                for prefix in prefixes:
-                    if (not is_identifier) and (not prefix.endswith('_')):
-                        prefix = prefix + '_'
-                    if name.startswith(prefix):
-                        matches.append((ns, name[len(prefix):], len(prefix)))
-                        break
-            else:
-                unprefixed_namespaces.append(ns)
+        if is_identifier:
+            index = self._get_prefix_index('identifier')
+        elif name[0].isupper():
+            index = self._get_prefix_index('ucase-symbol')
+        else:
+            index = self._get_prefix_index('symbol')
+        # Namespaces which might contain this name
+        matches = list(index.lookup(name))
+        unprefixed_namespaces = index.unprefixed
         if matches:
             matches.sort(key=self._sort_matches)
             return list(map(lambda x: (x[0], x[1]), matches))
@@ -967,7 +1025,7 @@ Note that type resolution may not succeed."""
     def _resolve_type_from_gtype_name(self, typeval):
         assert typeval.gtype_name is not None
         for ns in self._iter_namespaces():
-            node = ns.type_names.get(typeval.gtype_name, None)
+            node = ns.get_by_gtype_name(typeval.gtype_name)
             if node is not None:
                 typeval.target_giname = '%s.%s' % (ns.name, node.name)
                 return True
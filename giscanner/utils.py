@@ -23,10 +23,12 @@ from __future__ import print_function
 from __future__ import unicode_literals
 
 import errno
+import multiprocessing
 import re
 import os
 import subprocess
 import platform
+import sys
 import shutil
 import time
 
@@ -41,6 +43,7 @@ Well-known flags:
  * exception: Drop into debugger on fatalexception
  * warning: Drop into debugger on warning
  * posttrans: Drop into debugger just before introspectable pass
+ * timing: Print the time spent in expensive phases to stderr
 """
     global _debugflags
     if _debugflags is None:
@@ -50,6 +53,19 @@ Well-known flags:
     return flag in _debugflags
 
 
+def debug_timing(phase, start):
+    """Print the time elapsed since start (as returned by time.time())
+for the named phase, if the 'timing' debug flag is set."""
+    debug_elapsed(phase, time.time() - start)
+
+
+def debug_elapsed(phase, elapsed):
+    """Like debug_timing(), but for a duration in seconds."""
+    if have_debug_flag('timing'):
+        sys.stderr.write("g-ir-scanner: timing: %s: %.3fs\n" % (
+            phase, elapsed))
+
+
 def break_on_debug_flag(flag):
     if have_debug_flag(flag):
         import pdb
@@ -320,3 +336,49 @@ def rmtree(*args, **kwargs):
             continue
         else:
             return
+
+
+def get_job_count(jobs):
+    '''
+    Returns the number of worker processes to use for a --jobs value,
+    where 0 means one per CPU.
+    '''
+
+    if jobs <= 0:
+        try:
+            return multiprocessing.cpu_count()
+        except NotImplementedError:
+            return 1
+    return jobs
+
+
+def parallel_map(function, items, jobs):
+    '''
+    Like map(), but spreads the calls over a pool of `jobs` worker processes
+    and returns the results as a list, in the order of `items`.
+
+    The workers are forked, so `function` sees the state of the calling
+    process at the time of the call; it must be a module level function, and
+    its arguments and results must be picklable.  Without fork() (on Windows)
+    or with a single job the calls are simply made in this process.
+    '''
+
+    items = list(items)
+    jobs = min(get_job_count(jobs), len(items))
+    if jobs <= 1 or not hasattr(os, 'fork'):
+        return [function(item) for item in items]
+
+    if hasattr(multiprocessing, 'get_context'):
+        context = multiprocessing.get_context('fork')
+    else:
+        context = multiprocessing
+
+    # A few chunks per worker keeps them busy when items differ in cost,
+    # without paying the pickling overhead per item.
+    chunksize = max(1, len(items) // (jobs * 4))
+    pool = context.Pool(jobs)
+    try:
+        return pool.map(function, items, chunksize)
+    finally:
+        pool.close()
+        pool.join()
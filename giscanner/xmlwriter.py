@@ -24,6 +24,7 @@ from __future__ import division
 from __future__ import print_function
 from __future__ import unicode_literals
 
+import codecs
 import sys
 
 from contextlib import contextmanager
@@ -96,12 +97,21 @@ def build_xml_tag(tag_name, attributes=None, data=None, self_indent=0,
 
 class XMLWriter(object):
 
-    def __init__(self):
-        # Build up the XML buffer as unicode strings. When writing to disk,
-        # we can assume the lack of a Byte Order Mark (BOM) and lack
-        # of an "encoding" xml property means utf-8.
+    def __init__(self, output=None, digest=None):
+        # Build up the XML buffer as unicode strings, or if output (a
+        # binary file object) is given, write it out as utf-8 as we go.
+        # When writing to disk, we can assume the lack of a Byte Order
+        # Mark (BOM) and lack of an "encoding" xml property means utf-8.
         # See: http://www.opentag.com/xfaq_enc.htm#enc_default
-        self._data = StringIO()
+        if output is None:
+            self._data = StringIO()
+        else:
+            self._data = codecs.getwriter('utf-8')(output)
+        self._streaming = output is not None
+        # If given, a hashlib object which is fed the elements, attributes
+        # and text written, but none of the whitespace or comments; two
+        # documents with the same structure end up with the same digest.
+        self._digest = digest
         self._data.write('<?xml version="1.0"?>\n')
         self._tag_stack = []
         self._indent = 0
@@ -120,6 +130,17 @@ class XMLWriter(object):
     def _close_tag(self, tag_name):
         self.write_line('</%s>' % (tag_name, ))
 
+    def _update_digest(self, tag_name, attributes, data=None):
+        parts = ['<', tag_name]
+        for attr, value in attributes or []:
+            if value is not None:
+                parts.extend((attr, value))
+        if data is not None:
+            if isinstance(data, bytes):
+                data = data.decode('UTF-8')
+            parts.extend(('', data))
+        self._digest.update(('\0'.join(parts) + '\1').encode('utf-8'))
+
     # Public API
 
     def enable_whitespace(self):
@@ -132,10 +153,12 @@ class XMLWriter(object):
 
     def get_xml(self):
         """Returns a unicode string containing the XML."""
+        assert not self._streaming
         return self._data.getvalue()
 
     def get_encoded_xml(self):
         """Returns a utf-8 encoded bytes object containing the XML."""
+        assert not self._streaming
         return self._data.getvalue().encode('utf-8')
 
     def write_line(self, line='', indent=True, do_escape=False):
@@ -155,12 +178,17 @@ class XMLWriter(object):
         self.write_line('<!-- %s -->' % (text, ))
 
     def write_tag(self, tag_name, attributes, data=None):
+        if self._digest is not None:
+            self._update_digest(tag_name, attributes, data)
+            self._digest.update(b'>\1')
         self.write_line(build_xml_tag(tag_name, attributes, data,
                                       self._indent, self._indent_char))
 
     def push_tag(self, tag_name, attributes=None):
         if attributes is None:
             attributes = []
+        if self._digest is not None:
+            self._update_digest(tag_name, attributes)
         self._open_tag(tag_name, attributes)
         self._tag_stack.append(tag_name)
         self._indent += self._indent_unit
@@ -168,6 +196,8 @@ class XMLWriter(object):
     def pop_tag(self):
         self._indent -= self._indent_unit
         tag_name = self._tag_stack.pop()
+        if self._digest is not None:
+            self._digest.update(b'>\1')
         self._close_tag(tag_name)
         return tag_name
 
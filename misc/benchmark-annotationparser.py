@@ -0,0 +1,72 @@
+#!/usr/bin/env python3
+# -*- Mode: Python -*-
+# Time GtkDocCommentBlockParser on the comment blocks of the annotation
+# parser tests, with and without the C comment line tokenizer.
+# e.g.:
+#   ./benchmark-annotationparser.py [iterations]
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import os
+import sys
+import timeit
+import xml.etree.ElementTree as etree
+
+path = os.path.abspath(os.path.join(os.path.dirname(__file__), '..'))
+sys.path.insert(0, path)
+for k in ['UNINSTALLED_INTROSPECTION_SRCDIR',
+          'UNINSTALLED_INTROSPECTION_BUILDDIR']:
+    if k not in os.environ:
+        os.environ[k] = path
+
+from giscanner import annotationparser
+from giscanner.annotationparser import GtkDocCommentBlockParser
+from giscanner.message import MessageLogger
+
+NS = '{http://schemas.gnome.org/gobject-introspection/2013/test}'
+
+
+def collect_comments(testsdir):
+    comments = []
+    for dirpath, dirnames, filenames in os.walk(testsdir):
+        for filename in sorted(filenames):
+            if not filename.endswith('.xml'):
+                continue
+            tree = etree.parse(os.path.join(dirpath, filename))
+            for element in tree.iter(NS + 'input'):
+                if element.text:
+                    comments.append(element.text)
+    return comments
+
+
+def run(comments):
+    parser = GtkDocCommentBlockParser()
+    for comment in comments:
+        parser.parse_comment_block(comment, 'benchmark.c', 1)
+
+
+def main():
+    iterations = int(sys.argv[1]) if len(sys.argv) > 1 else 20
+    comments = collect_comments(os.path.join(path, 'tests', 'scanner', 'annotationparser'))
+    # Warnings about the intentionally broken test input are not interesting here
+    MessageLogger.get(namespace=None).enable_warnings(())
+
+    tokenizer = annotationparser._tokenize_comment_lines
+    if tokenizer is None:
+        print('_giscanner.tokenize_comment_lines is not available, only timing regexes')
+
+    print('%d comment blocks, %d iterations' % (len(comments), iterations))
+    annotationparser._tokenize_comment_lines = None
+    regexes = timeit.timeit(lambda: run(comments), number=iterations)
+    print('regexes:   %.3fs' % (regexes, ))
+    if tokenizer is not None:
+        annotationparser._tokenize_comment_lines = tokenizer
+        compiled = timeit.timeit(lambda: run(comments), number=iterations)
+        print('tokenizer: %.3fs (%.2fx)' % (compiled, regexes / compiled))
+
+
+if __name__ == '__main__':
+    main()
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+# -*- Mode: Python -*-
+# Count the page faults taken while loading a typelib and looking up
+# its entries, to compare typelib layouts (e.g. g-ir-compiler
+# --hot-cold-layout).  Each directory should hold a build of the same
+# typelib and of its dependencies; every run happens in a new process.
+# e.g.:
+#   ./benchmark-typelib-faults.py Gtk-3.0 default/ hot-cold/ [-n runs]
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import argparse
+import ctypes
+import ctypes.util
+import os
+import resource
+import subprocess
+import sys
+
+# GIInfoType values of registered types: struct, boxed, enum, flags,
+# object, interface and union
+REGISTERED_TYPES = (3, 4, 5, 6, 7, 8, 11)
+
+
+def load_girepository():
+    name = ctypes.util.find_library('girepository-1.0')
+    if name is None:
+        raise SystemExit("libgirepository-1.0 not found")
+    lib = ctypes.CDLL(name)
+
+    lib.g_irepository_get_default.restype = ctypes.c_void_p
+    lib.g_irepository_require.restype = ctypes.c_void_p
+    lib.g_irepository_require.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p, ctypes.c_int,
+        ctypes.c_void_p]
+    lib.g_irepository_get_n_infos.restype = ctypes.c_int
+    lib.g_irepository_get_n_infos.argtypes = [ctypes.c_void_p, ctypes.c_char_p]
+    lib.g_irepository_get_info.restype = ctypes.c_void_p
+    lib.g_irepository_get_info.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_int]
+    lib.g_irepository_find_by_name.restype = ctypes.c_void_p
+    lib.g_irepository_find_by_name.argtypes = [
+        ctypes.c_void_p, ctypes.c_char_p, ctypes.c_char_p]
+    lib.g_base_info_get_name.restype = ctypes.c_char_p
+    lib.g_base_info_get_name.argtypes = [ctypes.c_void_p]
+    lib.g_base_info_get_type.restype = ctypes.c_int
+    lib.g_base_info_get_type.argtypes = [ctypes.c_void_p]
+    lib.g_base_info_unref.argtypes = [ctypes.c_void_p]
+    lib.g_registered_type_info_get_type_name.restype = ctypes.c_char_p
+    lib.g_registered_type_info_get_type_name.argtypes = [ctypes.c_void_p]
+    return lib
+
+
+def lookup_all(lib, repo, namespace, version):
+    """Load the typelib, then look up every entry by index and by name,
+    reading the type name of registered types."""
+    if not lib.g_irepository_require(repo, namespace, version, 0, None):
+        raise SystemExit("could not load %s-%s" % (namespace, version))
+    names = []
+    for i in range(lib.g_irepository_get_n_infos(repo, namespace)):
+        info = lib.g_irepository_get_info(repo, namespace, i)
+        names.append(lib.g_base_info_get_name(info))
+        if lib.g_base_info_get_type(info) in REGISTERED_TYPES:
+            lib.g_registered_type_info_get_type_name(info)
+        lib.g_base_info_unref(info)
+    for name in names:
+        info = lib.g_irepository_find_by_name(repo, namespace, name)
+        if info:
+            lib.g_base_info_unref(info)
+
+
+def run_child(namespace, version):
+    lib = load_girepository()
+    repo = lib.g_irepository_get_default()
+    before = resource.getrusage(resource.RUSAGE_SELF)
+    lookup_all(lib, repo, namespace.encode(), version.encode())
+    after = resource.getrusage(resource.RUSAGE_SELF)
+    print(after.ru_minflt - before.ru_minflt,
+          after.ru_majflt - before.ru_majflt)
+
+
+def run(typelib_dir, namespace, version, runs):
+    env = dict(os.environ)
+    env['GI_TYPELIB_PATH'] = os.path.abspath(typelib_dir)
+    minor, major = [], []
+    for _ in range(runs):
+        output = subprocess.check_output(
+            [sys.executable, __file__, '--child', namespace, version],
+            env=env, universal_newlines=True)
+        counts = output.split()
+        minor.append(int(counts[0]))
+        major.append(int(counts[1]))
+    minor.sort()
+    major.sort()
+    return minor[len(minor) // 2], minor[0], major[len(major) // 2]
+
+
+def main():
+    if len(sys.argv) == 4 and sys.argv[1] == '--child':
+        run_child(sys.argv[2], sys.argv[3])
+        return
+
+    parser = argparse.ArgumentParser()
+    parser.add_argument('namespace', help="NAMESPACE-VERSION to load")
+    parser.add_argument('dirs', nargs='+', help="directories with typelibs")
+    parser.add_argument('-n', '--runs', type=int, default=10)
+    args = parser.parse_args()
+
+    namespace, version = args.namespace.rsplit('-', 1)
+    print("%-30s %14s %10s %14s" % ('directory', 'minor (median)', 'minor (min)',
+                                    'major (median)'))
+    for typelib_dir in args.dirs:
+        median, lowest, major = run(typelib_dir, namespace, version, args.runs)
+        print("%-30s %14d %10d %14d" % (typelib_dir, median, lowest, major))
+
+
+if __name__ == '__main__':
+    main()
@@ -4203,6 +4203,12 @@ gi_marshalling_tests_object_overridden_method (GIMarshallingTestsObject *object)
   g_assert_cmpint (object->int_, ==, 0);
 }
 
+void
+gi_marshalling_tests_object_class_method (GIMarshallingTestsObjectClass *klass)
+{
+  g_return_if_fail (GI_MARSHALLING_TESTS_IS_OBJECT_CLASS (klass));
+}
+
 GIMarshallingTestsObject *
 gi_marshalling_tests_object_new (gint int_)
 {
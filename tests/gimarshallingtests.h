@@ -1513,6 +1513,9 @@ void gi_marshalling_tests_object_method (GIMarshallingTestsObject *object);
 _GI_TEST_EXTERN
 void gi_marshalling_tests_object_overridden_method (GIMarshallingTestsObject *object);
 
+_GI_TEST_EXTERN
+void gi_marshalling_tests_object_class_method (GIMarshallingTestsObjectClass *klass);
+
 _GI_TEST_EXTERN
 GIMarshallingTestsObject *gi_marshalling_tests_object_new (gint int_);
 GIMarshallingTestsObject *gi_marshalling_tests_object_new_fail (gint int_, GError **error);
@@ -1,5 +1,7 @@
 
 #include "girepository.h"
+#include "girepository-private.h"
+#include "gitypelib-internal.h"
 
 
 static void
@@ -47,12 +49,148 @@ test_field_iterators (void)
   g_base_info_unref (class_info);
 }
 
+static void
+test_field_offsets (void)
+{
+  GIRepository *repo;
+  GITypelib *typelib;
+  Header *header;
+  StructBlob *blob;
+  GIStructInfo *class_info;
+  GIFieldInfo *field_info;
+  GIFunctionInfo *method_info;
+  GError *error = NULL;
+  guint32 *offsets;
+  guint32 offset;
+  gint i, n_embedded = 0;
+
+  repo = g_irepository_get_default ();
+
+  typelib = g_irepository_require (repo, "GIMarshallingTests", NULL, 0, &error);
+  g_assert_nonnull (typelib);
+  g_assert_no_error (error);
+
+  /* The vfunc fields of the class struct embed a callback, so they are
+   * not all the same size */
+  class_info = g_irepository_find_by_name (repo, "GIMarshallingTests", "ObjectClass");
+  g_assert_nonnull (class_info);
+
+  header = (Header *) typelib->data;
+  blob = (StructBlob *) &typelib->data[((GIRealInfo *) class_info)->offset];
+  g_assert_cmpint (g_struct_info_get_n_fields (class_info), ==, blob->n_fields);
+
+  offsets = g_new (guint32, blob->n_fields);
+  offset = ((GIRealInfo *) class_info)->offset + header->struct_blob_size;
+  for (i = 0; i < blob->n_fields; i++)
+    {
+      FieldBlob *field_blob = (FieldBlob *) &typelib->data[offset];
+
+      field_info = g_struct_info_get_field (class_info, i);
+      g_assert_cmpuint (((GIRealInfo *) field_info)->offset, ==, offset);
+      g_assert_cmpstr (g_base_info_get_name (field_info), ==,
+                       g_typelib_get_string (typelib, field_blob->name));
+      g_base_info_unref (field_info);
+
+      offsets[i] = offset;
+      offset += header->field_blob_size;
+      if (field_blob->has_embedded_type)
+        {
+          offset += header->callback_blob_size;
+          n_embedded++;
+        }
+    }
+  g_assert_cmpint (n_embedded, >, 0);
+
+  /* Looked up again, from the offset table, in reverse order */
+  for (i = blob->n_fields - 1; i >= 0; i--)
+    {
+      field_info = g_struct_info_get_field (class_info, i);
+      g_assert_cmpuint (((GIRealInfo *) field_info)->offset, ==, offsets[i]);
+      g_base_info_unref (field_info);
+    }
+  g_free (offsets);
+
+  /* The methods follow the last field */
+  g_assert_cmpint (g_struct_info_get_n_methods (class_info), ==, 1);
+  method_info = g_struct_info_get_method (class_info, 0);
+  g_assert_cmpuint (((GIRealInfo *) method_info)->offset, ==, offset);
+  g_base_info_unref (method_info);
+
+  method_info = g_struct_info_find_method (class_info, "method");
+  g_assert_nonnull (method_info);
+  g_assert_cmpstr (g_function_info_get_symbol (method_info), ==,
+                   "gi_marshalling_tests_object_class_method");
+  g_base_info_unref (method_info);
+
+  method_info = g_struct_info_find_method (class_info, "not_a_real_method_name");
+  g_assert_null (method_info);
+
+  g_base_info_unref (class_info);
+}
+
+/* Same as GIMarshallingTestsSimpleStruct */
+typedef struct {
+  glong long_;
+  gint8 int8;
+} SimpleStruct;
+
+static void
+test_layout (void)
+{
+  GIRepository *repo;
+  GITypelib *ret;
+  GIStructInfo *struct_info;
+  GIStructLayout *layout;
+  const GIStructLayoutField *fields;
+  GIArgument values[2];
+  guint8 buffer[sizeof (glong) + sizeof (gint8)];
+  guint n_fields;
+  GError *error = NULL;
+  SimpleStruct simple = { 6, 7 }, copy = { 0, 0 };
+
+  repo = g_irepository_get_default ();
+
+  ret = g_irepository_require (repo, "GIMarshallingTests", NULL, 0, &error);
+  g_assert_nonnull (ret);
+  g_assert_no_error (error);
+
+  struct_info = g_irepository_find_by_name (repo, "GIMarshallingTests", "SimpleStruct");
+  g_assert_nonnull (struct_info);
+
+  layout = g_struct_layout_new (struct_info);
+  fields = g_struct_layout_get_fields (layout, &n_fields);
+  g_assert_cmpuint (n_fields, ==, 2);
+  g_assert_cmpuint (fields[0].offset, ==, G_STRUCT_OFFSET (SimpleStruct, long_));
+  g_assert_cmpuint (fields[0].size, ==, sizeof (glong));
+  g_assert_cmpuint (fields[1].offset, ==, G_STRUCT_OFFSET (SimpleStruct, int8));
+  g_assert_cmpuint (fields[1].tag, ==, GI_TYPE_TAG_INT8);
+  g_assert_true (fields[1].readable && fields[1].writable);
+
+  g_assert_cmpuint (g_struct_layout_get_values (layout, &simple, values), ==, 2);
+  g_assert_cmpint (values[1].v_int8, ==, 7);
+  values[1].v_int8 = 8;
+  g_assert_cmpuint (g_struct_layout_set_values (layout, &simple, values), ==, 2);
+  g_assert_cmpint (simple.long_, ==, 6);
+  g_assert_cmpint (simple.int8, ==, 8);
+
+  g_assert_cmpuint (g_struct_layout_get_packed_size (layout), ==, sizeof (buffer));
+  g_struct_layout_pack (layout, &simple, buffer);
+  g_struct_layout_unpack (layout, buffer, &copy);
+  g_assert_cmpint (copy.long_, ==, 6);
+  g_assert_cmpint (copy.int8, ==, 8);
+
+  g_struct_layout_free (layout);
+  g_base_info_unref (struct_info);
+}
+
 int
 main(int argc, char **argv)
 {
   g_test_init (&argc, &argv, NULL);
 
   g_test_add_func ("/girepository/structinfo/field-iterators", test_field_iterators);
+  g_test_add_func ("/girepository/structinfo/field-offsets", test_field_offsets);
+  g_test_add_func ("/girepository/structinfo/layout", test_layout);
 
   return g_test_run ();
 }
@@ -3,13 +3,18 @@
  */
 
 #include "girepository.h"
+#include "girepository-private.h"
+#include "gitypelib-internal.h"
 
 #include <stdlib.h>
 #include <string.h>
 
+#include <glib/gstdio.h>
+
 static void
-test_enum_and_flags_cidentifier (GIRepository * repo)
+test_enum_and_flags_cidentifier (gconstpointer data)
 {
+  GIRepository *repo = (GIRepository *) data;
   GITypelib *ret;
   GError *error = NULL;
   gint n_infos, i;
@@ -55,6 +60,43 @@ test_enum_and_flags_cidentifier (GIRepository * repo)
     }
 }
 
+static void
+test_enum_value_lookup (gconstpointer data)
+{
+  GIRepository *repo = (GIRepository *) data;
+  GIBaseInfo *flags_info;
+  const GIEnumValueEntry *values;
+  guint n_values, n_matched;
+  gint indices[2];
+  guint32 remainder;
+
+  flags_info = g_irepository_find_by_name (repo, "GIMarshallingTests", "Flags");
+  g_assert (flags_info != NULL);
+
+  values = g_enum_info_get_sorted_values ((GIEnumInfo *) flags_info, &n_values);
+  g_assert_cmpuint (n_values, ==, 5);
+  g_assert_cmpint (values[0].value, ==, 1);
+  g_assert_cmpstr (values[0].name, ==, "value1");
+  g_assert_cmpint (values[2].value, ==, 3);
+  g_assert_cmpstr (values[2].name, ==, "mask");
+  g_assert_cmpstr (values[3].name, ==, "mask2");
+  g_assert_cmpint (values[4].value, ==, 4);
+
+  g_assert_cmpint (g_enum_info_find_value ((GIEnumInfo *) flags_info, 4), ==, 2);
+  /* mask and mask2 are equal, the first one is found */
+  g_assert_cmpint (g_enum_info_find_value ((GIEnumInfo *) flags_info, 3), ==, 3);
+  g_assert_cmpint (g_enum_info_find_value ((GIEnumInfo *) flags_info, 8), ==, -1);
+
+  n_matched = g_enum_info_decompose_flags ((GIEnumInfo *) flags_info, 1 | 2 | 8,
+                                           indices, G_N_ELEMENTS (indices), &remainder);
+  g_assert_cmpuint (n_matched, ==, 3);
+  g_assert_cmpint (indices[0], ==, 0);
+  g_assert_cmpint (indices[1], ==, 1);
+  g_assert_cmpuint (remainder, ==, 8);
+
+  g_base_info_unref (flags_info);
+}
+
 static void
 _check_enum_methods (GIBaseInfo * info, const gchar * name, const gchar * prefix)
 {
@@ -83,8 +125,9 @@ _check_enum_methods (GIBaseInfo * info, const gchar * name, const gchar * prefix
 }
 
 static void
-test_enum_and_flags_static_methods (GIRepository * repo)
+test_enum_and_flags_static_methods (gconstpointer data)
 {
+  GIRepository *repo = (GIRepository *) data;
   GITypelib *ret;
   GError *error = NULL;
   GIBaseInfo *enum_info;
@@ -107,8 +150,9 @@ test_enum_and_flags_static_methods (GIRepository * repo)
 }
 
 static void
-test_size_of_gvalue (GIRepository * repo)
+test_size_of_gvalue (gconstpointer data)
 {
+  GIRepository *repo = (GIRepository *) data;
   GIBaseInfo *struct_info;
 
   struct_info = g_irepository_find_by_name (repo, "GObject", "Value");
@@ -119,8 +163,9 @@ test_size_of_gvalue (GIRepository * repo)
 }
 
 static void
-test_is_pointer_for_struct_arg (GIRepository * repo)
+test_is_pointer_for_struct_arg (gconstpointer data)
 {
+  GIRepository *repo = (GIRepository *) data;
   GITypelib *ret;
   GError *error = NULL;
   GIStructInfo *variant_info;
@@ -157,8 +202,9 @@ test_is_pointer_for_struct_arg (GIRepository * repo)
 }
 
 static void
-test_fundamental_get_ref_function_pointer (GIRepository * repo)
+test_fundamental_get_ref_function_pointer (gconstpointer data)
 {
+  GIRepository *repo = (GIRepository *) data;
   GIObjectInfo *info;
 
   g_assert (g_irepository_require (repo, "Regress", NULL, 0, NULL));
@@ -168,8 +214,9 @@ test_fundamental_get_ref_function_pointer (GIRepository * repo)
 }
 
 static void
-test_hash_with_cairo_typelib (GIRepository * repo)
+test_hash_with_cairo_typelib (gconstpointer data)
 {
+  GIRepository *repo = (GIRepository *) data;
   GIBaseInfo *info;
 
   g_assert (g_irepository_require (repo, "cairo", NULL, 0, NULL));
@@ -197,8 +244,9 @@ lookup_property (GIObjectInfo * info, const gchar * name)
 }
 
 static void
-test_char_types (GIRepository * repo)
+test_char_types (gconstpointer data)
 {
+  GIRepository *repo = (GIRepository *) data;
   GITypelib *ret;
   GError *error = NULL;
   GIBaseInfo *prop_obj;
@@ -233,8 +281,9 @@ test_char_types (GIRepository * repo)
 }
 
 static void
-test_signal_array_len (GIRepository * repo)
+test_signal_array_len (gconstpointer data)
 {
+  GIRepository *repo = (GIRepository *) data;
   GIObjectInfo *testobj_info;
   GISignalInfo *sig_info;
   GIArgInfo arg_info;
@@ -276,8 +325,9 @@ test_signal_array_len (GIRepository * repo)
 }
 
 static void
-test_instance_transfer_ownership (GIRepository * repo)
+test_instance_transfer_ownership (gconstpointer data)
 {
+  GIRepository *repo = (GIRepository *) data;
   GIObjectInfo *testobj_info;
   GIFunctionInfo *func_info;
   GITransfer transfer;
@@ -303,23 +353,632 @@ test_instance_transfer_ownership (GIRepository * repo)
   g_base_info_unref (testobj_info);
 }
 
-int
-main (int argc, char **argv)
+static gpointer
+get_struct_field (gpointer      vtable,
+                  GIStructInfo *struct_info,
+                  const gchar  *name)
+{
+  GIFieldInfo *field_info;
+  gpointer func;
+
+  field_info = g_struct_info_find_field (struct_info, name);
+  g_assert (field_info != NULL);
+  func = G_STRUCT_MEMBER (gpointer, vtable, g_field_info_get_offset (field_info));
+  g_base_info_unref (field_info);
+
+  return func;
+}
+
+static gpointer
+get_vfunc_location (GIVFuncInfo *vfunc_info)
+{
+  GIRealInfo *rinfo = (GIRealInfo *) vfunc_info;
+
+  if (rinfo->typelib->vfunc_locations == NULL)
+    return NULL;
+  return g_hash_table_lookup (rinfo->typelib->vfunc_locations,
+                              GUINT_TO_POINTER (rinfo->offset));
+}
+
+/* Resolves @vfunc_info for @implementor_gtype twice, the second time
+ * from the location cached by the first lookup */
+static void
+assert_vfunc_address (GIVFuncInfo *vfunc_info,
+                      GType        implementor_gtype,
+                      gpointer     expected)
+{
+  GError *error = NULL;
+  gpointer location;
+
+  g_assert (get_vfunc_location (vfunc_info) == NULL);
+
+  g_assert (g_vfunc_info_get_address (vfunc_info, implementor_gtype, &error) == expected);
+  g_assert_no_error (error);
+  location = get_vfunc_location (vfunc_info);
+  g_assert (location != NULL);
+
+  g_assert (g_vfunc_info_get_address (vfunc_info, implementor_gtype, &error) == expected);
+  g_assert_no_error (error);
+  g_assert (get_vfunc_location (vfunc_info) == location);
+}
+
+static void
+test_vfunc_address (gconstpointer data)
+{
+  GIRepository *repo = (GIRepository *) data;
+  GIObjectInfo *object_info, *impl_info;
+  GIInterfaceInfo *iface_info;
+  GIStructInfo *struct_info;
+  GIVFuncInfo *vfunc_info;
+  GType object_gtype, impl_gtype, iface_gtype;
+  gpointer klass, expected;
+  GError *error = NULL;
+
+  g_assert (g_irepository_require (repo, "GIMarshallingTests", NULL, 0, NULL));
+
+  /* Object vfunc, found in the class structure */
+  object_info = g_irepository_find_by_name (repo, "GIMarshallingTests", "Object");
+  g_assert (object_info != NULL);
+  object_gtype = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo *) object_info);
+  vfunc_info = g_object_info_find_vfunc (object_info, "method_with_default_implementation");
+  g_assert (vfunc_info != NULL);
+
+  klass = g_type_class_ref (object_gtype);
+  struct_info = g_object_info_get_class_struct (object_info);
+  expected = get_struct_field (klass, struct_info, "method_with_default_implementation");
+  g_assert (expected != NULL);
+  assert_vfunc_address (vfunc_info, object_gtype, expected);
+
+  g_base_info_unref (struct_info);
+  g_base_info_unref (vfunc_info);
+  g_type_class_unref (klass);
+
+  /* Interface vfunc, found in the interface structure of the implementor */
+  iface_info = g_irepository_find_by_name (repo, "GIMarshallingTests", "Interface");
+  g_assert (iface_info != NULL);
+  iface_gtype = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo *) iface_info);
+  impl_info = g_irepository_find_by_name (repo, "GIMarshallingTests", "InterfaceImpl");
+  g_assert (impl_info != NULL);
+  impl_gtype = g_registered_type_info_get_g_type ((GIRegisteredTypeInfo *) impl_info);
+  vfunc_info = g_interface_info_find_vfunc (iface_info, "test_int8_in");
+  g_assert (vfunc_info != NULL);
+
+  klass = g_type_class_ref (impl_gtype);
+  struct_info = g_interface_info_get_iface_struct (iface_info);
+  expected = get_struct_field (g_type_interface_peek (klass, iface_gtype),
+                               struct_info, "test_int8_in");
+  g_assert (expected != NULL);
+  assert_vfunc_address (vfunc_info, impl_gtype, expected);
+
+  /* An implementor without the interface */
+  g_assert (g_vfunc_info_get_address (vfunc_info, object_gtype, &error) == NULL);
+  g_assert_error (error, G_INVOKE_ERROR, G_INVOKE_ERROR_SYMBOL_NOT_FOUND);
+  g_clear_error (&error);
+
+  g_base_info_unref (struct_info);
+  g_base_info_unref (vfunc_info);
+  g_type_class_unref (klass);
+  g_base_info_unref (impl_info);
+  g_base_info_unref (iface_info);
+  g_base_info_unref (object_info);
+}
+
+static void
+test_validate_flag (void)
+{
+  GIRepository *repo;
+  GITypelib *typelib;
+  GError *error = NULL;
+  gchar *dir, *cache_path, *contents;
+  gsize len;
+
+  if (g_test_subprocess ())
+    {
+      repo = g_object_new (G_TYPE_IREPOSITORY, NULL);
+      g_assert (g_irepository_require (repo, "Regress", NULL,
+                                       G_IREPOSITORY_LOAD_FLAG_VALIDATE, &error));
+      g_assert_no_error (error);
+      g_object_unref (repo);
+      return;
+    }
+
+  dir = g_dir_make_tmp ("gitypelibtest-XXXXXX", &error);
+  g_assert_no_error (error);
+  cache_path = g_build_filename (dir, "validated-typelibs", NULL);
+  g_setenv ("GI_TYPELIB_VALIDATION_CACHE", cache_path, TRUE);
+
+  /* Regress and its dependencies are validated and recorded */
+  repo = g_object_new (G_TYPE_IREPOSITORY, NULL);
+  g_assert (g_irepository_require (repo, "Regress", NULL,
+                                   G_IREPOSITORY_LOAD_FLAG_VALIDATE, &error));
+  g_assert_no_error (error);
+  g_object_unref (repo);
+
+  /* Typelibs loaded without the flag are validated when it's passed */
+  repo = g_object_new (G_TYPE_IREPOSITORY, NULL);
+  typelib = g_irepository_require (repo, "Regress", NULL, 0, &error);
+  g_assert_no_error (error);
+  g_assert (!typelib->validated);
+  g_assert (g_irepository_require (repo, "Regress", NULL,
+                                   G_IREPOSITORY_LOAD_FLAG_VALIDATE, &error) == typelib);
+  g_assert_no_error (error);
+  g_assert (typelib->validated);
+  typelib = g_irepository_require (repo, "Utility", NULL, 0, &error);
+  g_assert_no_error (error);
+  g_assert (typelib->validated);
+  g_object_unref (repo);
+
+  g_assert (g_file_get_contents (cache_path, &contents, &len, &error));
+  g_assert_no_error (error);
+  g_assert_cmpuint (len, >, 0);
+  g_assert_cmpuint (len % 65, ==, 0);
+  g_free (contents);
+
+  /* and only looked up by a new process, which only knows about them
+   * through the file */
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_test_trap_assert_passed ();
+
+  g_assert (g_file_get_contents (cache_path, &contents, NULL, &error));
+  g_assert_cmpuint (strlen (contents), ==, len);
+  g_free (contents);
+
+  g_unsetenv ("GI_TYPELIB_VALIDATION_CACHE");
+  g_remove (cache_path);
+  g_rmdir (dir);
+  g_free (cache_path);
+  g_free (dir);
+}
+
+static void
+test_validate_parallel (void)
 {
   GIRepository *repo;
+  GITypelib *typelib;
+  GError *error = NULL;
+  GError *parallel_error = NULL;
+  gchar *contents;
+  gsize len;
+  Header *header;
+  DirEntry *entry;
 
   repo = g_irepository_get_default ();
+  g_assert (g_irepository_require (repo, "GIMarshallingTests", NULL, 0, &error));
+  g_assert_no_error (error);
+  g_assert (g_file_get_contents (g_irepository_get_typelib_path (repo, "GIMarshallingTests"),
+                                 &contents, &len, &error));
+  g_assert_no_error (error);
+
+  /* Enough entries to be split across four threads */
+  header = (Header *) contents;
+  g_assert_cmpuint (header->n_local_entries, >=, 4 * 64);
+
+  /* Break a blob late in the directory, and an entry after it; both
+   * have to report the error of the first */
+  entry = (DirEntry *) &contents[header->directory +
+                                 (header->n_local_entries * 5 / 8) * header->entry_blob_size];
+  ((CommonBlob *) &contents[entry->offset])->blob_type = BLOB_TYPE_INVALID;
+  entry = (DirEntry *) &contents[header->directory +
+                                 (header->n_local_entries - 1) * header->entry_blob_size];
+  entry->blob_type = BLOB_TYPE_UNION + 1;
+
+  typelib = g_typelib_new_from_memory ((guint8 *) contents, len, &error);
+  g_assert_no_error (error);
+
+  g_assert (!g_typelib_validate (typelib, &error));
+  g_assert (strstr (error->message, "Invalid blob type") != NULL);
+  g_assert (!g_typelib_validate_parallel (typelib, 4, &parallel_error));
+  g_assert (parallel_error != NULL);
+  g_assert_cmpint (parallel_error->code, ==, error->code);
+  g_assert_cmpstr (parallel_error->message, ==, error->message);
+
+  g_error_free (parallel_error);
+  g_error_free (error);
+  g_typelib_free (typelib);
+}
+
+/* Loads Regress from one of the variant directories of the build,
+ * compiled with an optional layout of g-ir-compiler, into its own
+ * repository; its dependencies come from the search path.
+ */
+static GIRepository *
+load_regress_variant (const gchar *dir)
+{
+  GIRepository *repo;
+  GError *error = NULL;
+
+  repo = g_object_new (G_TYPE_IREPOSITORY, NULL);
+  if (!g_irepository_require_private (repo, dir, "Regress", "1.0", 0, &error))
+    g_error ("failed to load Regress from %s: %s", dir, error->message);
+
+  return repo;
+}
+
+static void
+check_same_callable (GICallableInfo *info,
+                     GICallableInfo *expected)
+{
+  GITypeInfo type_info, expected_type_info;
+  GIArgInfo arg_info, expected_arg_info;
+  gint i;
+
+  g_assert_cmpstr (g_base_info_get_name (info), ==, g_base_info_get_name (expected));
+
+  g_callable_info_load_return_type (info, &type_info);
+  g_callable_info_load_return_type (expected, &expected_type_info);
+  g_assert_cmpint (g_type_info_get_tag (&type_info), ==,
+                   g_type_info_get_tag (&expected_type_info));
+  g_assert_cmpint (g_type_info_is_pointer (&type_info), ==,
+                   g_type_info_is_pointer (&expected_type_info));
+  g_assert_cmpint (g_callable_info_get_caller_owns (info), ==,
+                   g_callable_info_get_caller_owns (expected));
+  g_assert_cmpint (g_callable_info_may_return_null (info), ==,
+                   g_callable_info_may_return_null (expected));
+
+  g_assert_cmpint (g_callable_info_get_n_args (info), ==,
+                   g_callable_info_get_n_args (expected));
+  for (i = 0; i < g_callable_info_get_n_args (info); i++)
+    {
+      g_callable_info_load_arg (info, i, &arg_info);
+      g_callable_info_load_arg (expected, i, &expected_arg_info);
+      g_assert_cmpstr (g_base_info_get_name (&arg_info), ==,
+                       g_base_info_get_name (&expected_arg_info));
+      g_assert_cmpint (g_arg_info_get_direction (&arg_info), ==,
+                       g_arg_info_get_direction (&expected_arg_info));
+      g_assert_cmpint (g_arg_info_get_ownership_transfer (&arg_info), ==,
+                       g_arg_info_get_ownership_transfer (&expected_arg_info));
+      g_arg_info_load_type (&arg_info, &type_info);
+      g_arg_info_load_type (&expected_arg_info, &expected_type_info);
+      g_assert_cmpint (g_type_info_get_tag (&type_info), ==,
+                       g_type_info_get_tag (&expected_type_info));
+    }
+}
 
-  /* do tests */
-  test_enum_and_flags_cidentifier (repo);
-  test_enum_and_flags_static_methods (repo);
-  test_size_of_gvalue (repo);
-  test_is_pointer_for_struct_arg (repo);
+/* Checks the functions, methods, signals and vfuncs of Regress in @repo
+ * against those of the default typelib.
+ */
+static void
+check_same_infos (GIRepository *repo)
+{
+  GIRepository *default_repo = g_irepository_get_default ();
+  gint i, j, n;
+
+  g_assert (g_irepository_require (default_repo, "Regress", NULL, 0, NULL));
+
+  n = g_irepository_get_n_infos (default_repo, "Regress");
+  g_assert_cmpint (g_irepository_get_n_infos (repo, "Regress"), ==, n);
+
+  for (i = 0; i < n; i++)
+    {
+      GIBaseInfo *expected = g_irepository_get_info (default_repo, "Regress", i);
+      GIBaseInfo *info = g_irepository_find_by_name (repo, "Regress",
+                                                     g_base_info_get_name (expected));
+
+      g_assert (info != NULL);
+      g_assert_cmpint (g_base_info_get_type (info), ==, g_base_info_get_type (expected));
+
+      switch (g_base_info_get_type (info))
+        {
+        case GI_INFO_TYPE_FUNCTION:
+        case GI_INFO_TYPE_CALLBACK:
+          check_same_callable (info, expected);
+          break;
+        case GI_INFO_TYPE_OBJECT:
+          for (j = 0; j < g_object_info_get_n_methods (info); j++)
+            {
+              GIFunctionInfo *method = g_object_info_get_method (info, j);
+              GIFunctionInfo *expected_method = g_object_info_get_method (expected, j);
+              check_same_callable (method, expected_method);
+              g_base_info_unref (expected_method);
+              g_base_info_unref (method);
+            }
+          for (j = 0; j < g_object_info_get_n_signals (info); j++)
+            {
+              GISignalInfo *signal = g_object_info_get_signal (info, j);
+              GISignalInfo *expected_signal = g_object_info_get_signal (expected, j);
+              check_same_callable (signal, expected_signal);
+              g_base_info_unref (expected_signal);
+              g_base_info_unref (signal);
+            }
+          for (j = 0; j < g_object_info_get_n_vfuncs (info); j++)
+            {
+              GIVFuncInfo *vfunc = g_object_info_get_vfunc (info, j);
+              GIVFuncInfo *expected_vfunc = g_object_info_get_vfunc (expected, j);
+              check_same_callable (vfunc, expected_vfunc);
+              g_base_info_unref (expected_vfunc);
+              g_base_info_unref (vfunc);
+            }
+          break;
+        case GI_INFO_TYPE_STRUCT:
+          for (j = 0; j < g_struct_info_get_n_methods (info); j++)
+            {
+              GIFunctionInfo *method = g_struct_info_get_method (info, j);
+              GIFunctionInfo *expected_method = g_struct_info_get_method (expected, j);
+              check_same_callable (method, expected_method);
+              g_base_info_unref (expected_method);
+              g_base_info_unref (method);
+            }
+          break;
+        default:
+          break;
+        }
+
+      g_base_info_unref (info);
+      g_base_info_unref (expected);
+    }
+}
+
+static guint32
+get_function_signature (GITypelib   *typelib,
+                        const gchar *name)
+{
+  Header *header = (Header *) typelib->data;
+  DirEntry *entry;
+  guint16 i;
+
+  for (i = 1; i <= header->n_local_entries; i++)
+    {
+      entry = g_typelib_get_dir_entry (typelib, i);
+      if (entry->blob_type == BLOB_TYPE_FUNCTION &&
+          strcmp (g_typelib_get_string (typelib, entry->name), name) == 0)
+        return ((FunctionBlob *) &typelib->data[entry->offset])->signature;
+    }
+
+  g_assert_not_reached ();
+  return 0;
+}
+
+static void
+test_share_signatures (void)
+{
+  GIRepository *repo;
+  GITypelib *typelib;
+  GError *error = NULL;
+
+  repo = load_regress_variant ("shared-signatures");
+  typelib = g_irepository_require (repo, "Regress", NULL, 0, NULL);
+  g_assert (g_typelib_validate (typelib, &error));
+  g_assert_no_error (error);
+
+  /* both are gboolean (gboolean in) */
+  g_assert_cmpuint (get_function_signature (typelib, "test_boolean_true"), ==,
+                    get_function_signature (typelib, "test_boolean_false"));
+
+  check_same_infos (repo);
   test_fundamental_get_ref_function_pointer (repo);
-  test_hash_with_cairo_typelib (repo);
-  test_char_types (repo);
   test_signal_array_len (repo);
   test_instance_transfer_ownership (repo);
 
-  exit (0);
+  g_object_unref (repo);
+}
+
+static void
+test_hot_cold_layout (void)
+{
+  GIRepository *repo;
+  GITypelib *typelib;
+  GError *error = NULL;
+  gint i, n;
+
+  repo = load_regress_variant ("hot-cold");
+  typelib = g_irepository_require (repo, "Regress", NULL, 0, NULL);
+  g_assert (g_typelib_validate (typelib, &error));
+  g_assert_no_error (error);
+
+  /* every entry is found by name, and every registered type by its GType */
+  check_same_infos (repo);
+
+  n = g_irepository_get_n_infos (repo, "Regress");
+  for (i = 0; i < n; i++)
+    {
+      GIBaseInfo *info = g_irepository_get_info (repo, "Regress", i);
+      GIBaseInfo *found;
+      GType gtype;
+
+      if (GI_IS_REGISTERED_TYPE_INFO (info) &&
+          (gtype = g_registered_type_info_get_g_type (info)) != G_TYPE_NONE)
+        {
+          found = g_irepository_find_by_gtype (repo, gtype);
+          g_assert (found != NULL);
+          g_assert_cmpstr (g_base_info_get_name (found), ==, g_base_info_get_name (info));
+          g_base_info_unref (found);
+        }
+
+      g_base_info_unref (info);
+    }
+
+  g_object_unref (repo);
+}
+
+static void
+test_info_cache (gconstpointer data)
+{
+  GIRepository *repo = (GIRepository *) data;
+  GITypelib *typelib;
+  GIObjectInfo *testobj_info, *testobj_info2;
+  GIFunctionInfo *method_info, *method_info2;
+  GIArgInfo *arg_info, *arg_info2;
+  GIFunctionInfo *uncached_info;
+
+  typelib = g_irepository_require (repo, "Regress", NULL, 0, NULL);
+  g_assert (typelib != NULL);
+
+  /* infos created before enabling the cache stay private */
+  testobj_info = g_irepository_find_by_name (repo, "Regress", "TestObj");
+  uncached_info = g_object_info_find_method (testobj_info, "set_bare");
+  g_assert (uncached_info != NULL);
+  g_base_info_unref (testobj_info);
+
+  g_typelib_enable_info_cache (typelib);
+
+  testobj_info = g_irepository_find_by_name (repo, "Regress", "TestObj");
+  testobj_info2 = g_irepository_find_by_name (repo, "Regress", "TestObj");
+  g_assert (testobj_info == testobj_info2);
+
+  method_info = g_object_info_find_method (testobj_info, "set_bare");
+  method_info2 = g_object_info_find_method (testobj_info2, "set_bare");
+  g_assert (method_info == method_info2);
+  g_assert (method_info != uncached_info);
+  g_assert (g_base_info_equal (method_info, uncached_info));
+  g_assert (g_base_info_get_container (method_info) == testobj_info);
+
+  arg_info = g_callable_info_get_arg (method_info, 0);
+  arg_info2 = g_callable_info_get_arg (method_info2, 0);
+  g_assert (arg_info == arg_info2);
+
+  g_base_info_unref (arg_info2);
+  g_base_info_unref (arg_info);
+  g_base_info_unref (method_info2);
+  g_base_info_unref (method_info);
+  g_base_info_unref (testobj_info2);
+  g_base_info_unref (testobj_info);
+
+  /* infos from outside the cache keep working */
+  g_assert_cmpstr (g_base_info_get_name (uncached_info), ==, "set_bare");
+  g_base_info_unref (uncached_info);
+}
+
+static gboolean
+list_contains (const gint *list,
+               gsize       len,
+               gint        value)
+{
+  gsize i;
+
+  for (i = 0; i < len; i++)
+    if (list[i] == value)
+      return TRUE;
+
+  return FALSE;
+}
+
+static DirEntry *
+get_dir_entry (GITypelib   *typelib,
+               const gchar *name,
+               gint        *index)
+{
+  Header *header = (Header *) typelib->data;
+  DirEntry *entry = g_typelib_get_dir_entry_by_name (typelib, name);
+
+  g_assert (entry != NULL);
+  *index = ((guint8 *) entry - &typelib->data[header->directory]) / header->entry_blob_size + 1;
+
+  return entry;
+}
+
+static void
+test_profile (void)
+{
+  GIRepository *repo;
+  GITypelib *typelib;
+  GIBaseInfo *info;
+  GKeyFile *keyfile;
+  GError *error = NULL;
+  gchar *dir, *path;
+  DirEntry *testobj_entry, *unused_entry;
+  gint testobj_index, unused_index;
+  gint *list;
+  gsize len;
+
+  /* Profiling can't be turned off, so it only happens in a subprocess,
+   * which got it enabled through GI_TYPELIB_PROFILE when main() set up
+   * the default repository */
+  if (g_test_subprocess ())
+    {
+      repo = g_object_new (G_TYPE_IREPOSITORY, NULL);
+      g_assert (g_irepository_require (repo, "Regress", NULL, 0, &error));
+      g_assert_no_error (error);
+      info = g_irepository_find_by_name (repo, "Regress", "TestObj");
+      g_assert (info != NULL);
+      g_base_info_unref (info);
+
+      g_assert (g_irepository_write_profile (&error));
+      g_assert_no_error (error);
+      g_object_unref (repo);
+      return;
+    }
+
+  dir = g_dir_make_tmp ("gitypelibtest-XXXXXX", &error);
+  g_assert_no_error (error);
+  path = g_build_filename (dir, "profile", NULL);
+
+  /* the default repository of this process is already set up, so it
+   * isn't profiled itself */
+  g_setenv ("GI_TYPELIB_PROFILE", path, TRUE);
+  g_test_trap_subprocess (NULL, 0, 0);
+  g_unsetenv ("GI_TYPELIB_PROFILE");
+  g_test_trap_assert_passed ();
+
+  keyfile = g_key_file_new ();
+  g_assert (g_key_file_load_from_file (keyfile, path, 0, &error));
+  g_assert_no_error (error);
+  g_assert_cmpuint (g_key_file_get_uint64 (keyfile, "Regress-1.0", "size", NULL), >, 0);
+
+  /* TestObj was looked up by the child, test_boolean never was, not
+   * even by a scan passing over it */
+  typelib = g_irepository_require (g_irepository_get_default (), "Regress", NULL, 0, &error);
+  g_assert_no_error (error);
+  testobj_entry = get_dir_entry (typelib, "TestObj", &testobj_index);
+  unused_entry = get_dir_entry (typelib, "test_boolean", &unused_index);
+
+  list = g_key_file_get_integer_list (keyfile, "Regress-1.0", "entries", &len, &error);
+  g_assert_no_error (error);
+  g_assert (list_contains (list, len, testobj_index));
+  g_assert (!list_contains (list, len, unused_index));
+  g_free (list);
+
+  list = g_key_file_get_integer_list (keyfile, "Regress-1.0", "blobs", &len, &error);
+  g_assert_no_error (error);
+  g_assert (list_contains (list, len, testobj_entry->offset));
+  g_assert (!list_contains (list, len, unused_entry->offset));
+  g_free (list);
+
+  g_key_file_free (keyfile);
+  g_remove (path);
+  g_rmdir (dir);
+  g_free (path);
+  g_free (dir);
+}
+
+int
+main (int argc, char **argv)
+{
+  GIRepository *repo;
+
+  g_test_init (&argc, &argv, NULL);
+
+  repo = g_irepository_get_default ();
+
+  g_test_add_data_func ("/girepository/typelib/enum-and-flags-cidentifier", repo,
+                        test_enum_and_flags_cidentifier);
+  g_test_add_data_func ("/girepository/typelib/enum-and-flags-static-methods", repo,
+                        test_enum_and_flags_static_methods);
+  g_test_add_data_func ("/girepository/typelib/enum-value-lookup", repo,
+                        test_enum_value_lookup);
+  g_test_add_data_func ("/girepository/typelib/size-of-gvalue", repo,
+                        test_size_of_gvalue);
+  g_test_add_data_func ("/girepository/typelib/is-pointer-for-struct-arg", repo,
+                        test_is_pointer_for_struct_arg);
+  g_test_add_data_func ("/girepository/typelib/fundamental-get-ref-function-pointer", repo,
+                        test_fundamental_get_ref_function_pointer);
+  g_test_add_data_func ("/girepository/typelib/hash-with-cairo-typelib", repo,
+                        test_hash_with_cairo_typelib);
+  g_test_add_data_func ("/girepository/typelib/char-types", repo,
+                        test_char_types);
+  g_test_add_data_func ("/girepository/typelib/signal-array-len", repo,
+                        test_signal_array_len);
+  g_test_add_data_func ("/girepository/typelib/instance-transfer-ownership", repo,
+                        test_instance_transfer_ownership);
+  g_test_add_data_func ("/girepository/typelib/vfunc-address", repo,
+                        test_vfunc_address);
+  g_test_add_func ("/girepository/typelib/validate-flag", test_validate_flag);
+  g_test_add_func ("/girepository/typelib/validate-parallel", test_validate_parallel);
+  g_test_add_func ("/girepository/typelib/profile", test_profile);
+  g_test_add_func ("/girepository/typelib/share-signatures", test_share_signatures);
+  g_test_add_func ("/girepository/typelib/hot-cold-layout", test_hot_cold_layout);
+  /* last, as it leaves the info cache enabled for Regress */
+  g_test_add_data_func ("/girepository/typelib/info-cache", repo,
+                        test_info_cache);
+
+  return g_test_run ();
 }
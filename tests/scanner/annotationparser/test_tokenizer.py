@@ -0,0 +1,192 @@
+# -*- Mode: Python -*-
+# GObject-Introspection - a framework for introspecting GObject libraries
+#
+# This program is free software; you can redistribute it and/or
+# modify it under the terms of the GNU General Public License
+# as published by the Free Software Foundation; either version 2
+# of the License, or (at your option) any later version.
+#
+# This program is distributed in the hope that it will be useful,
+# but WITHOUT ANY WARRANTY; without even the implied warranty of
+# MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+# GNU General Public License for more details.
+#
+# You should have received a copy of the GNU General Public License
+# along with this program; if not, write to the Free Software
+# Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA
+# 02110-1301, USA.
+#
+
+
+'''
+test_tokenizer.py
+
+Tests ensuring the tokenize_comment_lines() function of the _giscanner
+module classifies comment block lines exactly like the regular
+expressions in annotationparser.py do.
+'''
+
+from __future__ import absolute_import
+from __future__ import division
+from __future__ import print_function
+from __future__ import unicode_literals
+
+import os
+import re
+import unittest
+import xml.etree.ElementTree as etree
+
+from giscanner import annotationparser
+from giscanner.annotationparser import (ALL_TAGS, LINE_BREAK_RE, GtkDocCommentBlockParser,
+                                        GtkDocCommentBlockWriter)
+from giscanner.ast import Namespace
+from giscanner.message import MessageLogger, WARNING, ERROR, FATAL
+
+
+XML_NS = 'http://schemas.gnome.org/gobject-introspection/2013/test'
+
+# Lines the test corpus does not cover well
+EDGE_CASES = [
+    '',
+    '*',
+    ' *',
+    ' * ',
+    ' *\t',
+    '\t *\t@foo: bar',
+    ' ** double asterisk',
+    ' text * after text',
+    'no asterisk at all',
+    ' * @foo:',
+    ' * @foo :  bar  ',
+    ' * @foo-bar: x',
+    ' * @foo-: x',
+    ' * @-foo: x',
+    ' * @foo bar: x',
+    ' * @: x',
+    ' * @...: varargs',
+    ' * @foo...: varargs',
+    ' * @a...b...: varargs',
+    ' * @...',
+    ' * @foo',
+    ' * Returns: x',
+    ' * RETURNS: x',
+    ' * returns:x',
+    ' * Return: x',
+    ' * Returns : x',
+    ' * Returnsfoo: x',
+    ' * Return value: x',
+    ' * RETURN VALUE: x',
+    ' * Return\tValue: x',
+    ' * Return  value: x',
+    ' * Returns value: x',
+    ' * Since: 1.0',
+    ' * SINCE:',
+    ' * sInCe : 1.0 ',
+    ' * Since 1.0',
+    ' * Deprecated: 1.0: Use something else',
+    ' * Stability: Stable',
+    ' * Rename to: foo',
+    ' * Transfer: full',
+    ' * Description: x',
+    ' * Attributes: (foo bar)',
+    ' *   Returns: indented',
+    ' *\x0bReturns: vertical tab',
+    ' * Returns:\x1c',
+    ' * \x1fReturns: unit separator',
+    ' * Since:\x0c',
+    '\x1c* @foo: file separator before the asterisk',
+    # Not ASCII, left to the regular expressions
+    ' * Returns: caf\u00e9',
+    ' * @caf\u00e9: x',
+    ' * \u00a0Returns: no-break space',
+    ' * RETURN\u017f: long s',
+    ' * Returns:\u0085',
+]
+
+
+class ChunkedIO(object):
+    def __init__(self):
+        self.buffer = []
+
+    def write(self, s):
+        self.buffer.append(s)
+
+    def getvalue(self):
+        return self.buffer
+
+
+def _load_corpus():
+    tests_dir = os.path.dirname(os.path.abspath(__file__))
+    comments = []
+
+    for dirpath, dirnames, filenames in os.walk(tests_dir):
+        for filename in sorted(filenames):
+            if not filename.endswith('.xml'):
+                continue
+            tree = etree.parse(os.path.join(dirpath, filename)).getroot()
+            for element in tree.findall('{%s}test/{%s}input' % (XML_NS, XML_NS)):
+                if element.text:
+                    comment = element.text.replace('{{?', '<!').replace('}}', '>')
+                    comments.append(comment)
+
+    return comments
+
+
+def _is_ascii(line):
+    return all(ord(c) < 0x80 for c in line)
+
+
+@unittest.skipIf(annotationparser._tokenize_comment_lines is None,
+                 'the C tokenizer is not available')
+class TestTokenizer(unittest.TestCase):
+
+    @classmethod
+    def setUpClass(cls):
+        cls.comments = _load_corpus()
+
+    def setUp(self):
+        self._tokenize_comment_lines = annotationparser._tokenize_comment_lines
+        logger = MessageLogger.get(namespace=Namespace('Test', '1.0'))
+        logger.enable_warnings((WARNING, ERROR, FATAL))
+        self._output = logger._output
+
+    def tearDown(self):
+        annotationparser._tokenize_comment_lines = self._tokenize_comment_lines
+        MessageLogger.get()._output = self._output
+
+    def _assert_lines(self, lines):
+        tokens = self._tokenize_comment_lines(lines, ALL_TAGS)
+        self.assertEqual(len(tokens), len(lines))
+        for line, token in zip(lines, tokens):
+            if not _is_ascii(line):
+                self.assertIsNone(token, repr(line))
+            else:
+                self.assertEqual(token, annotationparser._tokenize_comment_line(line),
+                                 repr(line))
+
+    def test_corpus(self):
+        self.assertGreater(len(self.comments), 100)
+        for comment in self.comments:
+            self._assert_lines(re.sub(LINE_BREAK_RE, '\n', comment).split('\n'))
+
+    def test_edge_cases(self):
+        self.assertTrue(any(not _is_ascii(line) for line in EDGE_CASES))
+        self._assert_lines(EDGE_CASES)
+
+    def _parse(self, comment, tokenize_comment_lines):
+        annotationparser._tokenize_comment_lines = tokenize_comment_lines
+        output = ChunkedIO()
+        MessageLogger.get()._output = output
+        block = GtkDocCommentBlockParser().parse_comment_block(comment, 'test.c', 1)
+        return GtkDocCommentBlockWriter(indent=False).write(block), output.getvalue()
+
+    def test_same_comment_blocks(self):
+        edge_cases = '/**\n * spam:\n' + '\n'.join(EDGE_CASES) + '\n */'
+        for comment in self.comments + [edge_cases]:
+            self.assertEqual(self._parse(comment, self._tokenize_comment_lines),
+                             self._parse(comment, None),
+                             comment)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,202 @@
+import os
+import shutil
+import struct
+import tempfile
+import unittest
+
+from giscanner import cachestore
+from giscanner.girparser import GIRParser
+
+
+SPAM_GIR = '''<?xml version="1.0"?>
+<repository version="1.2"
+            xmlns="http://www.gtk.org/introspection/core/1.0"
+            xmlns:c="http://www.gtk.org/introspection/c/1.0"
+            xmlns:glib="http://www.gtk.org/introspection/glib/1.0">
+  <namespace name="Spam" version="1.0" shared-library="libspam.so"
+             c:identifier-prefixes="Spam" c:symbol-prefixes="spam">
+    <enumeration name="Kind" c:type="SpamKind">
+      <member name="foo" value="0" c:identifier="SPAM_FOO"/>
+    </enumeration>
+    <record name="Can" c:type="SpamCan"/>
+    <class name="Tin" c:type="SpamTin" parent="GObject.Object"
+           glib:type-name="SpamTin" glib:get-type="spam_tin_get_type">
+      <method name="open" c:identifier="spam_tin_open">
+        <return-value transfer-ownership="none">
+          <type name="none" c:type="void"/>
+        </return-value>
+      </method>
+    </class>
+    <function name="eat" c:identifier="spam_eat">
+      <return-value transfer-ownership="none">
+        <type name="none" c:type="void"/>
+      </return-value>
+    </function>
+%s  </namespace>
+</repository>
+'''
+
+EGGS_ALIAS = '''    <alias name="Eggs" c:type="SpamEggs">
+      <type name="gint" c:type="gint"/>
+    </alias>
+'''
+
+
+class TestCacheStore(cachestore.CacheStore):
+    """Stores its entries in a directory of its own and counts how often
+the GIR file is hashed."""
+
+    directory = None
+
+    def __init__(self):
+        self.digests = 0
+        cachestore.CacheStore.__init__(self)
+
+    def _get_cachedir(self):
+        return self.directory
+
+    def _get_digest(self, filename):
+        self.digests += 1
+        return cachestore.CacheStore._get_digest(self, filename)
+
+
+class TestLazyNamespace(unittest.TestCase):
+
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        TestCacheStore.directory = os.path.join(self.dir, 'cache')
+        os.mkdir(TestCacheStore.directory)
+        self.filename = os.path.join(self.dir, 'Spam-1.0.gir')
+        self._write('')
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def _write(self, nodes):
+        with open(self.filename, 'w') as f:
+            f.write(SPAM_GIR % (nodes, ))
+
+    def _load(self):
+        store = TestCacheStore()
+        return store, store.load_namespace(self.filename)
+
+    def _get_index_filename(self):
+        entries = [name for name in os.listdir(TestCacheStore.directory)
+                   if name.endswith('.index')]
+        self.assertEqual(len(entries), 1)
+        return os.path.join(TestCacheStore.directory, entries[0])
+
+    def test_lookups_materialize_matching_fragment(self):
+        store, ns = self._load()
+        self.assertEqual(ns.name, 'Spam')
+        self.assertEqual(ns.shared_libraries, ['libspam.so'])
+        self.assertEqual(list(ns.names), [])
+
+        self.assertEqual(ns.get('Kind').ctype, 'SpamKind')
+        self.assertEqual(list(ns.names), ['Kind'])
+
+        self.assertEqual(ns.get_by_ctype('SpamCan').name, 'Can')
+        self.assertEqual(sorted(ns.names), ['Can', 'Kind'])
+
+        self.assertEqual(ns.get_by_gtype_name('SpamTin').name, 'Tin')
+        self.assertEqual(sorted(ns.names), ['Can', 'Kind', 'Tin'])
+
+        # Types-only namespaces have no functions, so looking up a
+        # symbol finds nothing, exactly as with an eagerly parsed one
+        parser = GIRParser(types_only=True)
+        parser.parse(self.filename)
+        eager = parser.get_namespace()
+        for symbol in ['spam_eat', 'spam_tin_open', 'spam_tin_get_type']:
+            self.assertIs(ns.get_by_symbol(symbol), eager.get_by_symbol(symbol))
+        self.assertEqual(sorted(ns.names), ['Can', 'Kind', 'Tin'])
+
+        self.assertIsNone(ns.get('Missing'))
+        self.assertIsNone(ns.get_by_ctype('SpamMissing'))
+
+    def test_iteration_materializes_everything(self):
+        self._write(EGGS_ALIAS)
+        store, ns = self._load()
+        # Looked up out of document order
+        ns.get('Eggs')
+        self.assertEqual(list(ns), ['Kind', 'Can', 'Tin', 'Eggs'])
+        self.assertEqual([node.name for node in ns.values()],
+                         ['Kind', 'Can', 'Tin', 'Eggs'])
+        self.assertEqual(list(ns.aliases), ['Eggs'])
+
+    def test_index_rebuilt_when_gir_changes(self):
+        store, ns = self._load()
+        self.assertEqual(store.digests, 1)
+        self.assertIsNone(ns.get('Eggs'))
+        index_filename = self._get_index_filename()
+
+        # Unchanged size and modification time, not hashed again
+        store, ns = self._load()
+        self.assertEqual(store.digests, 0)
+        self.assertIsNotNone(ns.get('Kind'))
+
+        # Only touched, hashed once and the new time recorded
+        st = os.stat(self.filename)
+        os.utime(self.filename, (st.st_atime, st.st_mtime + 10))
+        store, ns = self._load()
+        self.assertEqual(store.digests, 1)
+        self.assertIsNotNone(ns.get('Kind'))
+        store, ns = self._load()
+        self.assertEqual(store.digests, 0)
+
+        self._write(EGGS_ALIAS)
+        store, ns = self._load()
+        self.assertEqual(ns.get('Eggs').ctype, 'SpamEggs')
+        self.assertEqual(self._get_index_filename(), index_filename)
+
+    def test_changed_contents_with_same_size(self):
+        self._load()
+        st = os.stat(self.filename)
+        with open(self.filename, 'w') as f:
+            f.write((SPAM_GIR % ('', )).replace('SpamCan', 'SpamTub'))
+        os.utime(self.filename, (st.st_atime, st.st_mtime + 10))
+        store, ns = self._load()
+        self.assertEqual(store.digests, 1)
+        self.assertEqual(ns.get_by_ctype('SpamTub').name, 'Can')
+
+    def _rewrite_header(self, magic=None, version=None):
+        self._load()
+        index_filename = self._get_index_filename()
+        with open(index_filename, 'r+b') as f:
+            header = list(cachestore._INDEX_HEADER.unpack(
+                f.read(cachestore._INDEX_HEADER.size)))
+            if magic is not None:
+                header[0] = magic
+            if version is not None:
+                header[1] = version
+            f.seek(0)
+            f.write(cachestore._INDEX_HEADER.pack(*header))
+        return index_filename
+
+    def _assert_rejected(self, index_filename):
+        store, ns = self._load()
+        # Rebuilt from the GIR file
+        self.assertEqual(store.digests, 1)
+        self.assertEqual(ns.get('Kind').ctype, 'SpamKind')
+        with open(index_filename, 'rb') as f:
+            header = cachestore._INDEX_HEADER.unpack(
+                f.read(cachestore._INDEX_HEADER.size))
+        self.assertEqual(header[:2], (cachestore._INDEX_MAGIC,
+                                      cachestore._CACHE_FORMAT_VERSION))
+
+    def test_wrong_magic_rejected(self):
+        self._assert_rejected(self._rewrite_header(magic=b'NOTINDEX'))
+
+    def test_wrong_version_rejected(self):
+        self._assert_rejected(self._rewrite_header(
+            version=cachestore._CACHE_FORMAT_VERSION - 1))
+
+    def test_truncated_index_rejected(self):
+        self._load()
+        index_filename = self._get_index_filename()
+        with open(index_filename, 'r+b') as f:
+            f.truncate(struct.calcsize('<8s'))
+        self._assert_rejected(index_filename)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,111 @@
+import os
+import shutil
+import subprocess
+import tempfile
+import unittest
+
+try:
+    import configparser
+except ImportError:
+    import ConfigParser as configparser
+
+
+BASE_GIR = '''<?xml version="1.0"?>
+<repository version="1.2"
+            xmlns="http://www.gtk.org/introspection/core/1.0"
+            xmlns:c="http://www.gtk.org/introspection/c/1.0">
+  <namespace name="Base" version="1.0" shared-library=""
+             c:identifier-prefixes="Base" c:symbol-prefixes="base">
+    <enumeration name="Kind" c:type="BaseKind">
+      <member name="foo" value="0" c:identifier="BASE_FOO"/>
+%s    </enumeration>
+  </namespace>
+</repository>
+'''
+
+TOP_GIR = '''<?xml version="1.0"?>
+<repository version="1.2"
+            xmlns="http://www.gtk.org/introspection/core/1.0"
+            xmlns:c="http://www.gtk.org/introspection/c/1.0">
+  <include name="Base" version="1.0"/>
+  <namespace name="Top" version="1.0" shared-library=""
+             c:identifier-prefixes="Top" c:symbol-prefixes="top">
+    <enumeration name="Kind" c:type="TopKind">
+      <member name="bar" value="1" c:identifier="TOP_BAR"/>
+    </enumeration>
+  </namespace>
+</repository>
+'''
+
+COMPILER = os.path.join(os.environ.get('top_builddir', ''), 'g-ir-compiler')
+
+
+@unittest.skipUnless(os.path.exists(COMPILER), 'g-ir-compiler not built')
+class TestCompilerCache(unittest.TestCase):
+
+    def setUp(self):
+        self.tmpdir = tempfile.mkdtemp()
+        self.cache_dir = os.path.join(self.tmpdir, 'cache')
+        self.output = os.path.join(self.tmpdir, 'Top-1.0.typelib')
+        self._write_base('')
+        with open(os.path.join(self.tmpdir, 'Top-1.0.gir'), 'w') as f:
+            f.write(TOP_GIR)
+
+    def tearDown(self):
+        shutil.rmtree(self.tmpdir)
+
+    def _write_base(self, members):
+        with open(os.path.join(self.tmpdir, 'Base-1.0.gir'), 'w') as f:
+            f.write(BASE_GIR % (members, ))
+
+    def _compile(self):
+        subprocess.check_call([COMPILER,
+                               '--includedir', self.tmpdir,
+                               '--cache-dir', self.cache_dir,
+                               os.path.join(self.tmpdir, 'Top-1.0.gir'),
+                               '-o', self.output])
+        with open(self.output, 'rb') as f:
+            return f.read()
+
+    def _get_stats(self):
+        parser = configparser.RawConfigParser()
+        parser.read(os.path.join(self.cache_dir, 'stats'))
+        return (parser.getint('cache', 'hits') if parser.has_option('cache', 'hits') else 0,
+                parser.getint('cache', 'misses'))
+
+    def test_hit_has_identical_bytes(self):
+        first = self._compile()
+        self.assertEqual(self._get_stats(), (0, 1))
+        second = self._compile()
+        self.assertEqual(self._get_stats(), (1, 1))
+        self.assertEqual(first, second)
+
+    def test_edited_include_misses(self):
+        first = self._compile()
+        self._write_base('      <member name="baz" value="1" c:identifier="BASE_BAZ"/>\n')
+        second = self._compile()
+        self.assertEqual(self._get_stats(), (0, 2))
+        self.assertNotEqual(first, second)
+
+    def test_rewritten_output_leaves_entry_intact(self):
+        first = self._compile()
+        self._compile()
+        # Rewrite the restored output in place, as cp would
+        with open(self.output, 'r+b') as f:
+            f.write(b'\0' * 64)
+        self.assertEqual(self._compile(), first)
+        self.assertEqual(self._get_stats(), (2, 1))
+
+    def test_corrupt_entry_misses(self):
+        first = self._compile()
+        entry, = [name for name in os.listdir(self.cache_dir)
+                  if name.endswith('.typelib')]
+        with open(os.path.join(self.cache_dir, entry), 'r+b') as f:
+            f.seek(len(first) - 1)
+            f.write(b'\xff' if first[-1:] != b'\xff' else b'\0')
+        self.assertEqual(self._compile(), first)
+        self.assertEqual(self._get_stats(), (0, 2))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,128 @@
+import os
+import shutil
+import tempfile
+import unittest
+
+os.environ['GI_SCANNER_DISABLE_CACHE'] = '1'
+
+from giscanner.docwriter import DocWriter, PageIndex
+from giscanner.transformer import Transformer
+
+
+SPAM_GIR = '''<?xml version="1.0"?>
+<repository version="1.2"
+            xmlns="http://www.gtk.org/introspection/core/1.0"
+            xmlns:c="http://www.gtk.org/introspection/c/1.0">
+  <namespace name="Spam" version="1.0" shared-library=""
+             c:identifier-prefixes="Spam" c:symbol-prefixes="spam">
+    <record name="Can" c:type="SpamCan">
+      <doc xml:space="preserve">%(can)s</doc>
+    </record>
+    <record name="Tin" c:type="SpamTin">
+      <doc xml:space="preserve">Holds a #SpamCan.</doc>
+    </record>
+    <record name="Box" c:type="SpamBox">
+      <doc xml:space="preserve">Holds nothing.</doc>
+    </record>
+%(extra)s  </namespace>
+</repository>
+'''
+
+SPAM_LID = '''    <record name="Lid" c:type="SpamLid">
+      <doc xml:space="preserve">Closes things.</doc>
+    </record>
+'''
+
+# Written over every page between runs, so the pages rendered again can
+# be told apart without relying on the resolution of file times
+STALE = b'stale'
+
+
+class TestIncremental(unittest.TestCase):
+
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.output = os.path.join(self.dir, 'output')
+        self.filename = os.path.join(self.dir, 'Spam-1.0.gir')
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def _write(self, can='A can.', extra=''):
+        with open(self.filename, 'w') as f:
+            f.write(SPAM_GIR % dict(can=can, extra=extra))
+
+    def _get_pages(self):
+        return sorted(name for name in os.listdir(self.output)
+                      if name != PageIndex.FILENAME)
+
+    def _render(self, language='c', output_format='mallard'):
+        transformer = Transformer.parse_from_gir(self.filename)
+        writer = DocWriter(transformer, language, output_format)
+        writer.write(self.output, incremental=True)
+
+    def _mark_stale(self):
+        for name in self._get_pages():
+            with open(os.path.join(self.output, name), 'wb') as f:
+                f.write(STALE)
+
+    def _get_rendered(self):
+        rendered = []
+        for name in self._get_pages():
+            with open(os.path.join(self.output, name), 'rb') as f:
+                if f.read() != STALE:
+                    rendered.append(name)
+        return rendered
+
+    def test_edit_renders_node_and_referrers(self):
+        self._write()
+        self._render()
+        self.assertEqual(self._get_pages(),
+                         ['Spam.Box.page', 'Spam.Can.page', 'Spam.Tin.page',
+                          'index.page'])
+
+        self._mark_stale()
+        self._render()
+        # The index page lists all the others and is always rendered
+        self.assertEqual(self._get_rendered(), ['index.page'])
+
+        self._mark_stale()
+        self._write(can='A can of spam.')
+        self._render()
+        self.assertEqual(self._get_rendered(),
+                         ['Spam.Can.page', 'Spam.Tin.page', 'index.page'])
+
+    def test_removed_node_page_deleted(self):
+        self._write(extra=SPAM_LID)
+        self._render()
+        self.assertIn('Spam.Lid.page', self._get_pages())
+
+        self._write()
+        self._render()
+        self.assertEqual(self._get_pages(),
+                         ['Spam.Box.page', 'Spam.Can.page', 'Spam.Tin.page',
+                          'index.page'])
+
+    def test_language_change_renders_everything(self):
+        self._write()
+        self._render()
+        self._mark_stale()
+        self._render(language='python')
+        self.assertEqual(self._get_rendered(), self._get_pages())
+
+    def test_format_change_renders_everything(self):
+        self._write()
+        self._render(language='gjs')
+        mallard_pages = self._get_pages()
+        self._mark_stale()
+        self._render(language='gjs', output_format='devdocs')
+        rendered = self._get_rendered()
+        self.assertIn('index.html', rendered)
+        # The mallard pages are left alone, none of them was reused
+        self.assertEqual(sorted(set(self._get_pages()) - set(rendered)),
+                         mallard_pages)
+        self.assertEqual(len(rendered), len(mallard_pages))
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,113 @@
+import os
+import shutil
+import tempfile
+import time
+import unittest
+
+from giscanner import dumper, pkgconfig
+
+
+class Options(object):
+
+    def __init__(self, **kwargs):
+        self.namespace_name = 'Spam'
+        self.namespace_version = '1.0'
+        self.init_sections = []
+        self.packages = []
+        self.cflags = []
+        self.cpp_includes = []
+        self.external_library = True
+        self.libraries = ['spam']
+        self.extra_libraries = []
+        self.library_paths = []
+        self.nolibtool = True
+        self.libtool_path = None
+        self.quiet = True
+        self.dump_cache_dir = None
+        self.__dict__.update(kwargs)
+
+
+class CountingDumpCompiler(dumper.DumpCompiler):
+    """Counts links instead of invoking the compiler."""
+
+    links = 0
+
+    def _compile(self, *sources):
+        return [sources[0] + '.o']
+
+    def _link(self, output, sources):
+        CountingDumpCompiler.links += 1
+        with open(output, 'w') as f:
+            f.write('binary %d\n' % (CountingDumpCompiler.links, ))
+
+
+class TestDumpCache(unittest.TestCase):
+
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.cache_dir = os.path.join(self.dir, 'cache')
+        self.library = os.path.join(self.dir, 'libspam.so')
+        with open(self.library, 'w') as f:
+            f.write('spam')
+        self._cwd = os.getcwd()
+        os.chdir(self.dir)
+        self._pkgconfig = pkgconfig.cflags, pkgconfig.libs
+        pkgconfig.cflags = pkgconfig.libs = lambda packages, msvc_syntax=False: []
+        CountingDumpCompiler.links = 0
+
+    def tearDown(self):
+        pkgconfig.cflags, pkgconfig.libs = self._pkgconfig
+        os.chdir(self._cwd)
+        shutil.rmtree(self.dir)
+
+    def _run(self, **kwargs):
+        options = Options(dump_cache_dir=self.cache_dir,
+                          library_paths=[self.dir], **kwargs)
+        binary = CountingDumpCompiler(options, ['spam_get_type'], []).run()
+        with open(binary.args[0]) as f:
+            contents = f.read()
+        shutil.rmtree(binary.tmpdir)
+        return contents
+
+    def _get_entries(self):
+        if not os.path.isdir(self.cache_dir):
+            return []
+        return os.listdir(self.cache_dir)
+
+    def test_hit(self):
+        self.assertEqual(self._run(), 'binary 1\n')
+        self.assertEqual(self._run(), 'binary 1\n')
+        self.assertEqual(CountingDumpCompiler.links, 1)
+        self.assertEqual(len(self._get_entries()), 1)
+
+    def test_changed_library_misses(self):
+        self._run()
+        # Same size and modification time, different contents
+        st = os.stat(self.library)
+        with open(self.library, 'w') as f:
+            f.write('eggs')
+        os.utime(self.library, (st.st_atime, st.st_mtime))
+        self.assertEqual(self._run(), 'binary 2\n')
+        self.assertEqual(len(self._get_entries()), 2)
+
+    def test_libtool_bypasses_cache(self):
+        self._run(nolibtool=False, libtool_path='libtool')
+        self._run(nolibtool=False, libtool_path='libtool')
+        self.assertEqual(CountingDumpCompiler.links, 2)
+        self.assertEqual(self._get_entries(), [])
+
+    def test_old_entries_are_pruned(self):
+        self._run()
+        old_entry, = self._get_entries()
+        old_time = time.time() - dumper._CACHE_MAX_AGE - 60
+        os.utime(os.path.join(self.cache_dir, old_entry), (old_time, old_time))
+        with open(self.library, 'w') as f:
+            f.write('eggs')
+        self._run()
+        entries = self._get_entries()
+        self.assertEqual(len(entries), 1)
+        self.assertNotEqual(entries[0], old_entry)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -0,0 +1,112 @@
+import os
+import time
+import unittest
+
+try:
+    from StringIO import StringIO
+except ImportError:
+    from io import StringIO
+
+from giscanner import message, utils
+from giscanner.annotationparser import GtkDocCommentBlockParser
+
+
+FATAL_ITEM = 5
+
+
+def _square(item):
+    # The first items take longest, so that the workers finish out of order
+    if item < 4:
+        time.sleep(0.05 * (4 - item))
+    return item * item, os.getpid()
+
+
+def _record(item):
+    # Like annotationparser._parse_comment_block_recorded()
+    logger = message.MessageLogger._instance
+    recorder = message.MessageRecorder()
+    message.MessageLogger._instance = recorder
+    try:
+        message.warn('item %d' % (item, ))
+        if item == FATAL_ITEM:
+            message.fatal('item %d is fatal' % (item, ))
+        message.warn('item %d done' % (item, ))
+    except SystemExit:
+        pass
+    finally:
+        message.MessageLogger._instance = logger
+    return item, recorder, os.getpid()
+
+
+@unittest.skipUnless(hasattr(os, 'fork'), 'parallel_map() needs fork()')
+class TestParallelMap(unittest.TestCase):
+
+    def setUp(self):
+        self._logger = message.MessageLogger._instance
+        self.output = StringIO()
+        message.MessageLogger._instance = None
+        self.logger = message.MessageLogger.get(output=self.output)
+        self.logger.enable_warnings((message.WARNING, message.ERROR, message.FATAL))
+
+    def tearDown(self):
+        message.MessageLogger._instance = self._logger
+
+    def test_results_keep_order(self):
+        results = utils.parallel_map(_square, range(32), 4)
+        self.assertEqual([result for result, pid in results],
+                         [item * item for item in range(32)])
+        pids = set(pid for result, pid in results)
+        self.assertNotIn(os.getpid(), pids)
+        self.assertGreater(len(pids), 1)
+
+    def _replay(self, results):
+        for item, recorder, pid in results:
+            recorder.replay(self.logger)
+
+    def _get_serial_output(self, items):
+        output = self.output.getvalue()
+        try:
+            self._replay([_record(item) for item in items])
+        except SystemExit:
+            pass
+        serial_output = self.output.getvalue()[len(output):]
+        self.output.seek(len(output))
+        self.output.truncate()
+        return serial_output
+
+    def test_messages_replayed_in_order(self):
+        expected = self._get_serial_output(range(FATAL_ITEM))
+        self.assertEqual(len(expected.splitlines()), 2 * FATAL_ITEM)
+
+        self._replay(utils.parallel_map(_record, range(FATAL_ITEM), 4))
+        self.assertEqual(self.output.getvalue(), expected)
+
+    def test_fatal_message_exits(self):
+        expected = self._get_serial_output(range(FATAL_ITEM + 3))
+        lines = expected.splitlines()
+        # Everything recorded before the fatal message, and nothing after it
+        self.assertEqual(len(lines), 2 * FATAL_ITEM + 2)
+        self.assertTrue(lines[-1].endswith('Fatal: item %d is fatal' % (FATAL_ITEM, )))
+
+        results = utils.parallel_map(_record, range(FATAL_ITEM + 3), 4)
+        with self.assertRaises(SystemExit):
+            self._replay(results)
+        self.assertEqual(self.output.getvalue(), expected)
+
+    def test_comment_blocks_same_messages_with_jobs(self):
+        comments = [('/**\n * spam_%d:\n * @a: (bogus%d): x\n */' % (i, i),
+                     'spam.c', i * 10)
+                    for i in range(16)]
+        serial = GtkDocCommentBlockParser().parse_comment_blocks(comments)
+        serial_output = self.output.getvalue()
+        self.output.seek(0)
+        self.output.truncate()
+
+        parallel = GtkDocCommentBlockParser().parse_comment_blocks(comments, jobs=4)
+        self.assertEqual(sorted(parallel), sorted(serial))
+        self.assertEqual(self.output.getvalue(), serial_output)
+        self.assertEqual(len(serial_output.splitlines()), 16)
+
+
+if __name__ == '__main__':
+    unittest.main()
@@ -5,9 +5,13 @@ from __future__ import unicode_literals
 
 import unittest
 import tempfile
+import errno
 import os
+import shutil
 
-from giscanner.sourcescanner import SourceScanner
+from giscanner import sourcescanner
+from giscanner.sourcescanner import (SourceScanner, SourceCache, CSYMBOL_TYPE_TYPEDEF,
+                                     CSYMBOL_TYPE_FUNCTION, CSYMBOL_TYPE_CONST)
 
 
 two_typedefs_source = """
@@ -37,10 +41,185 @@ class Test(unittest.TestCase):
         self.assertEqual(len(list(self.ss.get_symbols())), 2)
         self.assertEqual(len(list(self.ss.get_symbols())), 2)
 
+    def test_get_symbols_filtered(self):
+        symbols = list(self.ss.get_symbols([CSYMBOL_TYPE_TYPEDEF]))
+        self.assertEqual([s.ident for s in symbols], ['Spam', 'Eggs'])
+        self.assertEqual(list(self.ss.get_symbols([CSYMBOL_TYPE_FUNCTION])), [])
+
     def test_get_comments_length_consistency(self):
         self.assertEqual(len(list(self.ss.get_comments())), 2)
         self.assertEqual(len(list(self.ss.get_comments())), 2)
 
 
+class TestJobs(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.headers = []
+        for name, source in [('spam.h', 'typedef struct _spam Spam;\n'),
+                             ('spam-new.h', 'Spam *spam_new (void);\n')]:
+            filename = os.path.join(self.dir, name)
+            with open(filename, 'w') as f:
+                f.write(source)
+            self.headers.append(filename)
+
+    def tearDown(self):
+        for filename in self.headers:
+            os.unlink(filename)
+        os.rmdir(self.dir)
+
+    def test_jobs_keep_single_translation_unit(self):
+        # spam-new.h doesn't include spam.h, so it can only be parsed
+        # after it in the same translation unit
+        ss = SourceScanner()
+        ss.parse_files(self.headers, jobs=2)
+        symbols = list(ss.get_symbols([CSYMBOL_TYPE_FUNCTION]))
+        self.assertEqual([s.ident for s in symbols], ['spam_new'])
+
+
+class TestParallelHeaders(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.headers = []
+        # Later headers use the typedefs of earlier ones through includes,
+        # and Ham and HAM_COUNT, which the workers have to be seeded with
+        for name, source in [
+                ('spam.h', 'typedef struct _spam Spam;\n'
+                           'enum { SPAM_A, SPAM_B };\n'),
+                ('spam-new.h', '#include "spam.h"\n'
+                               'Spam *spam_new (Ham *ham);\n'),
+                ('eggs.h', 'typedef struct _eggs Eggs;\n'
+                           'enum { EGGS_MAX = HAM_COUNT + 1 };\n'),
+                ('eggs-new.h', '#include "eggs.h"\n#include "spam.h"\n'
+                               'Eggs *eggs_new (Spam *s);\n')]:
+            filename = os.path.join(self.dir, name)
+            with open(filename, 'w') as f:
+                f.write(source)
+            self.headers.append(filename)
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def _parse(self, parallel, jobs):
+        ss = SourceScanner()
+        ss.set_parallel_headers(parallel)
+        ss._scanner.add_typedef('Ham')
+        ss._scanner.add_constant('HAM_COUNT', 3, self.headers[0], 1)
+        ss.parse_files(self.headers, jobs=jobs)
+        symbols = [(s.ident, s.type, os.path.basename(s.source_filename))
+                   for s in ss.get_symbols()]
+        constants = dict((c[0], c[1]) for c in ss._scanner.get_constants())
+        return symbols, constants
+
+    def test_parallel_headers_match_serial(self):
+        ss = SourceScanner()
+        self.assertEqual(len(ss._split_headers(self.headers, 2)), 2)
+
+        serial_symbols, serial_constants = self._parse(False, 1)
+        self.assertEqual([s[0] for s in serial_symbols],
+                         ['Spam', 'spam_new', 'Eggs', 'eggs_new'])
+        self.assertEqual(serial_constants['EGGS_MAX'], 4)
+
+        symbols, constants = self._parse(True, 2)
+        self.assertEqual(symbols, serial_symbols)
+        self.assertEqual(constants['SPAM_B'], 1)
+        self.assertEqual(constants['EGGS_MAX'], 4)
+
+
+class TestCombinedMacroScan(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        # The macros of spam-private.h are not scanned
+        for name, source in [
+                ('spam-private.h', '#define SPAM_PRIVATE 1\n'),
+                ('spam.h', '#include "spam-private.h"\n'
+                           '#define SPAM_MAX 10\n'
+                           '#define SPAM_NAME "spam"\n'
+                           '#define SPAM_EMPTY\n'
+                           '#define SPAM_GET(s, i) ((s)->items[(i)])\n'
+                           '#define SPAM_CALL(f, args) (f) args\n'
+                           '#define SPAM_MIN (-10)\n'
+                           '#undef SPAM_EMPTY\n'
+                           'int spam_count (void);\n'
+                           '#define SPAM_LAST 3\n')]:
+            with open(os.path.join(self.dir, name), 'w') as f:
+                f.write(source)
+        self.header = os.path.join(self.dir, 'spam.h')
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def _parse(self, combined):
+        ss = SourceScanner()
+        ss.set_combined_macro_scan(combined)
+        ss.parse_files([self.header])
+        ss.parse_macros([self.header])
+        return [(s.ident, s.type, s.const_int, s.const_string)
+                for s in ss.get_symbols()]
+
+    def test_same_macros_with_and_without_option(self):
+        separate = self._parse(False)
+        self.assertEqual(separate,
+                         [('spam_count', CSYMBOL_TYPE_FUNCTION, None, None),
+                          ('SPAM_MAX', CSYMBOL_TYPE_CONST, 10, None),
+                          ('SPAM_NAME', CSYMBOL_TYPE_CONST, None, 'spam'),
+                          ('SPAM_MIN', CSYMBOL_TYPE_CONST, -10, None),
+                          ('SPAM_LAST', CSYMBOL_TYPE_CONST, 3, None)])
+        self.assertEqual(self._parse(True), separate)
+
+
+class TestSourceCache(unittest.TestCase):
+    def setUp(self):
+        self.dir = tempfile.mkdtemp()
+        self.cache_dir = os.path.join(self.dir, 'cache')
+        self.headers = []
+        for name, source in [('spam.h', 'typedef struct _spam Spam;\n'),
+                             ('eggs.h', 'typedef struct _eggs Eggs;\n'),
+                             ('spam-new.h', 'Spam *spam_new (void);\n')]:
+            filename = os.path.join(self.dir, name)
+            with open(filename, 'w') as f:
+                f.write(source)
+            self.headers.append(filename)
+
+    def tearDown(self):
+        shutil.rmtree(self.dir)
+
+    def _parse(self):
+        ss = SourceScanner()
+        ss.set_cache_dir(self.cache_dir)
+        ss.parse_files(self.headers)
+        return [s.ident for s in ss.get_symbols()]
+
+    def test_edit_only_invalidates_changed_header(self):
+        self.assertEqual(self._parse(), ['Spam', 'Eggs', 'spam_new'])
+        entries = set(os.listdir(self.cache_dir))
+
+        # Loaded from the cache
+        self.assertEqual(self._parse(), ['Spam', 'Eggs', 'spam_new'])
+        self.assertEqual(set(os.listdir(self.cache_dir)), entries)
+
+        with open(self.headers[1], 'w') as f:
+            f.write('typedef struct _eggs Eggs;\nEggs *eggs_new (void);\n')
+        self.assertEqual(self._parse(), ['Spam', 'Eggs', 'eggs_new', 'spam_new'])
+        self.assertEqual(len(set(os.listdir(self.cache_dir)) - entries), 1)
+
+    def _store_failing(self, error):
+        def move(src, dst):
+            raise OSError(error, os.strerror(error))
+
+        cache = SourceCache(self.cache_dir)
+        move_, sourcescanner.shutil.move = sourcescanner.shutil.move, move
+        try:
+            cache.store('key', ([], []))
+        finally:
+            sourcescanner.shutil.move = move_
+
+    def test_failed_store_removes_temporary_file(self):
+        # No space left on device is ignored, anything else raised
+        self._store_failing(errno.ENOSPC)
+        self.assertEqual(os.listdir(self.cache_dir), [])
+        self.assertRaises(OSError, self._store_failing, errno.EIO)
+        self.assertEqual(os.listdir(self.cache_dir), [])
+
+
 if __name__ == '__main__':
     unittest.main()
@@ -1,3 +1,5 @@
+import hashlib
+import io
 import unittest
 
 from giscanner.xmlwriter import XMLWriter, collect_attributes, build_xml_tag
@@ -24,6 +26,37 @@ class TestXMLWriter(unittest.TestCase):
         lines = x.split('\n')
         self.assertTrue(len(lines[3]) < 80)
 
+    def _write_document(self, writer):
+        writer.write_comment('comment')
+        with writer.tagcontext('repository', [('version', '1.2')]):
+            writer.write_tag('doc', [('xml:space', 'preserve'), ('skip', None)],
+                             u'\xf6 & more')
+
+    def test_streaming(self):
+        buffered = XMLWriter()
+        self._write_document(buffered)
+        output = io.BytesIO()
+        streamed = XMLWriter(output=output)
+        self._write_document(streamed)
+        self.assertEqual(output.getvalue(), buffered.get_encoded_xml())
+
+    def test_digest(self):
+        digest = hashlib.sha1()
+        self._write_document(XMLWriter(digest=digest))
+
+        # Whitespace does not change the digest
+        same = hashlib.sha1()
+        writer = XMLWriter(digest=same)
+        writer.disable_whitespace()
+        self._write_document(writer)
+        self.assertEqual(digest.digest(), same.digest())
+
+        other = hashlib.sha1()
+        writer = XMLWriter(digest=other)
+        with writer.tagcontext('repository', [('version', '1.2')]):
+            writer.write_tag('doc', [('xml:space', 'preserve')], u'\xf6 &')
+        self.assertNotEqual(digest.digest(), other.digest())
+
     def test_collect_attributes(self):
         ca = collect_attributes
         res = ca('parameters', [], 6, ' ', 12)
@@ -19,6 +19,8 @@
  * Boston, MA 02111-1307, USA.
  */
 
+#include "config.h"
+
 #include <errno.h>
 #include <locale.h>
 #include <string.h>
@@ -45,10 +47,15 @@ gchar **shlibs = NULL;
 gboolean include_cwd = FALSE;
 gboolean debug = FALSE;
 gboolean verbose = FALSE;
+gchar *cache_dir = NULL;
+gboolean cache_stats = FALSE;
+gboolean share_signatures = FALSE;
+gboolean hot_cold_layout = FALSE;
 
 static gboolean
-write_out_typelib (gchar *prefix,
-		   GITypelib *typelib)
+write_out_typelib (gchar        *prefix,
+		   const guint8 *data,
+		   gsize         len)
 {
   FILE *file;
   gsize written;
@@ -89,8 +96,8 @@ write_out_typelib (gchar *prefix,
 	}
     }
 
-  written = fwrite (typelib->data, 1, typelib->len, file);
-  if (written < typelib->len) {
+  written = fwrite (data, 1, len, file);
+  if (written < len) {
     g_fprintf (stderr, "ERROR: Could not write the whole output: %s",
 	       strerror(errno));
     goto out;
@@ -115,6 +122,260 @@ out:
   return success;
 }
 
+/* Typelib cache
+ *
+ * The cache is content-addressed: the key is a SHA-256 over everything
+ * that can influence the generated typelib, namely the compiler version,
+ * the typelib format version, the options that are copied into the
+ * typelib, the bytes of the input GIR and the bytes of every GIR in its
+ * include closure.  Entries are stored as <cache-dir>/<key>.typelib and
+ * written atomically, so concurrent compiler runs may share a directory.
+ */
+
+/* Bump whenever the compiler writes different typelibs for the same
+ * input, since the package version doesn't change between releases.
+ *
+ * 1: initial version
+ * 2: typelibs carry a checksum in their header
+ */
+#define CACHE_FORMAT_VERSION 2
+
+static gboolean
+checksum_add_gir (GChecksum   *checksum,
+		  GIrParser   *parser,
+		  const gchar *path,
+		  GHashTable  *visited)
+{
+  static GRegex *include_re = NULL;
+  static GRegex *attr_re = NULL;
+  GMatchInfo *match_info;
+  gchar *contents;
+  gsize length;
+  gboolean success = TRUE;
+
+  if (!g_file_get_contents (path, &contents, &length, NULL))
+    return FALSE;
+
+  if (include_re == NULL)
+    {
+      include_re = g_regex_new ("<include\\s[^>]*>", G_REGEX_OPTIMIZE, 0, NULL);
+      attr_re = g_regex_new ("\\b(name|version)=\"([^\"]*)\"", G_REGEX_OPTIMIZE, 0, NULL);
+    }
+
+  g_checksum_update (checksum, (const guchar *) &length, sizeof (length));
+  g_checksum_update (checksum, (const guchar *) contents, length);
+
+  g_regex_match (include_re, contents, 0, &match_info);
+  while (success && g_match_info_matches (match_info))
+    {
+      gchar *element = g_match_info_fetch (match_info, 0);
+      gchar *name = NULL;
+      gchar *version = NULL;
+      GMatchInfo *attr_info;
+
+      g_regex_match (attr_re, element, 0, &attr_info);
+      while (g_match_info_matches (attr_info))
+	{
+	  gchar *attr = g_match_info_fetch (attr_info, 1);
+
+	  if (strcmp (attr, "name") == 0)
+	    {
+	      g_free (name);
+	      name = g_match_info_fetch (attr_info, 2);
+	    }
+	  else
+	    {
+	      g_free (version);
+	      version = g_match_info_fetch (attr_info, 2);
+	    }
+	  g_free (attr);
+	  g_match_info_next (attr_info, NULL);
+	}
+      g_match_info_free (attr_info);
+
+      if (name != NULL && version != NULL)
+	{
+	  gchar *girname = g_strdup_printf ("%s-%s.gir", name, version);
+
+	  if (!g_hash_table_contains (visited, girname))
+	    {
+	      gchar *girpath;
+
+	      g_hash_table_add (visited, g_strdup (girname));
+	      g_checksum_update (checksum, (const guchar *) girname, -1);
+
+	      girpath = _g_ir_parser_locate_gir (parser, girname);
+	      if (girpath == NULL)
+		success = FALSE;
+	      else
+		success = checksum_add_gir (checksum, parser, girpath, visited);
+	      g_free (girpath);
+	    }
+	  g_free (girname);
+	}
+      else
+	success = FALSE;
+
+      g_free (name);
+      g_free (version);
+      g_free (element);
+      g_match_info_next (match_info, NULL);
+    }
+  g_match_info_free (match_info);
+  g_free (contents);
+
+  return success;
+}
+
+/* Returns NULL if the include closure cannot be resolved; in that case
+ * the cache is bypassed and the parser reports the actual error.
+ */
+static gchar *
+compute_cache_key (GIrParser *parser)
+{
+  GChecksum *checksum;
+  GHashTable *visited;
+  gchar *key = NULL;
+  guint8 format_version[3] = { 4, 0, CACHE_FORMAT_VERSION };
+
+  format_version[1] = share_signatures ? 1 : 0;
+
+  checksum = g_checksum_new (G_CHECKSUM_SHA256);
+  g_checksum_update (checksum, (const guchar *) PACKAGE_VERSION, -1);
+  g_checksum_update (checksum, (const guchar *) G_IR_MAGIC, 16);
+  g_checksum_update (checksum, format_version, sizeof (format_version));
+
+  if (shlibs)
+    {
+      gchar *joined = g_strjoinv (",", shlibs);
+      g_checksum_update (checksum, (const guchar *) "shlibs:", -1);
+      g_checksum_update (checksum, (const guchar *) joined, strlen (joined) + 1);
+      g_free (joined);
+    }
+  if (hot_cold_layout)
+    g_checksum_update (checksum, (const guchar *) "hot-cold-layout:", -1);
+  if (mname)
+    {
+      g_checksum_update (checksum, (const guchar *) "module:", -1);
+      g_checksum_update (checksum, (const guchar *) mname, strlen (mname) + 1);
+    }
+
+  visited = g_hash_table_new_full (g_str_hash, g_str_equal, g_free, NULL);
+  if (checksum_add_gir (checksum, parser, input[0], visited))
+    key = g_strdup (g_checksum_get_string (checksum));
+  g_hash_table_unref (visited);
+  g_checksum_free (checksum);
+
+  return key;
+}
+
+static gchar *
+get_stats_filename (void)
+{
+  return g_build_filename (cache_dir, "stats", NULL);
+}
+
+static void
+update_cache_stats (gboolean hit)
+{
+  GKeyFile *keyfile;
+  gchar *filename;
+  const gchar *counter = hit ? "hits" : "misses";
+  guint64 value;
+
+  filename = get_stats_filename ();
+  keyfile = g_key_file_new ();
+  g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, NULL);
+
+  value = g_key_file_get_uint64 (keyfile, "cache", counter, NULL);
+  g_key_file_set_uint64 (keyfile, "cache", counter, value + 1);
+
+  /* Statistics are advisory; losing an update to a concurrent
+   * compiler run is acceptable.
+   */
+  g_key_file_save_to_file (keyfile, filename, NULL);
+
+  g_key_file_free (keyfile);
+  g_free (filename);
+}
+
+static void
+print_cache_stats (FILE *stream)
+{
+  GKeyFile *keyfile;
+  gchar *filename;
+  guint64 hits, misses;
+
+  filename = get_stats_filename ();
+  keyfile = g_key_file_new ();
+  g_key_file_load_from_file (keyfile, filename, G_KEY_FILE_NONE, NULL);
+
+  hits = g_key_file_get_uint64 (keyfile, "cache", "hits", NULL);
+  misses = g_key_file_get_uint64 (keyfile, "cache", "misses", NULL);
+
+  g_fprintf (stream, "cache directory: %s\n", cache_dir);
+  g_fprintf (stream, "cache hits: %" G_GUINT64_FORMAT "\n", hits);
+  g_fprintf (stream, "cache misses: %" G_GUINT64_FORMAT "\n", misses);
+  g_fprintf (stream, "cache hit rate: %.1f%%\n",
+	     hits + misses > 0 ? 100.0 * hits / (hits + misses) : 0.0);
+
+  g_key_file_free (keyfile);
+  g_free (filename);
+}
+
+static gboolean
+restore_from_cache (const gchar *cache_path)
+{
+  gchar *data;
+  gsize len;
+  guint8 digest[G_TYPELIB_DIGEST_LEN];
+  gboolean success;
+
+  if (!g_file_get_contents (cache_path, &data, &len, NULL))
+    return FALSE;
+
+  /* Entries are copied rather than linked into place, so nothing done
+   * to the output can reach the cache; but an entry could still have
+   * been damaged in the cache directory itself.
+   */
+  if (len < sizeof (Header) || memcmp (data, G_IR_MAGIC, 16) != 0)
+    {
+      g_debug ("[cache] ignoring corrupt entry %s", cache_path);
+      g_free (data);
+      return FALSE;
+    }
+
+  g_typelib_compute_checksum ((const guint8 *) data, len, digest);
+  if (memcmp (((Header *) data)->checksum, digest,
+	      sizeof (((Header *) data)->checksum)) != 0)
+    {
+      g_debug ("[cache] ignoring entry %s with a wrong checksum", cache_path);
+      g_free (data);
+      return FALSE;
+    }
+
+  success = write_out_typelib (NULL, (const guint8 *) data, len);
+  g_free (data);
+
+  return success;
+}
+
+static void
+store_in_cache (const gchar *cache_path,
+		GITypelib   *typelib)
+{
+  GError *error = NULL;
+
+  if (g_mkdir_with_parents (cache_dir, 0755) != 0 ||
+      !g_file_set_contents (cache_path, (const gchar *) typelib->data,
+			    typelib->len, &error))
+    {
+      g_debug ("[cache] failed to store %s: %s", cache_path,
+	       error ? error->message : g_strerror (errno));
+      g_clear_error (&error);
+    }
+}
+
 GLogLevelFlags logged_levels;
 
 static void log_handler (const gchar *log_domain,
@@ -135,6 +396,10 @@ static GOptionEntry options[] =
   { "shared-library", 'l', 0, G_OPTION_ARG_FILENAME_ARRAY, &shlibs, "shared library", "FILE" }, 
   { "debug", 0, 0, G_OPTION_ARG_NONE, &debug, "show debug messages", NULL }, 
   { "verbose", 0, 0, G_OPTION_ARG_NONE, &verbose, "show verbose messages", NULL }, 
+  { "cache-dir", 0, 0, G_OPTION_ARG_FILENAME, &cache_dir, "directory used to cache compiled typelibs (default: $GI_COMPILER_CACHE_DIR)", "DIR" },
+  { "cache-stats", 0, 0, G_OPTION_ARG_NONE, &cache_stats, "print typelib cache statistics", NULL },
+  { "share-signatures", 0, 0, G_OPTION_ARG_NONE, &share_signatures, "share identical function signatures", NULL },
+  { "hot-cold-layout", 0, 0, G_OPTION_ARG_NONE, &hot_cold_layout, "group the data used by common lookups at the start", NULL },
   { G_OPTION_REMAINING, 0, 0, G_OPTION_ARG_FILENAME_ARRAY, &input, NULL, NULL },
   { NULL, }
 };
@@ -146,6 +411,8 @@ main (int argc, char ** argv)
   GError *error = NULL;
   GIrParser *parser;
   GIrModule *module;
+  gchar *cache_key = NULL;
+  gchar *cache_path = NULL;
   gint i;
   g_typelib_check_sanity ();
 
@@ -174,6 +441,23 @@ main (int argc, char ** argv)
 
   g_log_set_default_handler (log_handler, NULL);
 
+  if (cache_dir == NULL && g_getenv ("GI_COMPILER_CACHE_DIR") != NULL)
+    cache_dir = g_strdup (g_getenv ("GI_COMPILER_CACHE_DIR"));
+
+  if (cache_stats && !input)
+    {
+      if (cache_dir == NULL)
+        {
+          g_fprintf (stderr, "no cache directory\n");
+
+          return 1;
+        }
+
+      print_cache_stats (stdout);
+
+      return 0;
+    }
+
   if (!input) 
     { 
       g_fprintf (stderr, "no input files\n"); 
@@ -192,6 +476,30 @@ main (int argc, char ** argv)
 
   _g_ir_parser_set_includes (parser, (const char*const*) includedirs);
 
+  if (cache_dir != NULL)
+    {
+      cache_key = compute_cache_key (parser);
+      if (cache_key != NULL)
+        {
+          gchar *basename = g_strconcat (cache_key, ".typelib", NULL);
+
+          cache_path = g_build_filename (cache_dir, basename, NULL);
+          g_free (basename);
+
+          g_debug ("[cache] key %s", cache_key);
+
+          if (restore_from_cache (cache_path))
+            {
+              g_debug ("[cache] hit");
+              update_cache_stats (TRUE);
+              if (cache_stats)
+                print_cache_stats (stderr);
+
+              return 0;
+            }
+        }
+    }
+
   module = _g_ir_parser_parse_file (parser, input[0], &error);
   if (module == NULL) 
     {
@@ -217,21 +525,37 @@ main (int argc, char ** argv)
 
       g_debug ("[building] module %s", module->name);
 
+      module->share_signatures = share_signatures;
+      module->hot_cold_layout = hot_cold_layout;
+
       typelib = _g_ir_module_build_typelib (module);
       if (typelib == NULL)
 	g_error ("Failed to build typelib for module '%s'\n", module->name);
-      if (!g_typelib_validate (typelib, &error))
+      if (!g_typelib_validate_parallel (typelib, 0, &error))
 	g_error ("Invalid typelib for module '%s': %s", 
 		 module->name, error->message);
 
-      if (!write_out_typelib (NULL, typelib))
+      if (!write_out_typelib (NULL, typelib->data, typelib->len))
 	return 1;
+
+      if (cache_path != NULL)
+        {
+          g_debug ("[cache] miss");
+          store_in_cache (cache_path, typelib);
+          update_cache_stats (FALSE);
+          if (cache_stats)
+            print_cache_stats (stderr);
+        }
+
       g_typelib_free (typelib);
       typelib = NULL;
     }
 
   g_debug ("[building] done");
 
+  g_free (cache_key);
+  g_free (cache_path);
+
 #if 0
   /* No point */
   _g_ir_parser_free (parser);